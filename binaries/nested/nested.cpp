@@ -6,9 +6,42 @@ static constexpr int  RISCV_ARCH = 8; // 64-bit
 static constexpr bool verbose_enabled = true;
 #include "stream.h"
 
+#if defined(RISCV_PARAVIRT) && defined(__riscv)
+static int paravirt_main(std::string_view binary)
+{
+	riscv::ParavirtMachine machine { binary, MAX_MEMORY };
+	if (!machine.valid()) {
+		printf(">>> Paravirtual machine refused by host\n");
+		return 1;
+	}
+	machine.setup_linux({"program"}, {"LC_CTYPE=C", "LC_ALL=C"});
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	const auto status = machine.simulate();
+	auto t1 = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> runtime = t1 - t0;
+
+	if (status == riscv::MACHINE_FAULT) {
+		printf(">>> Machine exception %d (data: 0x%" PRIX64 ")\n",
+			machine.fault().type, machine.fault().data);
+	}
+	const auto retval = machine.return_value();
+	printf(">>> Program exited, exit code = %" PRId64 " (0x%" PRIX64 ")\n",
+		int64_t(retval), uint64_t(retval));
+	printf("Instructions executed: %" PRIu64 "  Runtime: %.3fms (paravirtualized)\n",
+		machine.instruction_counter(), runtime.count()*1000.0);
+	return 0;
+}
+#endif
+
 int main()
 {
 	const std::string_view binary { (const char*)stream_rv64gvb, stream_rv64gvb_len };
+#if defined(RISCV_PARAVIRT) && defined(__riscv)
+	// Let the host run the machine, when it can
+	if (riscv::ParavirtMachine::available())
+		return paravirt_main(binary);
+#endif
 
 	riscv::Machine<RISCV_ARCH> machine { binary, {
 		.memory_max = MAX_MEMORY,
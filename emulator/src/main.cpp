@@ -1,8 +1,10 @@
 #include <libriscv/machine.hpp>
 #include <libriscv/debug.hpp>
 #include <libriscv/rsp_server.hpp>
+#include <libriscv/util/crc32.hpp>
 #include <inttypes.h>
 #include <chrono>
+#include <filesystem>
 #include <thread>
 #include "settings.hpp"
 #if __has_include(<unistd.h>)
@@ -30,6 +32,7 @@ struct Arguments {
 	bool no_translate = false;
 	bool translate_regcache = riscv::libtcc_enabled; // Default: Register caching w/libtcc
 	bool translate_future = true;
+	unsigned translate_jit = 0; // Translate JIT segments after N entries
 	bool mingw = false;
 	bool from_start = false;
 	bool sandbox = false;
@@ -42,6 +45,7 @@ struct Arguments {
 	std::string output_file;
 	std::string call_function;
 	std::string jump_hints_file;
+	std::string ld_snapshot_file;
 };
 
 #ifdef HAVE_GETOPT_LONG
@@ -62,7 +66,9 @@ static const struct option long_options[] = {
 	{"no-translate", no_argument, 0, 'n'},
 	{"no-translate-future", no_argument, 0, 'N'},
 	{"translate-regcache", no_argument, 0, 'R'},
+	{"translate-jit", required_argument, 0, 'j'},
 	{"jump-hints", required_argument, 0, 'J'},
+	{"ld-snapshot", required_argument, 0, 'L'},
 	{"background", no_argument, 0, 'B'},
 	{"mingw", no_argument, 0, 'm'},
 	{"output", required_argument, 0, 'o'},
@@ -94,7 +100,9 @@ static void print_help(const char* name)
 		"  -n, --no-translate Disable binary translation\n"
 		"  -N, --no-translate-future Disable binary translation of non-initial segments\n"
 		"  -R, --translate-regcache Enable register caching in binary translator\n"
-		"  -J, --jump-hints file  Load jump location hints from file, unless empty then record instead\n"
+		"  -j, --translate-jit n  Translate guest JIT segments after n entries\n"
+		"  -J, --jump-hints file  Load jump location hints and branch profile from file, unless empty then record instead\n"
+		"  -L, --ld-snapshot file Restore dynamic linker state from file, unless missing or stale then record instead\n"
 		"  -B  --background   Run binary translation in background thread\n"
 		"  -m, --mingw        Cross-compile for Windows (MinGW)\n"
 		"  -o, --output file  Output embeddable binary translated code (C99)\n"
@@ -152,7 +160,7 @@ static void print_help(const char* name)
 static int parse_arguments(int argc, const char** argv, Arguments& args)
 {
 	int c;
-	while ((c = getopt_long(argc, (char**)argv, "hvQad1f:gstTnNRJ:Bmo:FSPA:XIc:", long_options, nullptr)) != -1)
+	while ((c = getopt_long(argc, (char**)argv, "hvQad1f:gstTnNRj:J:L:Bmo:FSPA:XIc:", long_options, nullptr)) != -1)
 	{
 		switch (c)
 		{
@@ -170,7 +178,9 @@ static int parse_arguments(int argc, const char** argv, Arguments& args)
 			case 'n': args.no_translate = true; break;
 			case 'N': args.translate_future = false; break;
 			case 'R': args.translate_regcache = true; break;
+			case 'j': args.translate_jit = strtoul(optarg, nullptr, 10); break;
 			case 'J': break;
+			case 'L': break;
 			case 'B': args.background = true; break;
 			case 'm': args.mingw = true; break;
 			case 'o': break;
@@ -214,6 +224,11 @@ static int parse_arguments(int argc, const char** argv, Arguments& args)
 			if (args.verbose) {
 				printf("* Jump hints file: %s\n", args.jump_hints_file.c_str());
 			}
+		} else if (c == 'L') {
+			args.ld_snapshot_file = optarg;
+			if (args.verbose) {
+				printf("* Dynamic linker snapshot file: %s\n", args.ld_snapshot_file.c_str());
+			}
 		}
 	}
 
@@ -264,16 +279,19 @@ static void run_program(
 #ifdef RISCV_BINARY_TRANSLATION
 		.translate_enabled = !cli_args.no_translate,
 		.translate_future_segments = cli_args.translate_future,
+		.translate_jit_segments_after = cli_args.translate_jit,
 		.translate_trace = cli_args.trace,
 		.translate_timing = cli_args.timing,
 		.translate_ignore_instruction_limit = !cli_args.accurate, // Press Ctrl+C to stop
 		.translate_use_register_caching = cli_args.translate_regcache,
 		.record_slowpaths_to_jump_hints = !cli_args.jump_hints_file.empty(),
+		.record_branch_profile = !cli_args.jump_hints_file.empty(),
 #ifdef _WIN32
 		.translation_prefix = "translations/rvbintr-",
 		.translation_suffix = ".dll",
 #else
 		.translator_jump_hints = load_jump_hints<W>(cli_args.jump_hints_file, cli_args.verbose),
+		.translator_branch_hints = load_branch_hints<W>(cli_args.jump_hints_file),
 		.translate_background_callback = cli_args.background ?
 			[] (auto& compilation_step) {
 				std::thread([compilation_step = std::move(compilation_step)] {
@@ -330,6 +348,8 @@ static void run_program(
 		machine.setup_linux(args, env);
 		// Linux system to open files and access internet
 		machine.setup_linux_syscalls();
+		// Nested libriscv guests may delegate their machines to us
+		machine.setup_paravirt_calls();
 		machine.fds().permit_filesystem = !cli_args.sandbox;
 		machine.fds().permit_sockets    = !cli_args.sandbox;
 		if (cli_args.proxy_mode) {
@@ -423,6 +443,13 @@ static void run_program(
 		};
 		// multi-threading
 		machine.setup_posix_threads();
+
+		// Skip the dynamic linker if its work can be restored from a snapshot
+		if (is_dynamic && !cli_args.ld_snapshot_file.empty()) {
+			const uint32_t key = ld_snapshot_key<W>(cli_args, binary, args, env);
+			if (!restore_ld_snapshot<W>(machine, cli_args.ld_snapshot_file, key, cli_args.verbose))
+				record_ld_snapshot<W>(machine, cli_args.ld_snapshot_file, key, args.at(1), cli_args.verbose);
+		}
 	}
 	else if constexpr (newlib_mini_guest)
 	{
@@ -597,6 +624,9 @@ static void run_program(
 			run_sighandler(machine);
 	}
 
+	// Report a dynamic linker snapshot that was requested, but never made
+	finish_ld_snapshot<W>(machine);
+
 	auto t1 = std::chrono::high_resolution_clock::now();
 	std::chrono::duration<double> runtime = t1 - t0;
 
@@ -638,11 +668,12 @@ static void run_program(
 #ifdef RISCV_BINARY_TRANSLATION
 	if (!cli_args.jump_hints_file.empty()) {
 		const auto jump_hints = machine.memory.gather_jump_hints();
-		if (jump_hints.size() > machine.options().translator_jump_hints.size()) {
-			store_jump_hints<W>(cli_args.jump_hints_file, jump_hints);
+		const auto branch_profile = machine.memory.gather_branch_profile();
+		if (jump_hints.size() > machine.options().translator_jump_hints.size() || !branch_profile.empty()) {
+			store_jump_hints<W>(cli_args.jump_hints_file, jump_hints, branch_profile);
 			if (cli_args.verbose)
-				printf("%zu jump hints were saved to %s\n",
-					jump_hints.size(), cli_args.jump_hints_file.c_str());
+				printf("%zu jump hints and %zu profiled branches were saved to %s\n",
+					jump_hints.size(), branch_profile.size(), cli_args.jump_hints_file.c_str());
 		}
 	}
 #endif
@@ -792,6 +823,7 @@ void run_sighandler(riscv::Machine<W>& machine)
 #include <stdexcept>
 #include <unistd.h>
 #include <fstream>
+#include <sstream>
 std::vector<uint8_t> load_file(const std::string& filename)
 {
     std::size_t size = 0;
@@ -829,6 +861,8 @@ std::vector<riscv::address_type<W>> load_jump_hints(const std::string& filename,
 	std::string line;
 	while (std::getline(file, line)) {
 		if (line.empty() || line[0] == '#') continue;
+		// Branch profile lines have counts after the address
+		if (line.find(' ') != std::string::npos) continue;
 		// Parse hex address from line
 		hints.push_back(std::stoull(line, nullptr, 16));
 		//printf("Jump hint: 0x%lX\n", long(hints.back()));
@@ -837,7 +871,31 @@ std::vector<riscv::address_type<W>> load_jump_hints(const std::string& filename,
 }
 
 template <int W>
-void store_jump_hints(const std::string& filename, const std::vector<riscv::address_type<W>>& hints)
+std::vector<riscv::TranslatorBranchHint<W>> load_branch_hints(const std::string& filename)
+{
+	std::vector<riscv::TranslatorBranchHint<W>> hints;
+	if (filename.empty())
+		return hints;
+
+	std::ifstream file(filename);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') continue;
+		// Branch profile: hex address, taken and not-taken counts
+		std::istringstream fields(line);
+		std::string addr;
+		riscv::TranslatorBranchHint<W> hint;
+		if (fields >> addr >> std::dec >> hint.taken >> hint.not_taken) {
+			hint.pc = std::stoull(addr, nullptr, 16);
+			hints.push_back(hint);
+		}
+	}
+	return hints;
+}
+
+template <int W>
+void store_jump_hints(const std::string& filename, const std::vector<riscv::address_type<W>>& hints,
+	const std::vector<riscv::TranslatorBranchHint<W>>& branches)
 {
 	std::ofstream file(filename);
 	if (!file.is_open()) {
@@ -848,4 +906,279 @@ void store_jump_hints(const std::string& filename, const std::vector<riscv::addr
 	for (auto addr : hints) {
 		file << "0x" << std::hex << addr << std::endl;
 	}
+	for (auto& branch : branches) {
+		file << "0x" << std::hex << branch.pc << std::dec
+			<< " " << branch.taken << " " << branch.not_taken << std::endl;
+	}
+}
+
+/**
+ * Dynamic linker snapshots: When the dynamic linker has loaded and relocated
+ * the program, and is about to jump to its entry point, the whole machine is
+ * serialized to a file. On later runs with the same dynamic linker, program,
+ * libraries, arguments and environment, the machine is restored directly at
+ * the program entry, skipping the dynamic linker entirely.
+ *
+ * File layout: LdSnapshotHeader, then for each object opened by the dynamic
+ * linker its CRC32-C, path length and path, and finally the serialized machine.
+**/
+struct LdSnapshotHeader {
+	static constexpr uint64_t MAGIC = 0x544F4E5350414E53; // SNAPSNOT
+	uint64_t magic;
+	uint32_t key;
+	uint32_t n_files;
+};
+
+template <int W>
+struct LdSnapshotRecorder {
+	std::string filename;
+	uint32_t key = 0;
+	bool verbose = false;
+	bool active = false;
+	// Regular files opened by the dynamic linker
+	std::vector<std::string> files;
+	// The programs entry point, as seen from the guest
+	uint64_t entry_page_offset = 0;
+	std::vector<uint8_t> entry_code;
+	// Where the dynamic linker mapped the entry point
+	uint64_t entry_addr = 0;
+	bool decoding = false;
+};
+template <int W>
+static LdSnapshotRecorder<W> ld_recorder;
+
+static bool ld_snapshot_file_crc(const std::string& path, uint32_t& crc)
+{
+	try {
+		const auto data = load_file(path);
+		crc = riscv::crc32c(data.data(), data.size());
+		return true;
+	} catch (...) {
+		return false;
+	}
+}
+
+template <int W>
+uint32_t ld_snapshot_key(const Arguments& cli_args, std::string_view dynamic_linker,
+	const std::vector<std::string>& args, const std::vector<std::string>& env)
+{
+	// The initial stack (and hence everything the dynamic linker does)
+	// depends on the arguments and environment, as well as on the layout.
+	uint32_t key = riscv::crc32c(dynamic_linker.data(), dynamic_linker.size());
+	for (const auto& arg : args)
+		key = riscv::crc32c(key, arg.c_str(), arg.size() + 1);
+	for (const auto& var : env)
+		key = riscv::crc32c(key, var.c_str(), var.size() + 1);
+	const uint64_t layout[] = { W, MAX_MEMORY, cli_args.execute_only, cli_args.ignore_text };
+	return riscv::crc32c(key, layout, sizeof(layout));
+}
+
+template <int W>
+bool restore_ld_snapshot(riscv::Machine<W>& machine, const std::string& filename, uint32_t key, bool verbose)
+{
+	std::vector<uint8_t> data;
+	try {
+		data = load_file(filename);
+	} catch (...) {
+		return false;
+	}
+	LdSnapshotHeader hdr;
+	if (data.size() < sizeof(hdr))
+		return false;
+	std::memcpy(&hdr, data.data(), sizeof(hdr));
+	if (hdr.magic != LdSnapshotHeader::MAGIC || hdr.key != key) {
+		if (verbose)
+			printf("* Dynamic linker snapshot %s is stale\n", filename.c_str());
+		return false;
+	}
+
+	// Verify that every object mapped by the dynamic linker is unchanged
+	size_t off = sizeof(hdr);
+	for (uint32_t i = 0; i < hdr.n_files; i++) {
+		uint32_t expected_crc, len;
+		if (off + 8 > data.size())
+			return false;
+		std::memcpy(&expected_crc, &data[off], 4);
+		std::memcpy(&len, &data[off + 4], 4);
+		off += 8;
+		if (off + len > data.size())
+			return false;
+		const std::string path((const char *)&data[off], len);
+		off += len;
+
+		uint32_t crc;
+		if (!ld_snapshot_file_crc(path, crc) || crc != expected_crc) {
+			if (verbose)
+				printf("* Dynamic linker snapshot is stale: %s changed\n", path.c_str());
+			return false;
+		}
+	}
+
+	const std::vector<uint8_t> state(data.begin() + off, data.end());
+	if (machine.deserialize_from(state) != 0) {
+		fprintf(stderr, "Warning: Dynamic linker snapshot %s could not be restored\n", filename.c_str());
+		return false;
+	}
+	if (verbose)
+		printf("* Restored dynamic linker snapshot %s (entry at 0x%" PRIX64 ")\n",
+			filename.c_str(), uint64_t(machine.cpu.pc()));
+	return true;
+}
+
+template <int W>
+static void store_ld_snapshot(riscv::Machine<W>& machine)
+{
+	auto& rec = ld_recorder<W>;
+	std::vector<uint8_t> data(sizeof(LdSnapshotHeader));
+	const LdSnapshotHeader hdr {
+		.magic = LdSnapshotHeader::MAGIC,
+		.key   = rec.key,
+		.n_files = uint32_t(rec.files.size()),
+	};
+	std::memcpy(data.data(), &hdr, sizeof(hdr));
+	for (const auto& path : rec.files) {
+		uint32_t crc = 0;
+		ld_snapshot_file_crc(path, crc);
+		const uint32_t len = path.size();
+		data.insert(data.end(), (const uint8_t *)&crc, (const uint8_t *)&crc + 4);
+		data.insert(data.end(), (const uint8_t *)&len, (const uint8_t *)&len + 4);
+		data.insert(data.end(), path.begin(), path.end());
+	}
+	machine.serialize_to(data);
+
+	std::ofstream file(rec.filename, std::ios::binary);
+	if (!file.is_open() || !file.write((const char *)data.data(), data.size())) {
+		fprintf(stderr, "Could not write dynamic linker snapshot: %s\n", rec.filename.c_str());
+		return;
+	}
+	if (rec.verbose)
+		printf("* Recorded dynamic linker snapshot %s (%zu objects, %zu bytes)\n",
+			rec.filename.c_str(), rec.files.size(), data.size());
+}
+
+template <int W>
+static uint64_t find_ld_snapshot_entry(riscv::Machine<W>& machine)
+{
+	// Look for the entry code in the execute pages around PC, which
+	// are the ones that make up the new execute segment.
+	auto& rec = ld_recorder<W>;
+	auto& memory = machine.memory;
+	const uint64_t pageno = machine.cpu.pc() / riscv::Page::size();
+	uint64_t begin = pageno;
+	while (begin > 0 && memory.get_pageno(begin-1).attr.exec)
+		begin--;
+	std::vector<uint8_t> code(rec.entry_code.size());
+	for (uint64_t p = begin; p == pageno || memory.get_pageno(p).attr.exec; p++) {
+		const uint64_t addr = p * riscv::Page::size() + rec.entry_page_offset;
+		try {
+			memory.memcpy_out(code.data(), addr, code.size());
+		} catch (...) {
+			continue;
+		}
+		if (code == rec.entry_code)
+			return addr;
+	}
+	return 0;
+}
+
+template <int W>
+void record_ld_snapshot(riscv::Machine<W>& machine, const std::string& filename, uint32_t key,
+	const std::string& program, bool verbose)
+{
+	using Elf = riscv::Elf<W>;
+	auto& rec = ld_recorder<W>;
+	rec = LdSnapshotRecorder<W>{};
+	rec.filename = filename;
+	rec.key = key;
+	rec.verbose = verbose;
+
+	// Find the code at the programs entry point, so that we can
+	// recognize it wherever the dynamic linker decides to map it.
+	std::vector<uint8_t> bin;
+	try {
+		bin = load_file(program);
+	} catch (...) {
+	}
+	if (bin.size() >= sizeof(typename Elf::Header)
+		&& Elf::validate(std::string_view((const char *)bin.data(), bin.size())))
+	{
+		const auto& ehdr = *(const typename Elf::Header *)bin.data();
+		for (size_t i = 0; i < ehdr.e_phnum; i++) {
+			const size_t phoff = ehdr.e_phoff + i * sizeof(typename Elf::ProgramHeader);
+			if (phoff + sizeof(typename Elf::ProgramHeader) > bin.size())
+				break;
+			const auto& phdr = *(const typename Elf::ProgramHeader *)&bin[phoff];
+			if (phdr.p_type == Elf::PT_LOAD && ehdr.e_entry >= phdr.p_vaddr && ehdr.e_entry < phdr.p_vaddr + phdr.p_filesz) {
+				const size_t offset = ehdr.e_entry - phdr.p_vaddr + phdr.p_offset;
+				const size_t len = std::min(size_t(64), size_t(phdr.p_vaddr + phdr.p_filesz - ehdr.e_entry));
+				if (offset + len > bin.size())
+					break;
+				rec.entry_page_offset = ehdr.e_entry % riscv::Page::size();
+				rec.entry_code.assign(&bin[offset], &bin[offset + len]);
+			}
+		}
+	}
+	if (rec.entry_code.empty()) {
+		fprintf(stderr, "Error: Dynamic linker snapshot %s cannot be recorded: "
+			"The entry point of %s was not found\n", filename.c_str(), program.c_str());
+		return;
+	}
+	rec.active = true;
+
+	// Remember every regular file the dynamic linker opens
+	machine.fds().filter_open = [filter = std::move(machine.fds().filter_open)] (void* user, std::string& path) {
+		if (!filter(user, path))
+			return false;
+		auto& rec = ld_recorder<W>;
+		std::error_code ec;
+		if (rec.active && std::filesystem::is_regular_file(path, ec)
+			&& std::find(rec.files.begin(), rec.files.end(), path) == rec.files.end())
+			rec.files.push_back(path);
+		return true;
+	};
+
+	// The programs execute segment may be decoded before the entry point
+	// is reached, eg. when the dynamic linker runs its constructors. So we
+	// look for the entry point in every new execute segment, and place
+	// a breakpoint there.
+	machine.cpu.set_override_new_execute_segment(
+	[] (riscv::CPU<W>& cpu) -> riscv::DecodedExecuteSegment<W>& {
+		auto& rec = ld_recorder<W>;
+		if (!rec.active || rec.entry_addr != 0 || rec.decoding)
+			return *riscv::CPU<W>::empty_execute_segment();
+		const auto entry = find_ld_snapshot_entry(cpu.machine());
+		if (entry == 0)
+			return *riscv::CPU<W>::empty_execute_segment();
+		rec.entry_addr = entry;
+		// Decode the new segment here, so that we can modify it
+		rec.decoding = true;
+		auto next = cpu.next_execute_segment(cpu.pc());
+		rec.decoding = false;
+		riscv::CPU<W>::install_ebreak_for(*next.exec, entry);
+		return *next.exec;
+	});
+	machine.install_syscall_handler(riscv::SYSCALL_EBREAK,
+	[] (riscv::Machine<W>& machine) {
+		auto& rec = ld_recorder<W>;
+		if (rec.entry_addr == 0 || machine.cpu.pc() != rec.entry_addr)
+			throw riscv::MachineException(riscv::UNHANDLED_SYSCALL, "EBREAK instruction", machine.cpu.pc());
+		// The dynamic linker is done when the entry point is first reached
+		if (rec.active) {
+			rec.active = false;
+			store_ld_snapshot(machine);
+		}
+		// Execute the instruction that the breakpoint replaced
+		machine.cpu.step_one(false);
+	});
+}
+
+template <int W>
+void finish_ld_snapshot(riscv::Machine<W>&)
+{
+	auto& rec = ld_recorder<W>;
+	if (rec.active) {
+		rec.active = false;
+		fprintf(stderr, "Error: Dynamic linker snapshot %s was not recorded: "
+			"The program entry point was never reached\n", rec.filename.c_str());
+	}
 }
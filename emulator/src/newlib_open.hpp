@@ -7,7 +7,7 @@ if (machine.has_file_descriptors() && machine.fds().permit_filesystem) {
 
 	if (machine.fds().filter_open != nullptr) {
 		// filter_open() can modify the path
-		if (!machine.fds().filter_open(machine.template get_userdata<void>(), path)) {
+		if (!machine.fds().apply_filter_open(machine.template get_userdata<void>(), path)) {
 			machine.set_result(-EPERM);
 			return;
 		}
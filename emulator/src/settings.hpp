@@ -4,7 +4,21 @@
 template <int W>
 static std::vector<riscv::address_type<W>> load_jump_hints(const std::string& filename, bool verbose = false);
 template <int W>
-static void store_jump_hints(const std::string& filename, const std::vector<riscv::address_type<W>>& hints);
+static std::vector<riscv::TranslatorBranchHint<W>> load_branch_hints(const std::string& filename);
+template <int W>
+static void store_jump_hints(const std::string& filename, const std::vector<riscv::address_type<W>>& hints,
+	const std::vector<riscv::TranslatorBranchHint<W>>& branches);
+struct Arguments;
+template <int W>
+static uint32_t ld_snapshot_key(const Arguments&, std::string_view dynamic_linker,
+	const std::vector<std::string>& args, const std::vector<std::string>& env);
+template <int W>
+static bool restore_ld_snapshot(riscv::Machine<W>&, const std::string& filename, uint32_t key, bool verbose);
+template <int W>
+static void record_ld_snapshot(riscv::Machine<W>&, const std::string& filename, uint32_t key,
+	const std::string& program, bool verbose);
+template <int W>
+static void finish_ld_snapshot(riscv::Machine<W>&);
 
 #if defined(EMULATOR_MODE_LINUX)
 	static constexpr bool full_linux_guest = true;
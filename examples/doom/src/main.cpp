@@ -20,9 +20,11 @@ static SDL_Surface* screen_surface = nullptr;
 static SDL_Texture* screen_tex = nullptr;
 static struct {
 	SDL_Surface* surface = nullptr;
-	uint32_t g_pixels = 0x0;
+	// The guest framebuffer, read in place without copying
+	riscv::MemorySurface<ARCH>* framebuffer = nullptr;
 	std::vector<uint8_t> buffer;
 	std::vector<SDL_Color> palette;
+	bool palette_changed = false;
 } pixels;
 
 struct DoomEvent {
@@ -69,10 +71,13 @@ struct {
 	int64_t  adjust = 16700000L;
 } stats;
 
-static void do_rendering(Machine& machine)
+static void do_rendering(Machine& machine, bool redraw)
 {
-	SDL_BlitSurface(pixels.surface, nullptr, screen_surface, nullptr);
-	SDL_UpdateTexture(screen_tex, nullptr, screen_surface->pixels, screen_surface->pitch);
+	// Only convert the frame when the guest has drawn to it
+	if (redraw) {
+		SDL_BlitSurface(pixels.surface, nullptr, screen_surface, nullptr);
+		SDL_UpdateTexture(screen_tex, nullptr, screen_surface->pixels, screen_surface->pitch);
+	}
 	SDL_RenderCopy(renderer, screen_tex, nullptr, nullptr);
 	SDL_RenderPresent(renderer);
 
@@ -169,14 +174,17 @@ static void doom_system_calls(Machine& machine, size_t num)
 	}
 	case 2049: { // AV set_framebuffer
 		const auto pixel_addr = machine.sysarg (0);
-		pixels.g_pixels = pixel_addr;
+		if (pixels.framebuffer)
+			machine.memory.release_surface(*pixels.framebuffer);
+		pixels.framebuffer = &machine.memory.export_surface(pixel_addr, GAME_W * GAME_H);
+		pixels.surface->pixels = pixels.framebuffer->data();
 		machine.set_result(0);
 		return;
 	}
 	case 2050: { // AV update
-		machine.copy_from_guest(
-			pixels.buffer.data(), pixels.g_pixels, pixels.buffer.size());
-		do_rendering(machine);
+		const bool drawn = pixels.framebuffer && pixels.framebuffer->acquire();
+		do_rendering(machine, drawn || pixels.palette_changed);
+		pixels.palette_changed = false;
 		machine.set_result(0);
 		return;
 	}
@@ -187,6 +195,7 @@ static void doom_system_calls(Machine& machine, size_t num)
 		pixels.palette.resize(count);
 		machine.copy_from_guest(pixels.palette.data(), g_pal, sizeof(SDL_Color) * count);
 		SDL_SetPaletteColors(pixels.surface->format->palette, pixels.palette.data(), 0, count);
+		pixels.palette_changed = true;
 		machine.set_result(0);
 		return;
 	}
@@ -36,7 +36,18 @@ int main(int argc, char** argv)
 	machine.setup_linux_syscalls();
 
 	// Run the program, but timeout after 128bn instructions
-	machine.simulate(128'000'000'000ull);
-
-	std::cout << "Program exited with status: " << machine.return_value<long>() << std::endl;
+	// Faults and timeouts are returned as a status instead of thrown
+	switch (machine.try_simulate(128'000'000'000ull)) {
+	case MACHINE_STOPPED:
+		std::cout << "Program exited with status: " << machine.return_value<long>() << std::endl;
+		return 0;
+	case MACHINE_TIMEOUT:
+		std::cout << "Program timed out" << std::endl;
+		return -1;
+	case MACHINE_FAULT:
+		std::cout << "Program faulted: " << machine.fault().message
+			<< " (data: 0x" << std::hex << machine.fault().data << ")" << std::endl;
+		return -1;
+	}
+	return -1;
 }
@@ -231,6 +231,28 @@ INSTRUCTION(RV32I_BC_BGEU, rv32i_bgeu) {
 	}
 	NEXT_BLOCK(4, false);
 }
+#ifdef RISCV_BINARY_TRANSLATION
+INSTRUCTION(RV32I_BC_BRANCH_PROFILE, rv32i_branch_profile) {
+	VIEW_INSTR_AS(bi, ProfiledBtype);
+	auto& fi = exec->branch_counters(bi.counters);
+	const auto src1 = REG(bi.get_rs1());
+	const auto src2 = REG(bi.get_rs2());
+	bool taken;
+	switch (bi.funct3) {
+	case 0x0: taken = src1 == src2; break;
+	case 0x1: taken = src1 != src2; break;
+	case 0x4: taken = (saddr_t)src1 < (saddr_t)src2; break;
+	case 0x5: taken = (saddr_t)src1 >= (saddr_t)src2; break;
+	case 0x6: taken = src1 < src2; break;
+	default:  taken = src1 >= src2; break;
+	}
+	fi.counts[taken].fetch_add(1, std::memory_order_relaxed);
+	if (taken) {
+		PERFORM_BRANCH();
+	}
+	NEXT_BLOCK(bi.length(), false);
+}
+#endif // RISCV_BINARY_TRANSLATION
 
 
 INSTRUCTION(RV32I_BC_LDW, rv32i_ldw) {
@@ -567,6 +589,282 @@ INSTRUCTION(RV32F_BC_FMADD, rv32f_fmadd) {
 	}
 	NEXT_INSTR();
 }
+INSTRUCTION(RV32F_BC_FSGNJ, rv32f_fsgnj) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	FLREGS();
+	switch (fi.func) {
+	case 0x0: // FSGNJ.S
+		dst.load_u32((rs2.lsign.sign << 31) | rs1.lsign.bits);
+		break;
+	case 0x1: // FSGNJN.S
+		dst.load_u32((~rs2.lsign.sign << 31) | rs1.lsign.bits);
+		break;
+	case 0x2: // FSGNJX.S
+		dst.load_u32(((rs1.lsign.sign ^ rs2.lsign.sign) << 31) | rs1.lsign.bits);
+		break;
+	case 0x10: // FSGNJ.D
+		dst.i64 = ((uint64_t) rs2.usign.sign << 63) | rs1.usign.bits;
+		break;
+	case 0x11: // FSGNJN.D
+		dst.i64 = (~(uint64_t) rs2.usign.sign << 63) | rs1.usign.bits;
+		break;
+	default: // FSGNJX.D
+		dst.i64 = ((uint64_t)(rs1.usign.sign ^ rs2.usign.sign) << 63) | rs1.usign.bits;
+		break;
+	}
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FMINMAX, rv32f_fminmax) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	FLREGS();
+	switch (fi.func) {
+	case 0x0: // FMIN.S
+		dst.set_float(std::fmin(rs1.f32[0], rs2.f32[0]));
+		break;
+	case 0x1: // FMAX.S
+		dst.set_float(std::fmax(rs1.f32[0], rs2.f32[0]));
+		break;
+	case 0x10: // FMIN.D
+		dst.f64 = std::fmin(rs1.f64, rs2.f64);
+		break;
+	default: // FMAX.D
+		dst.f64 = std::fmax(rs1.f64, rs2.f64);
+		break;
+	}
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FCMP, rv32f_fcmp) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	auto& dst = REG(fi.get_rd());
+	const auto& rs1 = REGISTERS().getfl(fi.get_rs1());
+	const auto& rs2 = REGISTERS().getfl(fi.get_rs2());
+	switch (fi.func) {
+	case 0x0: // FLE.S
+		dst = (rs1.f32[0] <= rs2.f32[0]);
+		break;
+	case 0x1: // FLT.S
+		dst = (rs1.f32[0] < rs2.f32[0]);
+		break;
+	case 0x2: // FEQ.S
+		dst = (rs1.f32[0] == rs2.f32[0]);
+		break;
+	case 0x10: // FLE.D
+		dst = (rs1.f64 <= rs2.f64);
+		break;
+	case 0x11: // FLT.D
+		dst = (rs1.f64 < rs2.f64);
+		break;
+	default: // FEQ.D
+		dst = (rs1.f64 == rs2.f64);
+		break;
+	}
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FCVT_SD_DS, rv32f_fcvt_sd_ds) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	auto& dst = REGISTERS().getfl(fi.get_rd());
+	const auto& rs1 = REGISTERS().getfl(fi.get_rs1());
+	if (fi.func < 0x10) // FCVT.S.D
+		dst.set_float(rs1.f64);
+	else // FCVT.D.S
+		dst.f64 = rs1.f32[0];
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FCVT_W_SD, rv32f_fcvt_w_sd) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	auto& dst = REG(fi.get_rd());
+	const auto& rs1 = REGISTERS().getfl(fi.get_rs1());
+	switch (fi.func) {
+	case 0x0: // FCVT.W.S
+		dst = (int32_t) rs1.f32[0];
+		break;
+	case 0x1: // FCVT.WU.S
+		dst = (saddr_t)(int32_t)(uint32_t) rs1.f32[0];
+		break;
+	case 0x2: // FCVT.L.S
+		dst = (int64_t) rs1.f32[0];
+		break;
+	case 0x3: // FCVT.LU.S
+		dst = (uint64_t) rs1.f32[0];
+		break;
+	case 0x10: // FCVT.W.D
+		dst = (int32_t) rs1.f64;
+		break;
+	case 0x11: // FCVT.WU.D
+		dst = (saddr_t)(int32_t)(uint32_t) rs1.f64;
+		break;
+	case 0x12: // FCVT.L.D
+		dst = (int64_t) rs1.f64;
+		break;
+	default: // FCVT.LU.D
+		dst = (uint64_t) rs1.f64;
+		break;
+	}
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FCVT_SD_W, rv32f_fcvt_sd_w) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	auto& dst = REGISTERS().getfl(fi.get_rd());
+	const auto src = REG(fi.get_rs1());
+	switch (fi.func) {
+	case 0x0: // FCVT.S.W
+		dst.set_float((int32_t) src);
+		break;
+	case 0x1: // FCVT.S.WU
+		dst.set_float((uint32_t) src);
+		break;
+	case 0x2: // FCVT.S.L
+		dst.set_float((saddr_t) src);
+		break;
+	case 0x3: // FCVT.S.LU
+		dst.set_float(src);
+		break;
+	case 0x10: // FCVT.D.W
+		dst.f64 = (int32_t) src;
+		break;
+	case 0x11: // FCVT.D.WU
+		dst.f64 = (uint32_t) src;
+		break;
+	case 0x12: // FCVT.D.L
+		dst.f64 = (saddr_t) src;
+		break;
+	default: // FCVT.D.LU
+		dst.f64 = src;
+		break;
+	}
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FMV_X_W, rv32f_fmv_x_w) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	const auto& rs1 = REGISTERS().getfl(fi.get_rs1());
+	if (fi.func < 0x10) // FMV.X.W (sign-extended)
+		REG(fi.get_rd()) = (saddr_t) rs1.i32[0];
+	else // FMV.X.D
+		REG(fi.get_rd()) = rs1.i64;
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32F_BC_FMV_W_X, rv32f_fmv_w_x) {
+	VIEW_INSTR_AS(fi, FasterFloatType);
+	auto& dst = REGISTERS().getfl(fi.get_rd());
+	if (fi.func < 0x10) // FMV.W.X
+		dst.load_u32(REG(fi.get_rs1()));
+	else // FMV.D.X
+		dst.load_u64(REG(fi.get_rs1()));
+	NEXT_INSTR();
+}
+
+#ifdef RISCV_EXT_ATOMICS
+INSTRUCTION(RV32A_BC_LR_W, rv32a_lr_w) {
+	VIEW_INSTR_AS(fi, FasterOpType);
+	const auto addr = REG(fi.get_rs1());
+	if (UNLIKELY(!CPU().atomics().load_reserve(4, addr)))
+		CPU().trigger_exception(DEADLOCK_REACHED);
+	const saddr_t value = (int32_t)CPU().memory().template read<uint32_t>(addr);
+	CPU().atomics().set_reserved_value(value);
+	if (fi.get_rd() != 0)
+		REG(fi.get_rd()) = value;
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32A_BC_SC_W, rv32a_sc_w) {
+	VIEW_INSTR_AS(fi, FasterOpType);
+	const auto addr = REG(fi.get_rs1());
+	bool resv = CPU().atomics().store_conditional(4, addr);
+	if (resv) {
+		auto& mem = CPU().memory().template writable_read<uint32_t>(addr);
+		resv = CPU().atomics().compare_and_store(mem, uint32_t(REG(fi.get_rs2())));
+	}
+	// Write non-zero value to RD on failure
+	if (fi.get_rd() != 0)
+		REG(fi.get_rd()) = !resv;
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32A_BC_AMOADD_W, rv32a_amoadd_w) {
+	VIEW_INSTR_AS(fi, FasterOpType);
+	const auto addr = REG(fi.get_rs1());
+	if (UNLIKELY(addr % 4 != 0))
+		CPU().trigger_exception(INVALID_ALIGNMENT, addr);
+	auto& mem = CPU().memory().template writable_read<uint32_t>(addr);
+	// NOTE: rs2 is read before rd is written, as they may be the same
+	const uint32_t old_value =
+		CPU().atomics().fetch_add(mem, uint32_t(REG(fi.get_rs2())));
+	if (fi.get_rd() != 0)
+		REG(fi.get_rd()) = (int32_t)old_value;
+	NEXT_INSTR();
+}
+INSTRUCTION(RV32A_BC_AMOSWAP_W, rv32a_amoswap_w) {
+	VIEW_INSTR_AS(fi, FasterOpType);
+	const auto addr = REG(fi.get_rs1());
+	if (UNLIKELY(addr % 4 != 0))
+		CPU().trigger_exception(INVALID_ALIGNMENT, addr);
+	auto& mem = CPU().memory().template writable_read<uint32_t>(addr);
+	const uint32_t old_value =
+		CPU().atomics().exchange(mem, uint32_t(REG(fi.get_rs2())));
+	if (fi.get_rd() != 0)
+		REG(fi.get_rd()) = (int32_t)old_value;
+	NEXT_INSTR();
+}
+#ifdef RISCV_64I
+INSTRUCTION(RV64A_BC_LR_D, rv64a_lr_d) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(fi, FasterOpType);
+		const auto addr = REG(fi.get_rs1());
+		if (UNLIKELY(!CPU().atomics().load_reserve(8, addr)))
+			CPU().trigger_exception(DEADLOCK_REACHED);
+		const saddr_t value = (int64_t)CPU().memory().template read<uint64_t>(addr);
+		CPU().atomics().set_reserved_value(value);
+		if (fi.get_rd() != 0)
+			REG(fi.get_rd()) = value;
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV64A_BC_SC_D, rv64a_sc_d) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(fi, FasterOpType);
+		const auto addr = REG(fi.get_rs1());
+		bool resv = CPU().atomics().store_conditional(8, addr);
+		if (resv) {
+			auto& mem = CPU().memory().template writable_read<uint64_t>(addr);
+			resv = CPU().atomics().compare_and_store(mem, uint64_t(REG(fi.get_rs2())));
+		}
+		if (fi.get_rd() != 0)
+			REG(fi.get_rd()) = !resv;
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV64A_BC_AMOADD_D, rv64a_amoadd_d) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(fi, FasterOpType);
+		const auto addr = REG(fi.get_rs1());
+		if (UNLIKELY(addr % 8 != 0))
+			CPU().trigger_exception(INVALID_ALIGNMENT, addr);
+		auto& mem = CPU().memory().template writable_read<uint64_t>(addr);
+		const uint64_t old_value =
+			CPU().atomics().fetch_add(mem, uint64_t(REG(fi.get_rs2())));
+		if (fi.get_rd() != 0)
+			REG(fi.get_rd()) = (int64_t)old_value;
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+INSTRUCTION(RV64A_BC_AMOSWAP_D, rv64a_amoswap_d) {
+	if constexpr (W >= 8) {
+		VIEW_INSTR_AS(fi, FasterOpType);
+		const auto addr = REG(fi.get_rs1());
+		if (UNLIKELY(addr % 8 != 0))
+			CPU().trigger_exception(INVALID_ALIGNMENT, addr);
+		auto& mem = CPU().memory().template writable_read<uint64_t>(addr);
+		const uint64_t old_value =
+			CPU().atomics().exchange(mem, uint64_t(REG(fi.get_rs2())));
+		if (fi.get_rd() != 0)
+			REG(fi.get_rd()) = (int64_t)old_value;
+		NEXT_INSTR();
+	}
+	else UNUSED_FUNCTION();
+}
+#endif // RISCV_64I
+#endif // RISCV_EXT_ATOMICS
 
 
 INSTRUCTION(RV32I_BC_FUNCTION, execute_decoded_function)
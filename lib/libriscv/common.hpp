@@ -77,6 +77,43 @@ namespace riscv
 	};
 	using MachineTranslationOptions = std::variant<MachineTranslationCrossOptions, MachineTranslationEmbeddableCodeOptions>;
 
+	/// @brief Taken and not-taken counts of a conditional branch, as recorded
+	/// by MachineOptions::record_branch_profile. See Memory::gather_branch_profile().
+	template <int W>
+	struct TranslatorBranchHint
+	{
+		address_type<W> pc = 0;
+		uint64_t taken = 0;
+		uint64_t not_taken = 0;
+	};
+
+	/// @brief Hard per-machine limits on resources that are not covered by
+	/// memory_max and the instruction limit. Exceeding any of them throws a
+	/// MachineException of type RESOURCE_LIMIT_REACHED, with the limit as data.
+	/// See Machine::set_resource_limits() and Machine::resource_usage().
+	struct ResourceLimits
+	{
+		/// @brief Pages owned by the machine (not the arena, not shared)
+		uint64_t owned_pages = UINT64_MAX;
+		/// @brief Open files, sockets and virtual files
+		uint32_t file_descriptors = UINT32_MAX;
+		/// @brief Guest threads, including the main thread
+		uint32_t threads = 50;
+		/// @brief Execute segments, including the main program
+		uint32_t execute_segments = RISCV_MAX_EXECUTE_SEGS;
+		/// @brief Native heap chunks, both used and free
+		uint32_t heap_chunks = 4000;
+	};
+	/// @brief Current resource usage, maintained at allocation sites
+	struct ResourceUsage
+	{
+		uint64_t owned_pages = 0;
+		uint32_t file_descriptors = 0;
+		uint32_t threads = 0;
+		uint32_t execute_segments = 0;
+		uint32_t heap_chunks = 0;
+	};
+
 	/// @brief Options passed to Machine constructor
 	/// @tparam W The RISC-V architecture
 	template <int W>
@@ -125,6 +162,13 @@ namespace riscv
 		/// locality and also enables read-write arena if the CMake option is ON.
 		bool use_memory_arena = true;
 
+		/// @brief Mirror guest page protections (eg. from mprotect) inside the
+		/// flat arena onto the host mapping, so that guard pages, write barriers
+		/// and W^X flips are enforced without leaving the arena fast-path.
+		/// Host faults become guest protection faults. Forks share the
+		/// protections of the main machine. Only available on Linux.
+		bool use_arena_host_protections = false;
+
 		/// @brief Enable sharing of execute segments between machines.
 		/// @details This will allow multiple machines to share the same execute
 		/// segment, reducing memory usage and increasing performance.
@@ -155,6 +199,14 @@ namespace riscv
 		/// @brief Translate not just the initial execute segments of the ELF program,
 		/// but also any future shared objects or JIT-produced segments.
 		bool translate_future_segments = true;
+		/// @brief Translate execute segments that are likely produced by a guest JIT
+		/// (both writable and executable) once they have been entered this many times
+		/// without being rewritten. 0 disables translation of JIT segments.
+		/// @details The translation is live-patched in, and is compiled in the background
+		/// when translate_background_callback is set. It is dropped along with the
+		/// segment when the guest flushes the instruction cache (riscv_flush_icache).
+		/// Like other non-initial segments, this requires Machine::set_options().
+		unsigned translate_jit_segments_after = 0;
 		/// @brief Enable compiling execute segment on-demand during emulation.
 		/// @details Not available on most Windows systems.
 #ifdef _WIN32
@@ -193,10 +245,22 @@ namespace riscv
 		/// @details This will allow the binary translator to use and-masked addresses
 		/// for all memory accesses, which can drastically improve performance.
 		bool translate_automatic_nbit_address_space = false;
+		/// @brief Produce translations that do not depend on where the execute segment
+		/// is loaded, so that eg. a shared library is translated once and reused at any base.
+		/// @details Guest PCs are emitted relative to the segment base, which is looked
+		/// up when entering translated code, and the translation hash no longer includes
+		/// the load address. Constant-folding of PC-relative values is disabled.
+		bool translate_relocatable = false;
 		/// @brief Enable recording of slowpaths to jump hints for the binary translator.
 		/// @details This will record slowpaths to the MachineOptions jump hints vector.
 		/// From there the CLI can save the jump hints to a file after the program has run.
 		bool record_slowpaths_to_jump_hints = false;
+		/// @brief Enable recording of taken/not-taken counts for the conditional
+		/// branches executed by the interpreter, see Memory::gather_branch_profile().
+		/// @details Branches are slower to interpret while recording. Feed the profile
+		/// back through translator_branch_hints in order to translate strongly biased
+		/// branches with LIKELY/UNLIKELY annotations.
+		bool record_branch_profile = false;
 		/// @brief Prefix for the translation output file.
 		std::string translation_prefix = "/tmp/rvbintr-";
 		/// @brief Suffix for the translation output file. Eg. .dll or .so
@@ -209,6 +273,9 @@ namespace riscv
 		/// @brief Jump location hints for the binary translator.
 		/// @details These hints can improve performance of the binary translation.
 		std::vector<address_type<W>> translator_jump_hints {};
+		/// @brief Branch profile hints for the binary translator.
+		/// @details Changing which branches are strongly biased changes the translation.
+		std::vector<TranslatorBranchHint<W>> translator_branch_hints {};
 		/// @brief Enable background compilation of shared objects. The compilation step
 		/// will be executed from a user-provided callback, and will be applied to the machine
 		/// when ready. Applying the translation is thread-safe and will take effect on all
@@ -246,6 +313,9 @@ namespace riscv
 	};
 
 	static constexpr int SYSCALL_EBREAK = RISCV_SYSCALL_EBREAK_NR;
+	// Signals queued from other threads are delivered in-between
+	// slices of this many instructions (see Machine::queue_signal)
+	static constexpr uint64_t SIGNAL_SLICE = 1'000'000ul;
 
 	static constexpr size_t PageSize = RISCV_PAGE_SIZE;
 	static constexpr size_t PageMask = RISCV_PAGE_SIZE-1;
@@ -5,10 +5,29 @@
 #include "riscvbase.hpp"
 #include "rv32i_instr.hpp"
 #include "threaded_bytecodes.hpp"
+#include <optional>
 //#define TIME_EXECUTION
 
 namespace riscv
 {
+	void FaultLandingPad::raise(int type, const char* message, uint64_t data)
+	{
+		if (FaultLandingPad* pad = current; pad != nullptr) {
+			pad->fault = { type, message, data };
+			std::longjmp(pad->buffer, 1);
+		}
+		if (type == MAX_INSTRUCTIONS_REACHED)
+			throw MachineTimeoutException(type, message, data);
+		throw MachineException(type, message, data);
+	}
+
+	void FaultLandingPad::relay()
+	{
+		if (current == this)
+			current = prev;
+		raise(fault.type, fault.message, fault.data);
+	}
+
 #ifdef TIME_EXECUTION
 	static timespec time_now()
 	{
@@ -97,6 +116,16 @@ restart_next_execute_segment:
 		// Find previously decoded execute segment
 		this->m_exec = machine().memory.exec_segment_for(pc).get();
 		if (LIKELY(!this->m_exec->empty() && !this->m_exec->is_stale())) {
+#ifdef RISCV_BINARY_TRANSLATION
+			// Translate guest JIT code once it has stayed hot and unchanged
+			if (UNLIKELY(this->m_exec->is_likely_jit()) && machine().has_options()) {
+				const unsigned after = machine().options().translate_jit_segments_after;
+				if (after != 0 && this->m_exec->jit_entered() == after)
+					this->translate_jit_segment(*this->m_exec);
+				if (UNLIKELY(this->m_exec->is_stale()))
+					goto restart_next_execute_segment;
+			}
+#endif
 			return {this->m_exec, pc};
 		}
 
@@ -113,7 +142,10 @@ restart_next_execute_segment:
 		const auto& current_page =
 			machine().memory.get_pageno(base_pageno);
 		if (UNLIKELY(!current_page.attr.exec)) {
-			this->m_fault(*this, current_page);
+			{
+				ScopedThrowingFaults throwing_faults;
+				this->m_fault(*this, current_page);
+			}
 			pc = this->pc();
 
 			if (UNLIKELY(++restarts == MAX_RESTARTS))
@@ -146,7 +178,10 @@ restart_next_execute_segment:
 
 		// Find decoded execute segment via override
 		// If it returns empty, we build a new execute segment
-		auto& next = this->m_override_exec(*this);
+		auto& next = [&] () -> DecodedExecuteSegment<W>& {
+			ScopedThrowingFaults throwing_faults;
+			return this->m_override_exec(*this);
+		}();
 		if (!next.empty()) {
 			this->m_exec = &next;
 			return {this->m_exec, this->registers().pc};
@@ -329,6 +364,24 @@ restart_precise_sim:
 	{
 		auto& m = machine();
 		const auto prev_max = m.max_instructions();
+		// The caller continues in its own execute segment
+		auto* prev_exec = this->m_exec;
+		auto restore = [&] {
+			m.set_max_instructions(prev_max);
+			this->m_exec = prev_exec;
+			if (store_regs) {
+				this->registers() = old_regs;
+			}
+		};
+		// Faults that would land outside of us must restore state first
+		std::optional<FaultLandingPad> pad;
+		if (FaultLandingPad::active()) {
+			pad.emplace();
+			if (setjmp(pad->buffer) != 0) {
+				restore();
+				pad->relay();
+			}
+		}
 		try {
 			// execute by extending the max instruction counter (resuming)
 			// WARNING: Do not change this, as resumption is required in
@@ -337,14 +390,12 @@ restart_precise_sim:
 			m.simulate_with(
 				m.instruction_counter() + max_instr, m.instruction_counter(), pc);
 		} catch (...) {
-			m.set_max_instructions(prev_max);
-			if (store_regs) {
-				this->registers() = old_regs;
-			}
+			restore();
 			throw;
 		}
 		// restore registers and return value
 		m.set_max_instructions(prev_max);
+		this->m_exec = prev_exec;
 		const auto retval = this->reg(REG_ARG0);
 		if (store_regs) {
 			this->registers() = old_regs;
@@ -502,47 +553,39 @@ restart_precise_sim:
 	template<int W> RISCV_COLD_PATH()
 	void CPU<W>::trigger_exception(int intr, address_t data)
 	{
+		const char* msg;
 		switch (intr)
 		{
 		case INVALID_PROGRAM:
-			throw MachineException(intr,
-				"Machine not initialized", data);
+			msg = "Machine not initialized"; break;
 		case ILLEGAL_OPCODE:
-			throw MachineException(intr,
-					"Illegal opcode executed", data);
+			msg = "Illegal opcode executed"; break;
 		case ILLEGAL_OPERATION:
-			throw MachineException(intr,
-					"Illegal operation during instruction decoding", data);
+			msg = "Illegal operation during instruction decoding"; break;
 		case PROTECTION_FAULT:
-			throw MachineException(intr,
-					"Protection fault", data);
+			msg = "Protection fault"; break;
 		case EXECUTION_SPACE_PROTECTION_FAULT:
-			throw MachineException(intr,
-					"Execution space protection fault", data);
+			msg = "Execution space protection fault"; break;
 		case EXECUTION_LOOP_DETECTED:
-			throw MachineException(intr,
-					"Execution loop detected", data);
+			msg = "Execution loop detected"; break;
 		case MISALIGNED_INSTRUCTION:
 			// NOTE: only check for this when jumping or branching
-			throw MachineException(intr,
-					"Misaligned instruction executed", data);
+			msg = "Misaligned instruction executed"; break;
 		case INVALID_ALIGNMENT:
-			throw MachineException(intr,
-					"Invalid alignment for address", data);
+			msg = "Invalid alignment for address"; break;
 		case UNIMPLEMENTED_INSTRUCTION:
-			throw MachineException(intr,
-					"Unimplemented instruction executed", data);
+			msg = "Unimplemented instruction executed"; break;
 		case DEADLOCK_REACHED:
-			throw MachineException(intr,
-					"Atomics deadlock reached", data);
+			msg = "Atomics deadlock reached"; break;
 		case OUT_OF_MEMORY:
-			throw MachineException(intr,
-					"Out of memory", data);
+			msg = "Out of memory"; break;
 
 		default:
-			throw MachineException(UNKNOWN_EXCEPTION,
+			FaultLandingPad::raise(UNKNOWN_EXCEPTION,
 					"Unknown exception", intr);
 		}
+		// Lands in try_simulate() and friends when active, otherwise throws
+		FaultLandingPad::raise(intr, msg, data);
 	}
 
 	template <int W> RISCV_COLD_PATH()
@@ -556,6 +599,7 @@ restart_precise_sim:
 	{
 		format_t instruction;
 		try {
+			ScopedThrowingFaults throwing_faults;
 			instruction = this->read_next_instruction();
 		} catch (...) {
 			instruction = format_t {};
@@ -120,6 +120,7 @@ namespace riscv
 		// Binary translation functions
 		int  load_translation(const MachineOptions<W>&, std::string* filename, DecodedExecuteSegment<W>&) const;
 		void try_translate(const MachineOptions<W>&, const std::string&, std::shared_ptr<DecodedExecuteSegment<W>>&) const;
+		void translate_jit_segment(DecodedExecuteSegment<W>&);
 
 		void reset();
 		void reset_stack_pointer() noexcept;
@@ -4,6 +4,7 @@
 #include "threaded_bytecodes.hpp"
 #include "rv32i_instr.hpp"
 #include "rvfd.hpp"
+#include <cmath>
 #ifdef RISCV_EXT_COMPRESSED
 #include "rvc.hpp"
 #endif
@@ -263,6 +264,7 @@ execute_invalid:
 	pc = (decoder - exec_decoder) << DecoderCache<W>::SHIFT;
 	// Check if the instruction is still invalid
 	try {
+		ScopedThrowingFaults throwing_faults;
 		if (decoder->instr == 0 && MACHINE().memory.template read<uint16_t>(pc) != 0) {
 			exec->set_stale(true);
 			goto new_execute_segment;
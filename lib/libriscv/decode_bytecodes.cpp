@@ -481,8 +481,9 @@ size_t CPU<W>::computed_index_for(rv32i_instruction instr) noexcept
 		case RV32F_FNMADD:
 		case RV32F_FNMSUB:
 			return RV32I_BC_FUNCTION;
-		case RV32F_FPFUNC:
-			if (rv32f_instruction{instr}.R4type.funct2 >= 2)
+		case RV32F_FPFUNC: {
+			const rv32f_instruction fi{instr};
+			if (fi.R4type.funct2 >= 2)
 				return RV32I_BC_FUNCTION;
 			switch (instr.fpfunc())
 			{
@@ -494,9 +495,49 @@ size_t CPU<W>::computed_index_for(rv32i_instruction instr) noexcept
 					return RV32F_BC_FMUL;
 				case 0b00011: // FDIV
 					return RV32F_BC_FDIV;
+				case 0b00100: // FSGNJ, FSGNJN, FSGNJX
+					if (fi.R4type.funct3 < 0x3)
+						return RV32F_BC_FSGNJ;
+					return RV32I_BC_FUNCTION;
+				case 0b00101: // FMIN, FMAX
+					// Exception flags are only produced by the slow-path
+					if (!fcsr_emulation && fi.R4type.funct3 < 0x2)
+						return RV32F_BC_FMINMAX;
+					return RV32I_BC_FUNCTION;
+				case 0b10100: // FLE, FLT, FEQ
+					if (fi.R4type.rd == 0)
+						return RV32I_BC_NOP;
+					if (!fcsr_emulation && fi.R4type.funct3 < 0x3)
+						return RV32F_BC_FCMP;
+					return RV32I_BC_FUNCTION;
+				case 0b01000: // FCVT.S.D, FCVT.D.S
+					return RV32F_BC_FCVT_SD_DS;
+				case 0b11000: // FCVT.{W,WU,L,LU}.{S,D}
+					if (fi.R4type.rd == 0)
+						return RV32I_BC_NOP;
+					if (fi.R4type.rs2 < ((W >= 8) ? 0x4 : 0x2))
+						return RV32F_BC_FCVT_W_SD;
+					return RV32I_BC_FUNCTION;
+				case 0b11010: // FCVT.{S,D}.{W,WU,L,LU}
+					if (fi.R4type.rs2 < ((W >= 8) ? 0x4 : 0x2))
+						return RV32F_BC_FCVT_SD_W;
+					return RV32I_BC_FUNCTION;
+				case 0b11100: // FMV.X.W, FMV.X.D
+					if (fi.R4type.funct3 != 0x0) // FCLASS
+						return RV32I_BC_FUNCTION;
+					if (fi.R4type.rd == 0)
+						return RV32I_BC_NOP;
+					if (fi.R4type.funct2 == 0x0 || W >= 8)
+						return RV32F_BC_FMV_X_W;
+					return RV32I_BC_FUNCTION;
+				case 0b11110: // FMV.W.X, FMV.D.X
+					if (fi.R4type.funct2 == 0x0 || W >= 8)
+						return RV32F_BC_FMV_W_X;
+					return RV32I_BC_FUNCTION;
 				default:
 					return RV32I_BC_FUNCTION;
 				}
+			}
 #ifdef RISCV_EXT_VECTOR
 		case RV32V_OP: {
 			const rv32v_instruction vi{instr};
@@ -522,6 +563,36 @@ size_t CPU<W>::computed_index_for(rv32i_instruction instr) noexcept
 #endif
 #ifdef RISCV_EXT_ATOMICS
 		case RV32A_ATOMIC:
+			if (instr.Atype.funct3 == 0x2) { // 32-bit
+				switch (instr.Atype.funct5) {
+				case 0b00010:
+					if (instr.Atype.rs2 == 0)
+						return RV32A_BC_LR_W;
+					break;
+				case 0b00011:
+					return RV32A_BC_SC_W;
+				case 0b00000:
+					return RV32A_BC_AMOADD_W;
+				case 0b00001:
+					return RV32A_BC_AMOSWAP_W;
+				}
+			}
+#ifdef RISCV_64I
+			else if (W >= 8 && instr.Atype.funct3 == 0x3) { // 64-bit
+				switch (instr.Atype.funct5) {
+				case 0b00010:
+					if (instr.Atype.rs2 == 0)
+						return RV64A_BC_LR_D;
+					break;
+				case 0b00011:
+					return RV64A_BC_SC_D;
+				case 0b00000:
+					return RV64A_BC_AMOADD_D;
+				case 0b00001:
+					return RV64A_BC_AMOSWAP_D;
+				}
+			}
+#endif
 			return RV32I_BC_FUNCTION;
 #endif
 	}
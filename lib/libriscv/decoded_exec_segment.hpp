@@ -1,5 +1,10 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include "types.hpp"
 #include <unordered_set>
 
@@ -77,12 +82,37 @@ namespace riscv
 		void set_patched_decoder_cache(std::unique_ptr<DecoderCache<W>[]> cache, DecoderData<W>* dec)
 			{ m_patched_decoder_cache = std::move(cache); m_patched_exec_decoder = dec; }
 
+		// Counts entries into a likely-JIT segment, see translate_jit_segments_after
+		unsigned jit_entered() noexcept { return m_jit_entries.fetch_add(1, std::memory_order_relaxed) + 1; }
+
 		void set_record_slowpaths(bool do_record) { m_do_record_slowpaths = do_record; }
 		bool is_recording_slowpaths() const noexcept { return m_do_record_slowpaths; }
 		void insert_slowpath_address(address_t addr) { m_slowpath_addresses.insert(addr); }
 		auto& slowpath_addresses() const noexcept { return m_slowpath_addresses; }
+
+		// Branch profiling, see MachineOptions::record_branch_profile
+		struct BranchCounters {
+			BranchCounters(address_t pc, int32_t imm) : pc(pc), imm(imm) {}
+			int32_t signed_imm() const noexcept { return imm; }
+
+			const address_t pc;
+			const int32_t imm;
+			// Not-taken and taken counts, shared by every machine
+			// that executes this segment
+			std::array<std::atomic<uint64_t>, 2> counts {};
+		};
+		void set_record_branch_profile(bool do_record) { m_do_record_branch_profile = do_record; }
+		bool is_recording_branch_profile() const noexcept { return m_do_record_branch_profile; }
+		// Counters are only added while decoding, before the segment is shared
+		uint16_t add_branch_counters(address_t pc, int32_t imm) {
+			m_branch_counters.emplace_back(pc, imm);
+			return m_branch_counters.size() - 1;
+		}
+		BranchCounters& branch_counters(uint16_t idx) noexcept { return m_branch_counters[idx]; }
+		auto& branch_profile() const noexcept { return m_branch_counters; }
 #else
 		bool is_binary_translated() const noexcept { return false; }
+		bool is_recording_branch_profile() const noexcept { return false; }
 #endif
 
 		bool is_execute_only() const noexcept { return m_is_execute_only; }
@@ -91,8 +121,9 @@ namespace riscv
 		bool is_likely_jit() const noexcept { return m_is_likely_jit; }
 		void set_likely_jit(bool is_jit) { m_is_likely_jit = is_jit; }
 
-		bool is_stale() const noexcept { return m_is_stale; }
-		void set_stale(bool is_stale) { m_is_stale = is_stale; }
+		// Written by any member of a fork family, see invalidate_jit_segments
+		bool is_stale() const noexcept { return m_is_stale.load(std::memory_order_relaxed); }
+		void set_stale(bool is_stale) { m_is_stale.store(is_stale, std::memory_order_relaxed); }
 
 	private:
 		address_t m_vaddr_begin = 0;
@@ -117,20 +148,69 @@ namespace riscv
 		DecoderData<W>* m_patched_exec_decoder = nullptr;
 		mutable void* m_bintr_dl = nullptr;
 		std::unordered_set<address_t> m_slowpath_addresses;
+		// One entry per profiled branch in the decoder cache
+		std::deque<BranchCounters> m_branch_counters;
 		uint32_t m_bintr_hash = 0x0; // CRC32-C of the execute segment + compiler options
+		std::atomic<unsigned> m_jit_entries = 0;
 #endif
 		uint32_t m_crc32c_hash = 0x0; // CRC32-C of the execute segment
 		bool m_is_execute_only = false;
 #ifdef RISCV_BINARY_TRANSLATION
 		bool m_do_record_slowpaths = false;
+		bool m_do_record_branch_profile = false;
 		mutable bool m_is_libtcc = false;
 #endif
 		// High-memory execute segments are likely to be JIT'd, and needs to
 		// be nuked when attempting to re-use the segment
 		bool m_is_likely_jit = false;
-		bool m_is_stale = false;
+		std::atomic<bool> m_is_stale = false;
+	};
+
+	// Execute segments shared by a machine and all of its forks.
+	// A segment created by one member of the family is published here,
+	// so that the others can find it again without hashing and decoding.
+	// Slots of stale or otherwise unused segments are reused when the
+	// table is full. Slots are accessed atomically, so that readers
+	// never take the lock.
+	template <int W>
+	struct ExecuteSegmentFamily
+	{
+		using address_t = address_type<W>;
+		static constexpr size_t MAX_SEGMENTS = 64;
+
+		ExecuteSegmentFamily(uint64_t arena_size) : m_arena_size(arena_size) {}
+		ExecuteSegmentFamily(const ExecuteSegmentFamily&) = delete;
+		ExecuteSegmentFamily& operator=(const ExecuteSegmentFamily&) = delete;
+		~ExecuteSegmentFamily();
+
+		// Find a segment with the same address range and instruction bytes
+		std::shared_ptr<DecodedExecuteSegment<W>> find(address_t vaddr, const void* data, size_t len, bool is_likely_jit, bool branch_profile) const;
+		void publish(const std::shared_ptr<DecodedExecuteSegment<W>>& segment);
+		size_t size() const noexcept { return m_count.load(std::memory_order_acquire); }
+
+	private:
+		std::array<std::shared_ptr<DecodedExecuteSegment<W>>, MAX_SEGMENTS> m_segments;
+		std::atomic<size_t> m_count = 0;
+		std::mutex m_publish_mutex;
+		const uint64_t m_arena_size;
 	};
 
+	template <int W>
+	inline std::shared_ptr<DecodedExecuteSegment<W>> ExecuteSegmentFamily<W>::find(
+		address_t vaddr, const void* data, size_t len, bool is_likely_jit, bool branch_profile) const
+	{
+		const size_t count = m_count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			auto segment = std::atomic_load_explicit(&m_segments[i], std::memory_order_acquire);
+			if (segment->exec_begin() == vaddr && segment->exec_end() - vaddr == len
+				&& segment->is_likely_jit() == is_likely_jit && !segment->is_stale()
+				&& segment->is_recording_branch_profile() == branch_profile
+				&& std::memcmp(segment->exec_data(vaddr), data, len) == 0)
+				return segment;
+		}
+		return nullptr;
+	}
+
 	template <int W>
 	inline DecodedExecuteSegment<W>::DecodedExecuteSegment(
 		address_t pbase, size_t len, address_t exaddr, size_t exlen)
@@ -165,6 +245,7 @@ namespace riscv
 		m_is_libtcc = other.m_is_libtcc;
 		m_patched_decoder_cache = std::move(other.m_patched_decoder_cache);
 		m_patched_exec_decoder = other.m_patched_exec_decoder;
+		m_jit_entries = other.m_jit_entries.load();
 #endif
 	}
 
@@ -15,6 +15,8 @@ struct SegmentKey {
 	uint64_t pc;
 	uint32_t crc;
 	uint64_t arena_size = 0;
+	// Profiling segments decode branches differently
+	bool branch_profile = false;
 
 	template <int W>
 	static SegmentKey from(const riscv::DecodedExecuteSegment<W>& segment, uint64_t arena_size) {
@@ -22,21 +24,23 @@ struct SegmentKey {
 		key.pc = uint64_t(segment.exec_begin());
 		key.crc = segment.crc32c_hash();
 		key.arena_size = arena_size;
+		key.branch_profile = segment.is_recording_branch_profile();
 		return key;
 	}
 
 	bool operator==(const SegmentKey& other) const {
-		return pc == other.pc && crc == other.crc;
+		return pc == other.pc && crc == other.crc && branch_profile == other.branch_profile;
 	}
 	bool operator<(const SegmentKey& other) const {
-		return pc < other.pc || (pc == other.pc && crc < other.crc);
+		return pc < other.pc || (pc == other.pc && crc < other.crc)
+			|| (pc == other.pc && crc == other.crc && branch_profile < other.branch_profile);
 	}
 };
 namespace std {
 	template <>
 	struct hash<SegmentKey> {
 		size_t operator()(const SegmentKey& key) const {
-			return key.pc ^ key.crc ^ key.arena_size;
+			return key.pc ^ key.crc ^ key.arena_size ^ key.branch_profile;
 		}
 	};
 }
@@ -106,6 +110,44 @@ namespace riscv
 	template <int W>
 	static SharedExecuteSegments<W> shared_execute_segments;
 
+	template <int W>
+	void ExecuteSegmentFamily<W>::publish(const std::shared_ptr<DecodedExecuteSegment<W>>& segment)
+	{
+		std::scoped_lock lock(m_publish_mutex);
+		const size_t count = m_count.load(std::memory_order_relaxed);
+		size_t reusable = MAX_SEGMENTS;
+		for (size_t i = 0; i < count; i++) {
+			auto& current = m_segments[i];
+			if (current == segment)
+				return;
+			// Stale segments are never found again, and segments that only
+			// the family refers to are no longer used by any machine
+			if (reusable == MAX_SEGMENTS && (current->is_stale() || current.use_count() == 1))
+				reusable = i;
+		}
+		if (count < MAX_SEGMENTS) {
+			std::atomic_store_explicit(&m_segments[count], segment, std::memory_order_release);
+			m_count.store(count + 1, std::memory_order_release);
+		} else if (reusable != MAX_SEGMENTS) {
+			const SegmentKey key = SegmentKey::from(*m_segments[reusable], m_arena_size);
+			std::atomic_store_explicit(&m_segments[reusable], segment, std::memory_order_release);
+			shared_execute_segments<W>.remove_if_unique(key);
+		}
+	}
+
+	template <int W>
+	ExecuteSegmentFamily<W>::~ExecuteSegmentFamily()
+	{
+		// The family may have held the last references to segments
+		// that are also in the process-wide table
+		const size_t count = m_count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const SegmentKey key = SegmentKey::from(*m_segments[i], m_arena_size);
+			m_segments[i] = nullptr;
+			shared_execute_segments<W>.remove_if_unique(key);
+		}
+	}
+
 	template <int W>
 	static bool is_regular_compressed(uint16_t instr) {
 		const rv32c_instruction ci { instr };
@@ -555,6 +597,22 @@ namespace riscv
 		if (UNLIKELY(__builtin_add_overflow(pbase, plen, &pbase2)))
 			throw MachineException(INVALID_PROGRAM, "Segment virtual base was bogus");
 #endif
+#ifdef RISCV_BINARY_TRANSLATION
+		const bool record_branch_profile = options.record_branch_profile && !is_likely_jit;
+#else
+		const bool record_branch_profile = false;
+#endif
+		// A segment with identical instructions may already have been
+		// created by the master machine, or by another fork
+		if (m_exec_family != nullptr) {
+			auto segment = m_exec_family->find(vaddr, vdata, exlen, is_likely_jit, record_branch_profile);
+			if (segment != nullptr) {
+				auto& free_slot = this->next_execute_segment();
+				free_slot = std::move(segment);
+				return *free_slot;
+			}
+		}
+
 		// Create the whole executable memory range
 		auto current_exec = std::make_shared<DecodedExecuteSegment<W>>(pbase, plen, vaddr, exlen);
 
@@ -576,7 +634,7 @@ namespace riscv
 		if (options.use_shared_execute_segments)
 		{
 			// We have to key on the base address of the execute segment as well as the hash
-			const SegmentKey key{uint64_t(current_exec->exec_begin()), hash, memory_arena_size()};
+			const SegmentKey key{uint64_t(current_exec->exec_begin()), hash, memory_arena_size(), record_branch_profile};
 
 			// In order to prevent others from creating the same execute segment
 			// we need to lock the shared execute segments mutex.
@@ -585,6 +643,8 @@ namespace riscv
 
 			if (segment.segment != nullptr) {
 				free_slot = segment.segment;
+				if (m_exec_family != nullptr)
+					m_exec_family->publish(free_slot);
 				return *free_slot;
 			}
 
@@ -594,6 +654,7 @@ namespace riscv
 			free_slot->set_likely_jit(is_likely_jit);
 #ifdef RISCV_BINARY_TRANSLATION
 			free_slot->set_record_slowpaths(options.record_slowpaths_to_jump_hints && !is_likely_jit);
+			free_slot->set_record_branch_profile(record_branch_profile);
 #endif
 			// Store the hash in the decoder cache
 			free_slot->set_crc32c_hash(hash);
@@ -602,6 +663,8 @@ namespace riscv
 
 			// Share the execute segment
 			shared_execute_segments<W>.get_segment(key).unlocked_set(free_slot);
+			if (m_exec_family != nullptr)
+				m_exec_family->publish(free_slot);
 		}
 		else
 		{
@@ -609,6 +672,7 @@ namespace riscv
 			free_slot->set_likely_jit(is_likely_jit);
 #ifdef RISCV_BINARY_TRANSLATION
 			free_slot->set_record_slowpaths(options.record_slowpaths_to_jump_hints && !is_likely_jit);
+			free_slot->set_record_branch_profile(record_branch_profile);
 #endif
 			// Store the hash in the decoder cache
 			free_slot->set_crc32c_hash(hash);
@@ -622,12 +686,12 @@ namespace riscv
 	template <int W>
 	std::shared_ptr<DecodedExecuteSegment<W>>& Memory<W>::next_execute_segment()
 	{
-		if (LIKELY(m_exec_segs < MAX_EXECUTE_SEGS)) {
+		if (LIKELY(m_exec_segs < m_exec_segs_max)) {
 			auto& result = this->m_exec.at(m_exec_segs);
 			m_exec_segs ++;
 			return result;
 		}
-		throw MachineException(INVALID_PROGRAM, "Max execute segments reached");
+		throw MachineException(RESOURCE_LIMIT_REACHED, "Max execute segments reached", m_exec_segs_max);
 	}
 
 	template <int W>
@@ -674,6 +738,19 @@ namespace riscv
 		shared_execute_segments<W>.remove_if_unique(key);
 	}
 
+	template <int W>
+	void Memory<W>::invalidate_jit_segments(address_t addr, address_t len)
+	{
+		const address_t end = (addr + len < addr) ? address_t(-1) : addr + len;
+		for (size_t i = 0; i < m_exec_segs; i++) {
+			auto& segment = m_exec[i];
+			// Segments are evicted when next entered, as they may be executing now
+			if (segment && segment->is_likely_jit()
+				&& addr < segment->exec_end() && end > segment->exec_begin())
+				segment->set_stale(true);
+		}
+	}
+
 #ifdef RISCV_BINARY_TRANSLATION
 	template <int W>
 	std::vector<address_type<W>> Memory<W>::gather_jump_hints() const
@@ -695,6 +772,37 @@ namespace riscv
 			result.push_back(addr);
 		return result;
 	}
+
+	template <int W>
+	std::vector<TranslatorBranchHint<W>> Memory<W>::gather_branch_profile() const
+	{
+		std::unordered_map<address_type<W>, TranslatorBranchHint<W>> profile;
+		for (auto& hint : machine().options().translator_branch_hints) {
+			auto& entry = profile[hint.pc];
+			entry.pc = hint.pc;
+			entry.taken += hint.taken;
+			entry.not_taken += hint.not_taken;
+		}
+		for (size_t i = 0; i < m_exec_segs; i++) {
+			auto& segment = m_exec[i];
+			if (segment && segment->is_recording_branch_profile()) {
+				for (auto& branch : segment->branch_profile()) {
+					const uint64_t not_taken = branch.counts[0].load(std::memory_order_relaxed);
+					const uint64_t taken = branch.counts[1].load(std::memory_order_relaxed);
+					if (taken == 0 && not_taken == 0)
+						continue;
+					auto& entry = profile[branch.pc];
+					entry.pc = branch.pc;
+					entry.not_taken += not_taken;
+					entry.taken += taken;
+				}
+			}
+		}
+		std::vector<TranslatorBranchHint<W>> result;
+		for (auto& it : profile)
+			result.push_back(it.second);
+		return result;
+	}
 #endif
 
 #ifdef ENABLE_TIMINGS
@@ -711,9 +819,12 @@ namespace riscv
 #endif
 
 	INSTANTIATE_32_IF_ENABLED(DecoderData);
+	INSTANTIATE_32_IF_ENABLED(ExecuteSegmentFamily);
 	INSTANTIATE_32_IF_ENABLED(Memory);
 	INSTANTIATE_64_IF_ENABLED(DecoderData);
+	INSTANTIATE_64_IF_ENABLED(ExecuteSegmentFamily);
 	INSTANTIATE_64_IF_ENABLED(Memory);
 	INSTANTIATE_128_IF_ENABLED(DecoderData);
+	INSTANTIATE_128_IF_ENABLED(ExecuteSegmentFamily);
 	INSTANTIATE_128_IF_ENABLED(Memory);
 } // riscv
@@ -0,0 +1,55 @@
+#pragma once
+#include <csetjmp>
+#include "types.hpp"
+
+namespace riscv
+{
+	/// @brief A landing pad lets guest faults and timeouts return to a
+	/// recorded point on the host stack without throwing C++ exceptions.
+	/// While a pad is active on the current thread, trigger_exception()
+	/// and timeout paths record the fault in the pad and longjmp back to
+	/// it, skipping the dispatch loop and any translated code in between.
+	/// Pads nest, and with no active pad faults are thrown as before.
+	///
+	/// Code that holds host resources (system call handlers, page fault
+	/// handlers) must not be jumped over. Such code runs inside
+	/// ScopedThrowingFaults, where faults are always thrown.
+	struct FaultLandingPad
+	{
+		FaultLandingPad() noexcept : prev(current) { current = this; }
+		~FaultLandingPad() { if (current == this) current = prev; }
+		FaultLandingPad(const FaultLandingPad&) = delete;
+		FaultLandingPad& operator=(const FaultLandingPad&) = delete;
+
+		/// @brief Deliver a fault to the innermost active landing pad,
+		/// or throw a MachineException if there is none.
+		/// MAX_INSTRUCTIONS_REACHED is thrown as MachineTimeoutException.
+		[[noreturn]] static void raise(int type, const char* message, uint64_t data);
+
+		/// @brief Forward the fault that landed here to the enclosing
+		/// landing pad, or throw it if there is none. Used by nested
+		/// calls that restore machine state before passing faults on.
+		[[noreturn]] void relay();
+
+		static bool active() noexcept { return current != nullptr; }
+
+		std::jmp_buf buffer;
+		MachineFault fault {};
+		FaultLandingPad* prev;
+
+		static inline thread_local constinit FaultLandingPad* current = nullptr;
+	};
+
+	/// @brief Suspends landing pads for the current scope, so that faults
+	/// are thrown and unwind normally through frames that own resources.
+	struct ScopedThrowingFaults
+	{
+		ScopedThrowingFaults() noexcept : saved(FaultLandingPad::current) { FaultLandingPad::current = nullptr; }
+		~ScopedThrowingFaults() { FaultLandingPad::current = saved; }
+		ScopedThrowingFaults(const ScopedThrowingFaults&) = delete;
+		ScopedThrowingFaults& operator=(const ScopedThrowingFaults&) = delete;
+	private:
+		FaultLandingPad* saved;
+	};
+
+} // riscv
@@ -2,6 +2,7 @@
 /// Works on all platforms
 #define LINUX_MAP_ANONYMOUS        0x20
 #define LINUX_MAP_NORESERVE     0x04000
+#define LINUX_MAP_POPULATE      0x08000
 
 template <int W>
 static void add_mman_syscalls()
@@ -50,7 +51,45 @@ static void add_mman_syscalls()
 		length = (length + PageMask) & ~address_type<W>(PageMask);
 		address_type<W> result = address_type<W>(-1);
 
-		if (vfd != -1)
+		if (vfd != -1 && machine.has_file_descriptors() && machine.fds().is_vfs(vfd))
+		{
+			const auto* file = machine.fds().get_vfs(vfd);
+			if (file == nullptr || file->entry->is_dir || voff % Page::size() != 0)
+				MMAP_HAS_FAILED();
+			const auto& data = file->entry->data;
+
+			address_type<W> dst = addr_g;
+			if (addr_g == 0x0) {
+				dst = nextfree;
+				nextfree += length;
+			}
+			const char* src = data.data() + std::min<uint64_t>(voff, data.size());
+			const size_t avail = data.size() - std::min<uint64_t>(voff, data.size());
+			// Zero-copy: Read-only mappings of page-aligned contents outside of
+			// the flat arena can borrow the file contents directly. The pages
+			// are copy-on-write, so that a later mprotect() and write will
+			// never modify the VFS buffer.
+			const bool in_arena = riscv::flat_readwrite_arena &&
+				dst < machine.memory.memory_arena_size();
+			if (!attr.write && !in_arena && avail >= length &&
+				uintptr_t(src) % Page::size() == 0)
+			{
+				machine.memory.free_pages(dst, length);
+				attr.is_cow = true;
+				machine.memory.insert_non_owned_memory(dst, const_cast<char*>(src), length, attr);
+			} else {
+				// Make the area read-write, copy the contents and zero the rest
+				machine.memory.set_page_attr(dst, length, PageAttributes{});
+				const size_t copy_len = std::min<size_t>(avail, length);
+				machine.copy_to_guest(dst, src, copy_len);
+				machine.memory.memdiscard(dst + copy_len, length - copy_len, true);
+				machine.memory.set_page_attr(dst, length, attr);
+			}
+			machine.set_result(dst);
+			SYSPRINT("<<< mmap(vfs fd %d) = 0x%lX\n", vfd, (long)dst);
+			return;
+		}
+		else if (vfd != -1)
 		{
 			if (machine.has_file_descriptors())
 			{
@@ -147,6 +186,11 @@ static void add_mman_syscalls()
 		{
 			machine.memory.set_page_attr(result, length, attr);
 		}
+		// pre-populate writable anonymous mappings
+		if ((flags & (LINUX_MAP_POPULATE | LINUX_MAP_ANONYMOUS)) == (LINUX_MAP_POPULATE | LINUX_MAP_ANONYMOUS) && attr.write)
+		{
+			machine.memory.populate_pages(result, length);
+		}
 		machine.set_result(result);
 		SYSPRINT("<<< mmap(addr 0x%lX, len %zu, ...) = 0x%lX\n",
 				(long)addr_g, (size_t)length, (long)result);
@@ -196,7 +240,6 @@ static void add_mman_syscalls()
 			case 0: // MADV_NORMAL
 			case 1: // MADV_RANDOM
 			case 2: // MADV_SEQUENTIAL
-			case 3: // MADV_WILLNEED:
 			case 10: // MADV_DONTFORK
 			case 11: // MADV_DOFORK
 			case 12: // MADV_MERGEABLE
@@ -204,6 +247,10 @@ static void add_mman_syscalls()
 			case 18: // MADV_WIPEONFORK
 				machine.set_result(0);
 				break;
+			case 3: // MADV_WILLNEED
+				machine.memory.populate_pages(addr, len);
+				machine.set_result(0);
+				break;
 			case 4: // MADV_DONTNEED
 				machine.memory.memdiscard(addr, len, true);
 				machine.set_result(0);
@@ -0,0 +1,110 @@
+/// Read-only in-memory virtual filesystem (see posix/vfs.hpp)
+/// VFS file descriptors never reach the host, and are served directly
+/// from the borrowed file contents.
+
+template <int W>
+static const VirtualFileSystem::Entry* vfs_resolve(Machine<W>& machine,
+	int dir_fd, const std::string& path, std::string& resolved)
+{
+	auto& fds = machine.fds();
+	if (fds.vfs == nullptr)
+		return nullptr;
+
+	std::string_view base = fds.cwd;
+	if (fds.is_vfs(dir_fd)) {
+		const auto* dir = fds.get_vfs(dir_fd);
+		if (dir == nullptr)
+			return nullptr;
+		base = dir->path;
+	} else if (dir_fd != AT_FDCWD && !path.empty() && path[0] != '/') {
+		// Relative to a real directory
+		return nullptr;
+	}
+	resolved = VirtualFileSystem::normalize(base, path);
+	return fds.vfs->lookup(resolved);
+}
+
+template <int W>
+static bool vfs_openat(Machine<W>& machine, int dir_fd, const std::string& path, int flags)
+{
+	std::string resolved;
+	const auto* entry = vfs_resolve(machine, dir_fd, path, resolved);
+	if (entry == nullptr)
+		return false;
+
+	if ((flags & O_ACCMODE) != O_RDONLY || (flags & (O_CREAT | O_TRUNC)) != 0)
+		machine.set_result(-EROFS);
+	else if ((flags & O_DIRECTORY) && !entry->is_dir)
+		machine.set_result(-ENOTDIR);
+	else
+		machine.set_result(machine.fds().assign_vfs(entry, std::move(resolved)));
+	return true;
+}
+
+template <int W>
+static long vfs_read(Machine<W>& machine, const VirtualFileSystem::Entry& entry,
+	address_type<W> dst, size_t len, uint64_t offset)
+{
+	if (entry.is_dir)
+		return -EISDIR;
+	if (offset >= entry.size())
+		return 0;
+	len = std::min<uint64_t>(len, entry.size() - offset);
+	machine.copy_to_guest(dst, entry.data.data() + offset, len);
+	return len;
+}
+
+template <int W>
+static long vfs_getdents64(Machine<W>& machine, FileDescriptors::VirtualFile& file,
+	address_type<W> g_dirp, size_t count)
+{
+	const auto& entry = *file.entry;
+	if (!entry.is_dir)
+		return -ENOTDIR;
+
+	// The file offset is the index of the next directory entry,
+	// where 0 and 1 are the "." and ".." entries.
+	std::array<char, 4096> buffer;
+	count = std::min(count, buffer.size());
+	size_t written = 0;
+
+	auto emit = [&] (const VirtualFileSystem::Entry& e, std::string_view name) {
+		const size_t reclen = (19 + name.size() + 1 + 7) & ~size_t(7);
+		if (written + reclen > count)
+			return false;
+		char* rec = buffer.data() + written;
+		std::memset(rec, 0, reclen);
+		const uint64_t d_ino = e.ino;
+		const int64_t  d_off = file.offset + 1;
+		const uint16_t d_reclen = reclen;
+		const uint8_t  d_type = e.is_dir ? 4 /* DT_DIR */ : 8 /* DT_REG */;
+		std::memcpy(rec + 0, &d_ino, 8);
+		std::memcpy(rec + 8, &d_off, 8);
+		std::memcpy(rec + 16, &d_reclen, 2);
+		std::memcpy(rec + 18, &d_type, 1);
+		std::memcpy(rec + 19, name.data(), name.size());
+		written += reclen;
+		file.offset++;
+		return true;
+	};
+
+	while (file.offset < 2 + entry.children.size()) {
+		bool ok;
+		if (file.offset == 0)
+			ok = emit(entry, ".");
+		else if (file.offset == 1)
+			ok = emit(*entry.parent, "..");
+		else {
+			auto it = std::next(entry.children.begin(), file.offset - 2);
+			ok = emit(*it->second, it->first);
+		}
+		if (!ok) {
+			// Not even a single entry fits in the guest buffer
+			if (written == 0)
+				return -EINVAL;
+			break;
+		}
+	}
+	machine.copy_to_guest(g_dirp, buffer.data(), written);
+	return written;
+}
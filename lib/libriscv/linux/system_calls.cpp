@@ -86,6 +86,19 @@ static void syscall_stub_nosys(Machine<W>& machine) {
 	machine.set_result(-ENOSYS);
 }
 
+template <int W>
+static void syscall_flush_icache(Machine<W>& machine)
+{
+	// Guest JITs flush after rewriting code, which invalidates
+	// any decoded or translated copies of that code.
+	const auto [start, end] = machine.template sysargs<address_type<W>, address_type<W>>();
+	if (end > start)
+		machine.memory.invalidate_jit_segments(start, end - start);
+	SYSPRINT("SYSCALL riscv_flush_icache, start: 0x%lX end: 0x%lX => 0\n",
+		(long)start, (long)end);
+	machine.set_result(0);
+}
+
 template <int W>
 static void syscall_exit(Machine<W>& machine)
 {
@@ -126,6 +139,48 @@ static void syscall_sigaltstack(Machine<W>& machine)
 	machine.set_result(0);
 }
 
+template <int W>
+static void syscall_rt_sigreturn(Machine<W>& machine)
+{
+	SYSPRINT("SYSCALL rt_sigreturn, tid=%d\n", machine.gettid());
+	auto& signals = machine.signals();
+	if (!signals.sigreturn(machine)) {
+		machine.set_result(-EINVAL);
+		return;
+	}
+	// The context is restored at the safe point after this system call,
+	// where more signals may be delivered if they were queued meanwhile
+	SYSPRINT("<<< rt_sigreturn returning at the next safe point\n");
+}
+
+template <int W>
+static void syscall_rt_sigprocmask(Machine<W>& machine)
+{
+	const int  how      = machine.template sysarg<int>(0);
+	const auto g_set    = machine.sysarg(1);
+	const auto g_oldset = machine.sysarg(2);
+	SYSPRINT("SYSCALL rt_sigprocmask, how: %d set: 0x%lX oldset: 0x%lX\n",
+		how, (long)g_set, (long)g_oldset);
+
+	auto& signals = machine.signals();
+	uint64_t old = signals.per_thread(machine.gettid()).active;
+	if (g_set != 0x0) {
+		if (how < 0 || how > 2) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		uint64_t set = 0;
+		machine.copy_from_guest(&set, g_set, sizeof(set));
+		old = signals.set_blocked(machine, how, set);
+		// Unblocked signals may now be delivered
+		if (signals.has_pending(machine.gettid()))
+			machine.request_signal_safepoint();
+	}
+	if (g_oldset != 0x0)
+		machine.copy_to_guest(g_oldset, &old, sizeof(old));
+	machine.set_result(0);
+}
+
 template <int W>
 static void syscall_sigaction(Machine<W>& machine)
 {
@@ -161,6 +216,8 @@ static void syscall_sigaction(Machine<W>& machine)
 	machine.set_result(0);
 }
 
+#include "syscalls_vfs.cpp"
+
 template <int W>
 void syscall_getdents64(Machine<W>& machine)
 {
@@ -172,7 +229,13 @@ void syscall_getdents64(Machine<W>& machine)
 		fd, (long)g_dirp, count);
 	(void)count;
 
-	if (machine.has_file_descriptors() && machine.fds().proxy_mode) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(fd)) {
+		auto* file = machine.fds().get_vfs(fd);
+		if (file == nullptr)
+			machine.set_result(-EBADF);
+		else
+			machine.set_result(count >= 0 ? vfs_getdents64(machine, *file, g_dirp, count) : -EINVAL);
+	} else if (machine.has_file_descriptors() && machine.fds().proxy_mode) {
 #if defined(__linux__) && defined(__LP64__)
 		const int real_fd = machine.fds().translate(fd);
 
@@ -201,7 +264,25 @@ void syscall_lseek(Machine<W>& machine)
 	SYSPRINT("SYSCALL lseek, fd: %d, offset: 0x%lX, whence: %d\n",
 		fd, (long)offset, whence);
 
-	if (machine.has_file_descriptors()) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(fd)) {
+		auto* file = machine.fds().get_vfs(fd);
+		if (file == nullptr) {
+			machine.set_result(-EBADF);
+			return;
+		}
+		int64_t pos = -1;
+		switch (whence) {
+			case SEEK_SET: pos = int64_t(offset); break;
+			case SEEK_CUR: pos = int64_t(file->offset) + int64_t(offset); break;
+			case SEEK_END: pos = int64_t(file->entry->size()) + int64_t(offset); break;
+		}
+		if (pos < 0) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		file->offset = pos;
+		machine.set_result(pos);
+	} else if (machine.has_file_descriptors()) {
 		const int real_fd = machine.fds().get(fd);
 #ifndef __wasm__
 		long res = lseek(real_fd, offset, whence);
@@ -236,6 +317,14 @@ static void syscall_read(Machine<W>& machine)
 		}
 		machine.set_result_or_error(result);
 		return;
+	} else if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		auto* file = machine.fds().get_vfs(vfd);
+		long res = -EBADF;
+		if (file != nullptr) {
+			res = vfs_read(machine, *file->entry, address, len, file->offset);
+			if (res > 0) file->offset += res;
+		}
+		machine.set_result(res);
 	} else if (machine.has_file_descriptors()) {
 		const int real_fd = machine.fds().translate(vfd);
 
@@ -261,7 +350,10 @@ static void syscall_pread64(Machine<W>& machine)
 	const auto offset  = machine.sysarg(3);
 	SYSPRINT("SYSCALL pread64, vfd: %d addr: 0x%lX, len: %zu, offset: %lu\n",
 		vfd, (long)address, len, (long)offset);
-	if (machine.has_file_descriptors()) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		auto* file = machine.fds().get_vfs(vfd);
+		machine.set_result(file ? vfs_read(machine, *file->entry, address, len, offset) : -EBADF);
+	} else if (machine.has_file_descriptors()) {
 		const int real_fd = machine.fds().translate(vfd);
 
 		std::array<riscv::vBuffer, 512> buffers;
@@ -340,6 +432,30 @@ static void syscall_readv(Machine<W>& machine)
 	int real_fd = -1;
 	if (vfd == 1 || vfd == 2) {
 		real_fd = -1;
+	} else if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		auto* file = machine.fds().get_vfs(vfd);
+		if (file == nullptr) {
+			machine.set_result(-EBADF);
+			return;
+		}
+		std::array<guest_iovec<W>, 128> g_vec;
+		machine.copy_from_guest(g_vec.data(), iov_g, sizeof(guest_iovec<W>) * count);
+
+		long total = 0;
+		for (int i = 0; i < count; i++) {
+			const long res = vfs_read(machine, *file->entry,
+				g_vec[i].iov_base, g_vec[i].iov_len, file->offset);
+			if (res < 0) {
+				total = res;
+				break;
+			}
+			file->offset += res;
+			total += res;
+			if (size_t(res) < g_vec[i].iov_len)
+				break;
+		}
+		machine.set_result(total);
+		return;
 	} else if (machine.has_file_descriptors()) {
 		real_fd = machine.fds().translate(vfd);
 	}
@@ -442,11 +558,21 @@ static void syscall_openat(Machine<W>& machine)
 	SYSPRINT("SYSCALL openat, dir_fd: %d path: %s flags: %X\n",
 		dir_fd, path.c_str(), flags);
 
+	// The read-only virtual filesystem takes precedence, and is
+	// available even when the host filesystem is not
+	if (machine.has_file_descriptors() && machine.fds().vfs != nullptr) {
+		if (vfs_openat(machine, dir_fd, path, flags)) {
+			SYSPRINT("SYSCALL openat(vfs path: %s) => %d\n",
+				path.c_str(), machine.template return_value<int>());
+			return;
+		}
+	}
+
 	if (machine.has_file_descriptors() && machine.fds().permit_filesystem) {
 
 		if (machine.fds().filter_open != nullptr) {
 			// filter_open() can modify the path
-			if (!machine.fds().filter_open(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_open(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				SYSPRINT("SYSCALL openat(path: %s) => %d\n",
 					path.c_str(), machine.template return_value<int>());
@@ -478,6 +604,9 @@ static void syscall_close(riscv::Machine<W>& machine)
 	if (vfd >= 0 && vfd <= 2) {
 		// TODO: Do we really want to close them?
 		machine.set_result(0);
+	} else if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		const bool erased = machine.fds().vfs_files.erase(vfd) != 0;
+		machine.set_result(erased ? 0 : -EBADF);
 	} else if (machine.has_file_descriptors()) {
 		const int res = machine.fds().erase(vfd);
 		if (res > 0) {
@@ -497,7 +626,11 @@ static void syscall_dup(Machine<W>& machine)
 	const int vfd = machine.template sysarg<int>(0);
 	SYSPRINT("SYSCALL dup, fd: %d\n", vfd);
 
-	if (machine.has_file_descriptors()) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		const auto* file = machine.fds().get_vfs(vfd);
+		machine.set_result(file ? machine.fds().assign_vfs(file->entry, file->path) : -EBADF);
+		return;
+	} else if (machine.has_file_descriptors()) {
 		int real_fd = machine.fds().translate(vfd);
 		int res = dup(real_fd);
 		machine.set_result_or_error(res);
@@ -563,6 +696,8 @@ static void syscall_pipe2(Machine<W>& machine)
 	const auto flags = machine.template sysarg<int>(1);
 
 	if (machine.has_file_descriptors()) {
+		// Both ends must fit, so that neither can be left unowned
+		machine.fds().check_limit(2);
 		int pipes[2];
 		int res = create_pipe(pipes, flags);
 		if (res == 0) {
@@ -591,7 +726,16 @@ static void syscall_fcntl(Machine<W>& machine)
 	const auto arg3 = machine.sysarg(4);
 	int real_fd = -EBADFD;
 
-	if (machine.has_file_descriptors()) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		if (machine.fds().get_vfs(vfd) == nullptr)
+			machine.set_result(-EBADF);
+		else if (cmd == F_GETFD || cmd == F_SETFD || cmd == F_SETFL)
+			machine.set_result(0);
+		else if (cmd == F_GETFL)
+			machine.set_result(O_RDONLY);
+		else
+			machine.set_result(-EINVAL);
+	} else if (machine.has_file_descriptors()) {
 		real_fd = machine.fds().translate(vfd);
 		int res = fcntl(real_fd, cmd, arg1, arg2, arg3);
 		machine.set_result_or_error(res);
@@ -673,7 +817,7 @@ void syscall_readlinkat(Machine<W>& machine)
 
 		if (machine.fds().filter_readlink != nullptr) {
 			std::string path = original_path;
-			if (!machine.fds().filter_readlink(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_readlink(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -763,6 +907,16 @@ inline void copy_stat_buffer(struct stat& st, struct riscv_stat& rst)
 	#endif
 	#endif
 }
+inline void vfs_stat_buffer(const VirtualFileSystem::Entry& entry, struct riscv_stat& rst)
+{
+	std::memset(&rst, 0, sizeof(rst));
+	rst.st_ino = entry.ino;
+	rst.st_mode = entry.is_dir ? (S_IFDIR | 0555) : (S_IFREG | 0444);
+	rst.st_nlink = 1;
+	rst.st_size = entry.size();
+	rst.st_blksize = Page::size();
+	rst.st_blocks = (entry.size() + 511) / 512;
+}
 
 
 template <int W>
@@ -792,12 +946,33 @@ static void syscall_fstatat(Machine<W>& machine)
 
 	std::string path = machine.memory.memstring(g_path);
 
+	if (machine.has_file_descriptors() && machine.fds().vfs != nullptr) {
+		std::string resolved;
+		const VirtualFileSystem::Entry* entry = nullptr;
+		if (path.empty() && machine.fds().is_vfs(vfd)) {
+			const auto* file = machine.fds().get_vfs(vfd);
+			if (file) entry = file->entry;
+		} else {
+			entry = vfs_resolve(machine, vfd, path, resolved);
+		}
+		if (entry != nullptr) {
+			struct riscv_stat rst;
+			vfs_stat_buffer(*entry, rst);
+			machine.copy_to_guest(g_buf, &rst, sizeof(rst));
+			machine.set_result(0);
+			return;
+		} else if (machine.fds().is_vfs(vfd)) {
+			machine.set_result(path.empty() ? -EBADF : -ENOENT);
+			return;
+		}
+	}
+
 	if (machine.has_file_descriptors()) {
 
 		int real_fd = machine.fds().translate(vfd);
 
 		if (machine.fds().filter_stat != nullptr && !path.empty()) {
-			if (!machine.fds().filter_stat(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_stat(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -836,6 +1011,14 @@ static void syscall_faccessat(Machine<W>& machine)
 	SYSPRINT("SYSCALL faccessat, fd: %d path: %s)\n",
 			fd, path.c_str());
 
+	if (machine.has_file_descriptors() && machine.fds().vfs != nullptr) {
+		std::string resolved;
+		if (vfs_resolve(machine, fd, path, resolved) != nullptr) {
+			machine.set_result((mode & W_OK) ? -EROFS : 0);
+			return;
+		}
+	}
+
 	const int res =
 		faccessat(fd, path.c_str(), mode, flags);
 	machine.set_result_or_error(res);
@@ -847,7 +1030,15 @@ static void syscall_fstat(Machine<W>& machine)
 	const auto vfd = machine.template sysarg<int> (0);
 	const auto g_buf = machine.sysarg(1);
 
-	if (machine.has_file_descriptors()) {
+	if (machine.has_file_descriptors() && machine.fds().is_vfs(vfd)) {
+		const auto* file = machine.fds().get_vfs(vfd);
+		if (file != nullptr) {
+			struct riscv_stat rst;
+			vfs_stat_buffer(*file->entry, rst);
+			machine.copy_to_guest(g_buf, &rst, sizeof(rst));
+		}
+		machine.set_result(file ? 0 : -EBADF);
+	} else if (machine.has_file_descriptors()) {
 
 		const int real_fd = machine.fds().translate(vfd);
 
@@ -1133,7 +1324,7 @@ static void syscall_statx(Machine<W>& machine)
 
 	if (machine.has_file_descriptors() && machine.fds().proxy_mode) {
 		if (machine.fds().filter_stat != nullptr) {
-			if (!machine.fds().filter_stat(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_stat(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -1176,8 +1367,10 @@ void Machine<W>::setup_newlib_syscalls(bool filesystem)
 {
 	setup_newlib_syscalls();
 
-	if (filesystem)
+	if (filesystem) {
 		m_fds.reset(new FileDescriptors);
+		m_fds->max_descriptors = m_limits.file_descriptors;
+	}
 }
 
 template <int W>
@@ -1291,10 +1484,12 @@ void Machine<W>::setup_linux_syscalls(bool filesystem, bool sockets)
 		if (sig == 0 || machine.sigaction(sig).is_unset()) {
 			return;
 		} else {
-			// Jump to signal handler and change to altstack, if set
+			// The saved context returns 0 from tkill
+			machine.set_result(0);
+			// Enter the signal handler after the system call, and change to altstack, if set
 			machine.signals().enter(machine, sig);
-			SYSPRINT("<<< tkill signal=%d jumping to 0x%lX (sp=0x%lX)\n",
-				sig, (long)machine.cpu.pc(), (long)machine.cpu.reg(REG_SP));
+			SYSPRINT("<<< tkill signal=%d entering 0x%lX\n",
+				sig, (long)machine.sigaction(sig).handler);
 			return;
 		}
 		machine.stop();
@@ -1304,7 +1499,9 @@ void Machine<W>::setup_linux_syscalls(bool filesystem, bool sockets)
 	// rt_sigaction
 	install_syscall_handler(134, syscall_sigaction<W>);
 	// rt_sigprocmask
-	install_syscall_handler(135, syscall_stub_zero<W>);
+	install_syscall_handler(135, syscall_rt_sigprocmask<W>);
+	// rt_sigreturn
+	install_syscall_handler(139, syscall_rt_sigreturn<W>);
 	// uname
 	install_syscall_handler(160, syscall_uname<W>);
 	// prctl
@@ -1330,7 +1527,7 @@ void Machine<W>::setup_linux_syscalls(bool filesystem, bool sockets)
 	// riscv_hwprobe
 	install_syscall_handler(258, syscall_stub_zero<W>);
 	// riscv_flush_icache
-	install_syscall_handler(259, syscall_stub_zero<W>);
+	install_syscall_handler(259, syscall_flush_icache<W>);
 
 	install_syscall_handler(278, syscall_getrandom<W>);
 
@@ -1349,6 +1546,7 @@ void Machine<W>::setup_linux_syscalls(bool filesystem, bool sockets)
 		signal(SIGPIPE, SIG_IGN);
 
 		m_fds.reset(new FileDescriptors);
+		m_fds->max_descriptors = m_limits.file_descriptors;
 		if (sockets)
 			add_socket_syscalls(*this);
 	}
@@ -1371,5 +1569,8 @@ FileDescriptors::~FileDescriptors() {
 		::close(it.second);
 	}
 }
+void FileDescriptors::close_real(real_fd_type fd, bool) {
+	::close(fd);
+}
 
 } // riscv
@@ -44,6 +44,7 @@ namespace riscv
 		if (other.m_mt) {
 			m_mt.reset(new MultiThreading {*this, *other.m_mt});
 		}
+		this->set_resource_limits(other.m_limits);
 		// TODO: transfer arena?
 	}
 
@@ -60,6 +61,34 @@ namespace riscv
 	{
 	}
 
+	template <int W>
+	void Machine<W>::set_resource_limits(const ResourceLimits& limits)
+	{
+		this->m_limits = limits;
+		memory.set_resource_limits(limits);
+		if (m_fds)
+			m_fds->max_descriptors = limits.file_descriptors;
+		if (m_mt)
+			m_mt->set_max_threads(limits.threads);
+		if (m_arena)
+			m_arena->set_max_chunks(limits.heap_chunks);
+	}
+
+	template <int W>
+	ResourceUsage Machine<W>::resource_usage() const noexcept
+	{
+		ResourceUsage usage;
+		usage.owned_pages = memory.owned_pages_active();
+		usage.execute_segments = memory.execute_segments_count();
+		if (m_fds)
+			usage.file_descriptors = m_fds->open_count();
+		if (m_mt)
+			usage.threads = m_mt->size();
+		if (m_arena)
+			usage.heap_chunks = m_arena->chunks_used();
+		return usage;
+	}
+
 	template <int W>
 	void Machine<W>::unknown_syscall_handler(Machine<W>& machine)
 	{
@@ -92,10 +121,120 @@ namespace riscv
 	template <int W> RISCV_COLD_PATH()
 	void Machine<W>::timeout_exception(uint64_t max_instr)
 	{
-		throw MachineTimeoutException(MAX_INSTRUCTIONS_REACHED,
+		FaultLandingPad::raise(MAX_INSTRUCTIONS_REACHED,
 			"Instruction count limit reached", max_instr);
 	}
 
+	template <int W>
+	machine_status Machine<W>::run_guarded(void (*func)(Machine&, void*), void* arg,
+		void (*setup)(Machine&, void*), void* setup_arg)
+	{
+		m_fault = {};
+		try {
+			// Setting up a call owns host resources, so it cannot land
+			if (setup != nullptr) {
+				ScopedThrowingFaults throwing_faults;
+				setup(*this, setup_arg);
+			}
+			FaultLandingPad pad;
+			if (setjmp(pad.buffer) == 0) {
+				func(*this, arg);
+			} else {
+				m_fault = pad.fault;
+			}
+		} catch (const MachineException& e) {
+			// Thrown where landing is suspended, eg. in a system call
+			m_fault = { e.type(), e.what(), e.data() };
+		}
+		if (m_fault.message != nullptr)
+			return (m_fault.type == MAX_INSTRUCTIONS_REACHED) ? MACHINE_TIMEOUT : MACHINE_FAULT;
+		return instruction_limit_reached() ? MACHINE_TIMEOUT : MACHINE_STOPPED;
+	}
+
+	template <int W> RISCV_COLD_PATH()
+	bool Machine<W>::simulate_landed(uint64_t max_instr, uint64_t counter, address_t pc, bool throw_timeout)
+	{
+		// Land faults from host protections here, and throw them from a
+		// regular stack frame instead of from the signal handler
+		FaultLandingPad pad;
+		if (setjmp(pad.buffer) != 0) {
+			// Without Throw only timeouts are returned, faults are thrown
+			if (!throw_timeout && pad.fault.type == MAX_INSTRUCTIONS_REACHED) {
+				this->m_max_counter = max_instr;
+				return false;
+			}
+			pad.relay();
+		}
+		if (throw_timeout)
+			return this->simulate_with<true>(max_instr, counter, pc);
+		return this->simulate_with<false>(max_instr, counter, pc);
+	}
+
+	template <int W> RISCV_COLD_PATH()
+	bool Machine<W>::simulate_signals(uint64_t max_instr, uint64_t counter, address_t pc)
+	{
+		while (true) {
+			if (signal_safepoint_requested())
+				pc = this->signal_safepoint();
+			// Signals queued from other threads are seen in-between slices,
+			// which keeps the safepoint check out of the dispatch loops
+			const uint64_t slice_max = (max_instr > counter && max_instr - counter > SIGNAL_SLICE)
+				? counter + SIGNAL_SLICE : max_instr;
+			if (cpu.simulate(pc, counter, slice_max)) {
+				// Stopped after a system call in order to deliver signals
+				if (!m_safepoint_stop)
+					return true;
+			} else if (m_counter >= max_instr || m_counter < slice_max) {
+				// Out of instructions, or a system call lowered the limit
+				return false;
+			}
+			pc = cpu.pc();
+			counter = m_counter;
+		}
+	}
+
+	template <int W>
+	machine_status Machine<W>::try_simulate(uint64_t max_instr, uint64_t counter)
+	{
+		uint64_t args[2] { max_instr, counter };
+		return run_guarded([] (Machine& m, void* arg) {
+			const auto* args = static_cast<const uint64_t*>(arg);
+			m.template simulate<false>(args[0], args[1]);
+		}, args);
+	}
+
+	template <int W>
+	void Machine<W>::queue_signal(int sig, int tid)
+	{
+		if (sig <= 0 || sig > 64)
+			throw MachineException(ILLEGAL_OPERATION, "Invalid signal queued", sig);
+		{
+			std::lock_guard<std::mutex> lock(m_signal_inbox_mtx);
+			m_signal_inbox.emplace_back(tid, sig);
+		}
+		m_signal_safepoint.store(true, std::memory_order_release);
+	}
+
+	template <int W> RISCV_COLD_PATH()
+	address_type<W> Machine<W>::signal_safepoint()
+	{
+		// Clear the request before draining, so that no queued signal is missed
+		this->m_signal_safepoint.store(false, std::memory_order_relaxed);
+		this->m_safepoint_stop = false;
+		std::vector<std::pair<int, int>> inbox;
+		{
+			std::lock_guard<std::mutex> lock(m_signal_inbox_mtx);
+			inbox.swap(m_signal_inbox);
+		}
+		for (const auto& [tid, sig] : inbox) {
+			// Other threads get their signals when they are resumed
+			signals().queue(tid < 0 ? this->gettid() : tid, sig);
+		}
+		if (has_signals())
+			signals().deliver_pending(*this);
+		return cpu.pc();
+	}
+
 	template <int W>
 	void Machine<W>::setup_argv(
 		const std::vector<std::string>& args,
@@ -258,6 +397,7 @@ namespace riscv
 	template <int W>
 	void Machine<W>::system(union rv32i_instruction instr)
 	{
+		ScopedThrowingFaults throwing_faults;
 		switch (instr.Itype.funct3) {
 		case 0x0: // SYSTEM functions
 			switch (instr.Itype.imm)
@@ -1,10 +1,14 @@
 #pragma once
 #include "cpu.hpp"
+#include "landing_pad.hpp"
 #include "memory.hpp"
+#include "paravirt.hpp"
 #include "riscvbase.hpp"
 #include "posix/filedesc.hpp"
 #include "posix/signals.hpp"
 #include <array>
+#include <atomic>
+#include <mutex>
 #include <string_view>
 
 namespace riscv
@@ -279,6 +283,43 @@ namespace riscv
 		template<bool Throw = true, bool StoreRegs = true, typename... Args>
 		address_t preempt(uint64_t max_instr, address_t func_addr, Args&&... args);
 
+		/// @brief Exception-free variant of simulate(). Guest faults and
+		/// execution timeouts are not thrown, but land back here through a
+		/// FaultLandingPad, even from inside translated code. The fault
+		/// is recorded and can be inspected with fault().
+		/// NOTE: Faults thrown by host code (eg. system call handlers) are
+		/// caught here too, so the library itself still needs exceptions.
+		/// @param max_instructions The instruction limit.
+		/// @param counter Set the initial instruction count.
+		/// @return MACHINE_STOPPED, MACHINE_TIMEOUT or MACHINE_FAULT.
+		machine_status try_simulate(uint64_t max_instructions = UINT64_MAX, uint64_t counter = 0u);
+
+		/// @brief Exception-free variant of vmcall(). See try_simulate().
+		/// The function result is available from return_value().
+		/// @tparam MAXI The instruction limit.
+		/// @param func_addr The address of the function to call.
+		/// @param ...args The arguments to the function.
+		/// @return MACHINE_STOPPED, MACHINE_TIMEOUT or MACHINE_FAULT.
+		template <uint64_t MAXI = UINT64_MAX, typename... Args>
+		machine_status try_vmcall(address_t func_addr, Args&&... args);
+
+		template <uint64_t MAXI = UINT64_MAX, typename... Args>
+		machine_status try_vmcall(const char* func_name, Args&&... args);
+
+		/// @brief Exception-free variant of preempt(). See try_simulate().
+		/// Registers and counters are restored also when a fault happens.
+		/// @tparam StoreRegs Store and restore registers.
+		/// @param result Receives the return register from the function call.
+		/// @param max_instr The instruction limit, when an execution timeout happens.
+		/// @param func_addr The address of the function to interrupt the current task with.
+		/// @return MACHINE_STOPPED, MACHINE_TIMEOUT or MACHINE_FAULT.
+		template <bool StoreRegs = true, typename... Args>
+		machine_status try_preempt(address_t& result, uint64_t max_instr, address_t func_addr, Args&&... args);
+
+		/// @brief The fault recorded by the last try_simulate(), try_vmcall()
+		/// or try_preempt(). The message is nullptr if no fault happened.
+		const MachineFault& fault() const noexcept { return m_fault; }
+
 		/// @brief Performs a lookup in the symbol table and returns the address
 		/// of any symbol matchine the given name. This can, for example, be
 		/// used to find the address of a function.
@@ -417,6 +458,70 @@ namespace riscv
 		// Signal structure, lazily created
 		Signals<W>& signals();
 		SignalAction<W>& sigaction(int sig) { return signals().get(sig); }
+		bool has_signals() const noexcept { return this->m_signals != nullptr; }
+
+		/// @brief Queue a signal for asynchronous delivery to a guest thread.
+		/// When signal handlers are installed, a running machine is simulated in
+		/// slices of SIGNAL_SLICE instructions, and the signal is delivered at the
+		/// end of the current slice. There the full register context is saved and
+		/// the guest signal handler is entered. rt_sigreturn restores the context.
+		/// Signals queued before or during a system call are delivered right after
+		/// it. Otherwise the signal is delivered when simulation resumes.
+		/// May be called from any thread, eg. from a host timer thread.
+		/// @param sig The signal number (1-64)
+		/// @param tid The guest thread to signal, or -1 for the current thread
+		void queue_signal(int sig, int tid = -1);
+		/// @brief Stop after the current system call in order to deliver pending
+		/// signals. Must be called from the thread that runs the machine.
+		void request_signal_safepoint() noexcept;
+		/// @brief Polled in-between slices of the simulation.
+		bool signal_safepoint_requested() const noexcept {
+			return m_signal_safepoint.load(std::memory_order_relaxed);
+		}
+
+		/// @brief Set hard limits on owned pages, file descriptors, threads,
+		/// execute segments and native heap chunks. Limits apply to existing
+		/// and future structures, and are inherited by forks. Exceeding a limit
+		/// throws a MachineException of type RESOURCE_LIMIT_REACHED.
+		void set_resource_limits(const ResourceLimits& limits);
+		const ResourceLimits& resource_limits() const noexcept { return m_limits; }
+		/// @brief Current resource usage. Cheap enough to call often, eg. from
+		/// a scheduler, as every counter is maintained incrementally.
+		ResourceUsage resource_usage() const noexcept;
+
+		/// @brief Make a function in another machine directly callable from this
+		/// guest, without going through a host system call handler. Guests call
+		/// linked functions by index using the system calls installed by
+		/// setup_linked_calls(). The callee must be idle or currently calling
+		/// into this machine, and must outlive the link.
+		/// @param callee The machine that owns the function
+		/// @param func The address of the function in the callee
+		/// @param scratch_size The size of a buffer allocated up-front in the
+		/// callee, used to transfer buffer arguments and results
+		/// @return The index of the linked function
+		unsigned link_function(Machine& callee, address_t func, size_t scratch_size = 0);
+		unsigned link_function(Machine& callee, const std::string& func, size_t scratch_size = 0);
+		/// @brief Install the guest-facing linked call system calls:
+		/// sysnum+0: a0 = index, a1-a6 = arguments, fa0-fa7 passed through
+		/// sysnum+1: a0 = index, a1 = src, a2 = srclen, a3 = dst, a4 = dstlen,
+		///  a5 = argument. The source buffer is copied into the scratch buffer,
+		///  and the callee is called with (scratch, srclen, scratch_size, a5). The
+		///  callee returns the length of its result in scratch, which is then
+		///  copied back to dst (bounded by dstlen).
+		static void setup_linked_calls(size_t sysnum);
+
+		/// @brief Install the paravirtual system calls that let a guest
+		/// running libriscv (built with RISCV_PARAVIRT, see paravirt.hpp)
+		/// delegate its own machines to us. Delegated machines are native
+		/// machines owned by this machine, so they run at single-level speed.
+		/// Their system calls are served by our installed handlers, without
+		/// file system or socket access, and their output goes to our printer.
+		/// Their instructions are counted against our instruction limit.
+		/// See paravirt.hpp for the system call numbers and arguments.
+		/// @param sysnum The first of PARAVIRT_SYSCALLS system call numbers.
+		static void setup_paravirt_calls(size_t sysnum = PARAVIRT_SYSCALLS_BASE);
+		/// @brief The number of machines currently delegated to us.
+		size_t paravirt_guests() const noexcept;
 
 #ifdef RISCV_TIMED_VMCALLS
 		template <typename... Args>
@@ -454,19 +559,47 @@ namespace riscv
 		auto resolve_args(std::index_sequence<indices...>) const;
 		static void setup_native_heap_internal(const size_t);
 		[[noreturn]] void timeout_exception(uint64_t);
+		address_t signal_safepoint();
+		machine_status run_guarded(void (*func)(Machine&, void*), void* arg,
+			void (*setup)(Machine&, void*) = nullptr, void* setup_arg = nullptr);
+		bool simulate_landed(uint64_t max_instructions, uint64_t counter, address_t pc, bool throw_timeout);
+		bool simulate_signals(uint64_t max_instructions, uint64_t counter, address_t pc);
 
 		uint64_t     m_counter = 0;
 		uint64_t     m_max_counter = 0;
+		std::atomic<bool> m_signal_safepoint = false;
+		bool         m_safepoint_stop = false;
 		mutable void*        m_userdata = nullptr;
 		mutable printer_func m_printer = default_printer;
 		mutable stdin_func   m_stdin = default_stdin;
 		mutable rdtime_func  m_rdtime = default_rdtime;
 		std::unique_ptr<Arena> m_arena;
 		std::unique_ptr<MultiThreading<W>> m_mt = nullptr;
+		// Signals queued by other threads, drained at the next safe point
+		std::mutex m_signal_inbox_mtx;
+		std::vector<std::pair<int, int>> m_signal_inbox;
 		std::unique_ptr<FileDescriptors> m_fds = nullptr;
 		std::unique_ptr<Multiprocessing<W>> m_smp = nullptr;
 		std::unique_ptr<Signals<W>> m_signals = nullptr;
+		struct LinkedFunction {
+			Machine* callee;
+			address_t func;
+			address_t scratch;
+			address_t scratch_size;
+		};
+		std::vector<LinkedFunction> m_linked_functions;
+		address_t linked_call(const LinkedFunction&, const address_t* args, unsigned nargs);
+		struct ParavirtGuest {
+			std::vector<uint8_t> binary;
+			std::unique_ptr<Machine> machine;
+			uint64_t memory_max = 0; // Charged against our own memory_max
+		};
+		std::vector<ParavirtGuest> m_paravirt;
+		ParavirtGuest& paravirt_guest(int handle);
+		machine_status paravirt_run(Machine& guest, uint64_t counter, uint64_t max);
 		std::shared_ptr<MachineOptions<W>> m_options = nullptr;
+		ResourceLimits m_limits;
+		MachineFault m_fault;
 
 #ifdef RISCV_TIMED_VMCALLS
 	public:
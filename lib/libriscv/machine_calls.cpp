@@ -0,0 +1,147 @@
+#include "machine.hpp"
+
+#include "internal_common.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <optional>
+
+namespace riscv {
+	static constexpr unsigned LINKED_CALL_ARGS = 6;
+	static constexpr uint32_t LINKED_CALL_PENALTY = 100u;
+
+template <int W>
+unsigned Machine<W>::link_function(Machine& callee, address_t func, size_t scratch_size)
+{
+	if (func == 0x0)
+		throw MachineException(INVALID_PROGRAM, "Linked function has no address");
+
+	address_t scratch = 0x0;
+	if (scratch_size > 0) {
+		scratch_size = (scratch_size + Page::size() - 1) & ~(Page::size() - 1);
+		scratch = callee.memory.mmap_allocate(scratch_size);
+	}
+	m_linked_functions.push_back({&callee, func, scratch, address_t(scratch_size)});
+	return m_linked_functions.size() - 1;
+}
+
+template <int W>
+unsigned Machine<W>::link_function(Machine& callee, const std::string& func, size_t scratch_size)
+{
+	return link_function(callee, callee.address_of(func), scratch_size);
+}
+
+template <int W>
+address_type<W> Machine<W>::linked_call(const LinkedFunction& link, const address_t* args, unsigned nargs)
+{
+	auto& callee = *link.callee;
+	// The callee keeps its own state, so that it may be in the middle of
+	// calling into us (re-entrancy), and it's restored no matter what.
+	// Everything is on the host stack: No allocations.
+	Registers<W> saved = callee.cpu.registers();
+	const auto prev_max = callee.max_instructions();
+	const auto prev_counter = callee.instruction_counter();
+	auto& prev_exec = callee.cpu.current_execute_segment();
+	auto restore = [&] {
+		callee.cpu.registers() = saved;
+		callee.set_instruction_counter(prev_counter);
+		callee.set_max_instructions(prev_max);
+		// The callee continues in its own execute segment
+		callee.cpu.set_execute_segment(prev_exec);
+	};
+
+	auto& regs = callee.cpu.registers();
+	regs.get(REG_SP) = (regs.get(REG_SP) - 16u) & ~address_t(0xF);
+	regs.get(REG_RA) = callee.memory.exit_address();
+	for (unsigned i = 0; i < nargs; i++)
+		regs.get(REG_ARG0 + i) = args[i];
+	for (unsigned i = 0; i < 8; i++)
+		regs.getfl(REG_FA0 + i) = this->cpu.registers().getfl(REG_FA0 + i);
+
+	// The callee shares our remaining instruction budget
+	const uint64_t budget = (this->instruction_counter() < this->max_instructions())
+		? this->max_instructions() - this->instruction_counter() : 0;
+	// Faults that would land outside of us must restore the callee first
+	std::optional<FaultLandingPad> pad;
+	if (FaultLandingPad::active()) {
+		pad.emplace();
+		if (setjmp(pad->buffer) != 0) {
+			restore();
+			pad->relay();
+		}
+	}
+	try {
+		callee.simulate_with(prev_counter + std::min(budget, UINT64_MAX - prev_counter), prev_counter, link.func);
+	} catch (...) {
+		restore();
+		throw;
+	}
+	const uint64_t executed = callee.instruction_counter() - prev_counter;
+	const bool timed_out = callee.instruction_limit_reached();
+	const address_t retval = regs.get(REG_ARG0);
+	this->cpu.registers().getfl(REG_FA0) = regs.getfl(REG_FA0);
+
+	restore();
+
+	if (timed_out) {
+		// Exhausting the callee exhausts the caller
+		this->set_instruction_counter(this->max_instructions());
+		return address_t(-ETIMEDOUT);
+	}
+	this->increment_counter(executed);
+	this->penalize(LINKED_CALL_PENALTY);
+	return retval;
+}
+
+template <int W>
+void Machine<W>::setup_linked_calls(size_t sysnum)
+{
+	// Call with register arguments
+	install_syscall_handler(sysnum+0,
+	[] (Machine<W>& machine) {
+		const auto index = machine.template sysarg<unsigned>(0);
+		if (UNLIKELY(index >= machine.m_linked_functions.size())) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		address_t args[LINKED_CALL_ARGS];
+		for (unsigned i = 0; i < LINKED_CALL_ARGS; i++)
+			args[i] = machine.sysarg(1 + i);
+
+		const auto& link = machine.m_linked_functions[index];
+		machine.set_result(machine.linked_call(link, args, LINKED_CALL_ARGS));
+	});
+	// Call with a buffer argument and a buffer result
+	install_syscall_handler(sysnum+1,
+	[] (Machine<W>& machine) {
+		const auto [index, src, srclen, dst, dstlen, arg] =
+			machine.template sysargs<unsigned, address_t, address_t, address_t, address_t, address_t> ();
+		if (UNLIKELY(index >= machine.m_linked_functions.size())) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		const auto& link = machine.m_linked_functions[index];
+		if (UNLIKELY(srclen > link.scratch_size)) {
+			machine.set_result(-E2BIG);
+			return;
+		}
+		auto& callee = *link.callee;
+		callee.memory.memcpy(link.scratch, machine, src, srclen);
+		machine.penalize(srclen);
+
+		const address_t args[4] { link.scratch, srclen, link.scratch_size, arg };
+		const auto result = machine.linked_call(link, args, 4);
+
+		// A negative result is an error, otherwise the length of the reply
+		using saddr_t = signed_address_type<W>;
+		if (saddr_t(result) > 0) {
+			const address_t len = std::min({result, dstlen, link.scratch_size});
+			machine.memory.memcpy(dst, callee, link.scratch, len);
+			machine.penalize(len);
+		}
+		machine.set_result(result);
+	});
+}
+
+INSTANTIATE_32_IF_ENABLED(Machine);
+INSTANTIATE_64_IF_ENABLED(Machine);
+} // riscv
@@ -2,6 +2,14 @@
 template <int W>
 inline void Machine<W>::stop() noexcept {
 	m_max_counter = 0;
+	m_safepoint_stop = false;
+}
+template <int W>
+inline void Machine<W>::request_signal_safepoint() noexcept {
+	m_signal_safepoint.store(true, std::memory_order_release);
+	// Leave the dispatch right after the current system call
+	m_safepoint_stop = true;
+	m_max_counter = 0;
 }
 template <int W>
 inline bool Machine<W>::stopped() const noexcept {
@@ -16,7 +24,21 @@ template <int W>
 template <bool Throw>
 inline bool Machine<W>::simulate_with(uint64_t max_instr, uint64_t counter, address_t pc)
 {
-	const bool stopped_normally = cpu.simulate(pc, counter, max_instr);
+	if (UNLIKELY(memory.uses_arena_host_protections())) {
+		memory.restore_arena_protections();
+		// Host protection faults can only land, never be thrown
+		if (!FaultLandingPad::active())
+			return this->simulate_landed(max_instr, counter, pc, Throw);
+	}
+	bool stopped_normally;
+	if (LIKELY(!has_signals() && !signal_safepoint_requested())) {
+		stopped_normally = cpu.simulate(pc, counter, max_instr);
+		// Signal handlers may have been installed during the simulation
+		if (UNLIKELY(stopped_normally && m_safepoint_stop))
+			stopped_normally = this->simulate_signals(max_instr, m_counter, cpu.pc());
+	} else {
+		stopped_normally = this->simulate_signals(max_instr, counter, pc);
+	}
 	if constexpr (Throw) {
 		// The simulation either ends normally, or it throws an exception
 		if (UNLIKELY(!stopped_normally))
@@ -78,11 +100,19 @@ void Machine<W>::install_syscall_handlers(std::initializer_list<std::pair<size_t
 template <int W>
 inline void Machine<W>::system_call(size_t sysnum)
 {
+	// System call handlers own host resources, so faults must unwind
+	ScopedThrowingFaults throwing_faults;
 	if (LIKELY(sysnum < syscall_handlers.size())) {
 		Machine::syscall_handlers[RISCV_SPECSAFE(sysnum)](*this);
 	} else {
 		on_unhandled_syscall(*this, sysnum);
 	}
+	// The handler may have touched protected arena pages
+	if (UNLIKELY(memory.uses_arena_host_protections()))
+		memory.restore_arena_protections();
+	// Signals queued meanwhile are delivered right after the system call
+	if (UNLIKELY(signal_safepoint_requested()))
+		this->request_signal_safepoint();
 }
 
 template <int W>
@@ -53,6 +53,32 @@ inline address_type<W> Machine<W>::vmcall(const char* funcname, Args&&... args)
 	return vmcall<MAXI, Throw>(call_addr, std::forward<Args>(args)...);
 }
 
+template <int W>
+template <uint64_t MAXI, typename... Args>
+inline machine_status Machine<W>::try_vmcall(address_t pc, Args&&... args)
+{
+	auto setup = [&] {
+		this->cpu.reset_stack_pointer();
+		this->setup_call(std::forward<Args>(args)...);
+	};
+	auto call = [&] {
+		this->template simulate_with<false>(MAXI, 0u, pc);
+	};
+	return this->run_guarded([] (Machine&, void* arg) {
+		(*static_cast<decltype(call)*>(arg))();
+	}, &call, [] (Machine&, void* arg) {
+		(*static_cast<decltype(setup)*>(arg))();
+	}, &setup);
+}
+
+template <int W>
+template <uint64_t MAXI, typename... Args>
+inline machine_status Machine<W>::try_vmcall(const char* funcname, Args&&... args)
+{
+	address_t call_addr = memory.resolve_address(funcname);
+	return try_vmcall<MAXI>(call_addr, std::forward<Args>(args)...);
+}
+
 #ifdef RISCV_TIMED_VMCALLS
 template <int W>
 template <typename... Args>
@@ -97,3 +123,31 @@ address_type<W> Machine<W>::preempt(uint64_t max_instr, const char* funcname, Ar
 	address_t call_addr = memory.resolve_address(funcname);
 	return preempt<Throw, StoreRegs>(max_instr, call_addr, std::forward<Args>(args)...);
 }
+
+template <int W>
+template <bool StoreRegs, typename... Args> inline
+machine_status Machine<W>::try_preempt(address_t& result, uint64_t max_instr, address_t call_addr, Args&&... args)
+{
+	Registers<W> regs;
+	if constexpr (StoreRegs) {
+		regs = cpu.registers();
+	}
+	auto setup = [&] {
+		try {
+			this->cpu.reg(REG_SP) -= 16u;
+			this->setup_call(std::forward<Args>(args)...);
+		} catch (...) {
+			if constexpr (StoreRegs)
+				cpu.registers() = regs;
+			throw;
+		}
+	};
+	auto call = [&] {
+		result = this->cpu.preempt_internal(regs, StoreRegs, call_addr, max_instr);
+	};
+	return this->run_guarded([] (Machine&, void* arg) {
+		(*static_cast<decltype(call)*>(arg))();
+	}, &call, [] (Machine&, void* arg) {
+		(*static_cast<decltype(setup)*>(arg))();
+	}, &setup);
+}
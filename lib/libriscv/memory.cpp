@@ -98,8 +98,7 @@ namespace riscv
 							return mem.allocate_page(page, attr, &mem.m_arena.data[page]);
 						}
 						// Create page on-demand
-						return mem.allocate_page(page,
-							init ? PageData::INITIALIZED : PageData::UNINITIALIZED);
+						return mem.allocate_pooled_page(page, init);
 					}
 					// Out of memory, which is (2 + 1) * anywhere_pages
 					throw MachineException(OUT_OF_MEMORY, "Out of memory", anywhere_pages * 3);
@@ -111,8 +110,7 @@ namespace riscv
 					if (mem.pages_active() < pages_max || mem.owned_pages_active() < pages_max)
 					{
 						// Create page on-demand
-						return mem.allocate_page(page,
-							init ? PageData::INITIALIZED : PageData::UNINITIALIZED);
+						return mem.allocate_pooled_page(page, init);
 					}
 					throw MachineException(OUT_OF_MEMORY, "Out of memory", pages_max);
 				};
@@ -120,12 +118,21 @@ namespace riscv
 		} else {
 			throw MachineException(OUT_OF_MEMORY, "Max memory was zero", 0);
 		}
+		if (options.use_shared_execute_segments) {
+			// Forks of this machine will share execute segments with us
+			this->m_exec_family = std::make_shared<ExecuteSegmentFamily<W>>(memory_arena_size());
+		}
 		if (!m_binary.empty()) {
 			// Add a zero-page at the start of address space
 			this->initial_paging();
 			// load ELF binary into virtual memory
 			this->binary_loader(options);
 		}
+		// Protections set by the loader are already enforced by the arena boundaries
+		if (options.use_arena_host_protections && this->uses_flat_memory_arena()) {
+			this->m_arena.protection =
+				std::make_shared<ArenaHostProtection>(m_arena.data, m_arena.pages);
+		}
 	}
 	template <int W>
 	Memory<W>::Memory(Machine<W>& mach, const Machine<W>& other, MachineOptions<W> options)
@@ -145,8 +152,12 @@ namespace riscv
 		try {
 			this->clear_all_pages();
 		} catch (...) {}
+		// Pinned surface memory is no longer referenced by any pages
+		this->m_surfaces.clear();
 		// Potentially deallocate execute segments that are no longer referenced
 		this->evict_execute_segments();
+		// Stop handling host faults before the arena goes away
+		this->m_arena.protection = nullptr;
 		// only the original machine owns arena
 		if (this->m_arena.data != nullptr && !is_forked()) {
 #ifdef __linux__
@@ -174,6 +185,7 @@ namespace riscv
 	void Memory<W>::clear_all_pages()
 	{
 		this->m_pages.clear();
+		this->m_owned_pages = 0;
 		this->invalidate_reset_cache();
 	}
 
@@ -519,6 +531,9 @@ namespace riscv
 		for (size_t i = 0; i < m_exec_segs; i++) {
 			this->m_exec[i] = master.memory.m_exec[i];
 		}
+		// Join the family, in order to see segments created later
+		// by the master, by other forks and by forks of forks
+		this->m_exec_family = master.memory.m_exec_family;
 
 		if (options.use_memory_arena) {
 			this->m_arena.data = master.memory.m_arena.data;
@@ -526,6 +541,8 @@ namespace riscv
 			this->m_arena.read_boundary = master.memory.m_arena.read_boundary;
 			this->m_arena.write_boundary = master.memory.m_arena.write_boundary;
 			this->m_arena.initial_rodata_end = master.memory.m_arena.initial_rodata_end;
+			this->m_arena.protection = master.memory.m_arena.protection;
+			this->m_arena.shared = master.memory.m_arena.shared;
 		}
 
 		// invalidate all cached pages, because references are invalidated
@@ -6,6 +6,8 @@
 #include <string_view>
 #include <unordered_map>
 #include "decoded_exec_segment.hpp"
+#include "memory_protection.hpp"
+#include "memory_surface.hpp"
 #include "mmap_cache.hpp"
 #include "util/buffer.hpp" // <string>
 #include "util/function.hpp"
@@ -30,6 +32,7 @@ namespace riscv
 		static constexpr address_t DYLINK_BASE  = 0x40000; // Dynamic link base address
 		static constexpr address_t RWREAD_BEGIN = 0x1000; // Default rw-arena rodata start
 		static constexpr size_t    MAX_EXECUTE_SEGS = RISCV_MAX_EXECUTE_SEGS;
+		static constexpr size_t    PAGE_POOL_MAX = 512; // Retired pages kept for reuse
 
 		template <typename T>
 		T read(address_t src);
@@ -51,6 +54,9 @@ namespace riscv
 		int memcmp(const void* p1, address_t p2, size_t len) const;
 		// Perform the equivalent of MADV_DONTNEED on memory region
 		void memdiscard(address_t dst, size_t len, bool ignore_protections);
+		// Allocate and pre-fault the writable pages of a memory region,
+		// as with MADV_WILLNEED or MAP_POPULATE. Stops quietly at memory limits.
+		void populate_pages(address_t dst, size_t len);
 		/* Fill an array of buffers pointing to complete guest virtual [addr, len].
 		   Throws an exception if there was a protection violation.
 		   Returns the number of buffers filled, or an exception if not enough. */
@@ -147,7 +153,10 @@ namespace riscv
 		uint64_t memory_usage_total() const noexcept;
 		// Helpers for memory usage
 		size_t pages_active() const noexcept { return m_pages.size(); }
-		size_t owned_pages_active() const noexcept;
+		size_t owned_pages_active() const noexcept { return m_owned_pages; }
+		// Owned pages and execute segment limits (see Machine::set_resource_limits)
+		void set_resource_limits(const ResourceLimits&);
+		size_t execute_segments_count() const noexcept { return m_exec_segs; }
 		// Page handling
 		const auto& pages() const noexcept { return m_pages; }
 		auto& pages() noexcept { return m_pages; }
@@ -165,6 +174,10 @@ namespace riscv
 		// Page creation & destruction
 		template <typename... Args>
 		Page& allocate_page(address_t page, Args&& ...);
+		// Allocate an owned page on-demand, reusing retired page data
+		// when available. Used by the default page fault handlers.
+		Page& allocate_pooled_page(address_t page, bool init);
+		size_t pooled_pages() const noexcept { return m_page_pool.size(); }
 		void  invalidate_cache(address_t pageno, Page*) const noexcept;
 		void  invalidate_reset_cache() const noexcept;
 		void  free_pages(address_t, size_t len);
@@ -198,6 +211,19 @@ namespace riscv
 		// create pages for non-owned (shared) memory with given attributes
 		void insert_non_owned_memory(
 			address_t dst, void* src, size_t size, PageAttributes = {});
+		// Map a host buffer at dst so that several machines can share it
+		// without copying, each with its own permissions. Guest atomics on
+		// the region stay coherent across host threads. Inside the flat
+		// arena the buffer must come from allocate_shared_memory().
+		void insert_shared_memory(
+			address_t dst, void* src, size_t size, PageAttributes = {});
+		static void* allocate_shared_memory(size_t size);
+		static void  free_shared_memory(void* src, size_t size);
+		// Export a range of guest memory to the host without copying, with
+		// tracking of guest writes (see memory_surface.hpp). The surface
+		// stays valid until released, or until the machine is destroyed.
+		MemorySurface<W>& export_surface(address_t addr, size_t len);
+		void release_surface(MemorySurface<W>&);
 
 		// Custom execute segment, returns page base, final size and execute segment pointer
 		std::shared_ptr<DecodedExecuteSegment<W>>& exec_segment_for(address_t vaddr);
@@ -207,8 +233,22 @@ namespace riscv
 		// Evict all execute segments, also disabling the main execute segment
 		void evict_execute_segments();
 		void evict_execute_segment(DecodedExecuteSegment<W>&);
+		// Mark likely-JIT execute segments overlapping the range as stale, so
+		// that rewritten code is decoded (and translated) again on next entry
+		void invalidate_jit_segments(address_t addr, address_t len);
 #ifdef RISCV_BINARY_TRANSLATION
 		std::vector<address_t> gather_jump_hints() const;
+		std::vector<TranslatorBranchHint<W>> gather_branch_profile() const;
+
+		// Direct-mapped page cache probed in-line by binary translated code
+		// for memory accesses that fall outside of the flat arena.
+		static constexpr unsigned TLB_ENTRIES = 64;
+		struct TLBEntry {
+			address_t pageno = (address_t)-1;
+			uint8_t*  data = nullptr;
+		};
+		const auto& translator_tlb() const noexcept { return m_tlb; }
+		void translator_tlb_fill(address_t addr, bool write) const noexcept;
 #endif
 
 		const auto& binary() const noexcept { return m_binary; }
@@ -223,10 +263,20 @@ namespace riscv
 		address_t memory_arena_read_boundary() const noexcept { return this->m_arena.read_boundary; }
 		address_t memory_arena_write_boundary() const noexcept { return this->m_arena.write_boundary; }
 		address_t initial_rodata_end() const noexcept { return this->m_arena.initial_rodata_end; }
+		/// @brief True when guest page protections are mirrored onto the arena.
+		/// See MachineOptions::use_arena_host_protections.
+		bool uses_arena_host_protections() const noexcept { return this->m_arena.protection != nullptr; }
+		/// @brief Protect arena pages again that host code had to unprotect.
+		void restore_arena_protections() {
+			if (m_arena.protection->needs_restore())
+				m_arena.protection->restore();
+		}
 
 		// Serializes the current memory state to an existing vector
 		// Returns the final size of the serialized state
-		size_t serialize_to(std::vector<uint8_t>& vec) const;
+		size_t serialize_to(std::vector<uint8_t>& vec, const std::vector<address_t>& arena_pages = {}) const;
+		// Flat arena pages that have been accessed, but have no page table entry
+		std::vector<address_t> touched_arena_pages() const;
 		// Returns memory to a previously stored state
 		void deserialize_from(const std::vector<uint8_t>&, const SerializedMachine<W>&);
 
@@ -246,6 +296,29 @@ namespace riscv
 		template <typename T>
 		static void memview_helper(T& mem, address_t addr, size_t len,
 			std::function<void(T&, const uint8_t*, size_t)> callback);
+		void memdiscard_pages(address_t dst, size_t len, bool ignore_protections);
+		void surfaces_written(address_t addr, size_t len);
+		void memdiscard_arena(address_t begin, address_t end, bool ignore_protections);
+		// Zero the arena pages [first, last) without touching page attributes.
+		// Shared memory in the range is cleared, or with unshare replaced.
+		void zero_arena_pages(address_t first, address_t last, bool unshare = false);
+		void forget_shared_arena(address_t first, address_t last);
+		// Visit the pages in [first, last) that are in the page table,
+		// by scanning either the range or the table, whichever is smaller
+		template <typename Func>
+		void foreach_page_in(address_t first, address_t last, Func func) const {
+			if (m_pages.size() < last - first) {
+				for (const auto& it : m_pages)
+					if (it.first >= first && it.first < last)
+						func(it.first, it.second);
+			} else {
+				for (address_t pageno = first; pageno < last; pageno++) {
+					auto it = m_pages.find(pageno);
+					if (it != m_pages.end())
+						func(pageno, it->second);
+				}
+			}
+		}
 		// ELF stuff
 		using Elf = typename riscv::Elf<W>;
 		template <typename T> T* elf_offset(size_t ofs) const {
@@ -284,8 +357,20 @@ namespace riscv
 
 		mutable CachedPage<W, const PageData> m_rd_cache;
 		mutable CachedPage<W, PageData> m_wr_cache;
+#ifdef RISCV_BINARY_TRANSLATION
+		// Read entries followed by write entries
+		mutable std::array<TLBEntry, 2 * TLB_ENTRIES> m_tlb;
+#endif
 
 		std::unordered_map<address_t, Page> m_pages;
+		// Owned pages are counted as they are created, copied and freed
+		void check_owned_pages_limit() const;
+		void recount_owned_pages() noexcept;
+		size_t   m_owned_pages = 0;
+		uint64_t m_owned_pages_max = UINT64_MAX;
+		// Page data of freed pages, eg. the stacks of exited threads
+		std::vector<std::unique_ptr<PageData>> m_page_pool;
+		unsigned m_exec_segs_max = MAX_EXECUTE_SEGS;
 
 		const bool m_original_machine;
 		bool m_is_dynamic = false;
@@ -307,6 +392,10 @@ namespace riscv
 		// Execute segments
 		std::array<std::shared_ptr<DecodedExecuteSegment<W>>, MAX_EXECUTE_SEGS> m_exec;
 		size_t m_exec_segs = 0;
+		// Execute segments shared with the master machine and its forks
+		std::shared_ptr<ExecuteSegmentFamily<W>> m_exec_family = nullptr;
+
+		std::vector<std::unique_ptr<MemorySurface<W>>> m_surfaces;
 		std::shared_ptr<DecodedExecuteSegment<W>>& next_execute_segment();
 
 		// Linear arena at start of memory (mmap-backed)
@@ -316,6 +405,10 @@ namespace riscv
 			address_t write_boundary = 0;
 			address_t initial_rodata_end = 0;
 			size_t    pages = 0;
+			// Guest page protections mirrored onto the host, shared with forks
+			std::shared_ptr<ArenaHostProtection> protection = nullptr;
+			// Page ranges aliased onto memory from allocate_shared_memory()
+			std::vector<std::pair<address_t, address_t>> shared;
 		} m_arena;
 
 		friend struct CPU<W>;
@@ -444,6 +444,10 @@ template <int W> inline
 size_t Memory<W>::gather_writable_buffers_from_range(
 	size_t cnt, vBuffer buffers[], address_t addr, size_t len)
 {
+	// The buffers may be written to by the host kernel, which
+	// would fail instead of faulting on write-tracked surfaces
+	if (UNLIKELY(!m_surfaces.empty()))
+		this->surfaces_written(addr, len);
 	size_t index = 0;
 	vBuffer* last = nullptr;
 	while (len != 0 && index < cnt)
@@ -56,6 +56,7 @@ inline const Page& Memory<W>::get_pageno(const address_t pageno) const
 		return it->second;
 	}
 
+	ScopedThrowingFaults throwing_faults;
 	return m_page_readf_handler(*this, pageno);
 }
 
@@ -68,6 +69,14 @@ Memory<W>::invalidate_cache(address_t pageno, Page* page) const noexcept
 	if (m_rd_cache.pageno == pageno) {
 		m_rd_cache.pageno = (address_t)-1;
 	}
+#ifdef RISCV_BINARY_TRANSLATION
+	auto& rd_entry = m_tlb[pageno % TLB_ENTRIES];
+	if (rd_entry.pageno == pageno)
+		rd_entry.pageno = (address_t)-1;
+	auto& wr_entry = m_tlb[TLB_ENTRIES + pageno % TLB_ENTRIES];
+	if (wr_entry.pageno == pageno)
+		wr_entry.pageno = (address_t)-1;
+#endif
 	(void)page;
 }
 template <int W> inline void
@@ -75,8 +84,43 @@ Memory<W>::invalidate_reset_cache() const noexcept
 {
 	m_rd_cache.pageno = (address_t)-1;
 	m_wr_cache.pageno = (address_t)-1;
+#ifdef RISCV_BINARY_TRANSLATION
+	for (auto& entry : m_tlb)
+		entry.pageno = (address_t)-1;
+#endif
 }
 
+#ifdef RISCV_BINARY_TRANSLATION
+template <int W> inline void
+Memory<W>::translator_tlb_fill(address_t addr, bool write) const noexcept
+{
+	const auto pageno = page_number(addr);
+	auto& entry = m_tlb[(write ? TLB_ENTRIES : 0) + pageno % TLB_ENTRIES];
+	if constexpr (flat_readwrite_arena) {
+		// Arena pages are only cached when the whole page is accessible
+		const address_t base = pageno * Page::size();
+		const address_t last = base + (Page::size() - 1);
+		if (m_arena.data != nullptr) {
+			if (!write && base - RWREAD_BEGIN < m_arena.read_boundary && last - RWREAD_BEGIN < m_arena.read_boundary) {
+				entry = {pageno, (uint8_t *)m_arena.data + base};
+				return;
+			}
+			if (write && base - m_arena.initial_rodata_end < m_arena.write_boundary && last - m_arena.initial_rodata_end < m_arena.write_boundary) {
+				entry = {pageno, (uint8_t *)m_arena.data + base};
+				return;
+			}
+		}
+	}
+	// Otherwise, only pages that were just cached by the regular access path
+	if (write) {
+		if (m_wr_cache.pageno == pageno)
+			entry = {pageno, m_wr_cache.page->buffer8.data()};
+	} else if (m_rd_cache.pageno == pageno) {
+		entry = {pageno, const_cast<uint8_t *>(m_rd_cache.page->buffer8.data())};
+	}
+}
+#endif
+
 template <int W>
 template <typename... Args> inline
 Page& Memory<W>::allocate_page(const address_t page, Args&&... args)
@@ -85,6 +129,14 @@ Page& Memory<W>::allocate_page(const address_t page, Args&&... args)
 		page,
 		std::forward<Args> (args)...
 	);
+	if (it.second && !it.first->second.attr.non_owning) {
+		if (UNLIKELY(this->m_owned_pages >= this->m_owned_pages_max)) {
+			// Remove only the page that was just created
+			m_pages.erase(it.first);
+			this->check_owned_pages_limit();
+		}
+		this->m_owned_pages++;
+	}
 	// Invalidate only this page
 	this->invalidate_cache(page, &it.first->second);
 	// Return new default-writable page
@@ -92,13 +144,13 @@ Page& Memory<W>::allocate_page(const address_t page, Args&&... args)
 }
 
 template <int W>
-inline size_t Memory<W>::owned_pages_active() const noexcept
+inline void Memory<W>::recount_owned_pages() noexcept
 {
 	size_t count = 0;
 	for (const auto& it : m_pages) {
 		if (!it.second.attr.non_owning) count++;
 	}
-	return count;
+	this->m_owned_pages = count;
 }
 
 template <int W>
@@ -107,9 +159,14 @@ inline void Memory<W>::trap(address_t page_addr, mmio_cb_t callback)
 	// This can probably be improved, but this will force-create
 	// a page if it doesn't exist. At least this way the trap will
 	// always work. Less surprises this way.
-	auto& page = create_writable_pageno(page_number(page_addr));
+	const auto pageno = page_number(page_addr);
+	auto& page = create_writable_pageno(pageno);
 	// Disabling caching will force the slow-path for the page,
 	// and enables page traps when RISCV_DEBUG is enabled.
 	page.attr.cacheable = false;
 	page.set_trap(callback);
+	// The page may already be cached, which would bypass the trap
+	this->invalidate_cache(pageno, &page);
+	if (m_wr_cache.pageno == pageno)
+		m_wr_cache.pageno = (address_t)-1;
 }
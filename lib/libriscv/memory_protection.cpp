@@ -0,0 +1,219 @@
+#include "memory_protection.hpp"
+
+#include "landing_pad.hpp"
+#include "memory_surface.hpp"
+#include <algorithm>
+#include <cstring>
+#ifdef __linux__
+#include <mutex>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace riscv
+{
+#ifdef __linux__
+	static constexpr size_t MAX_ARENAS = 256;
+	static std::array<std::atomic<ArenaHostProtection*>, MAX_ARENAS> g_arenas {};
+	static struct sigaction g_previous_segv;
+
+	static int host_prot(PageAttributes attr) noexcept
+	{
+		// The host cannot express write-only pages
+		if (attr.write)
+			return PROT_READ | PROT_WRITE;
+		return attr.read ? PROT_READ : PROT_NONE;
+	}
+
+	static ArenaHostProtection* find_arena(uintptr_t addr) noexcept
+	{
+		for (auto& slot : g_arenas) {
+			auto* arena = slot.load(std::memory_order_acquire);
+			if (arena != nullptr && addr >= arena->begin && addr < arena->end)
+				return arena;
+		}
+		return nullptr;
+	}
+
+	extern "C"
+	void host_fault_sighandler(int sig, siginfo_t* si, void* usr)
+	{
+		const uintptr_t addr = uintptr_t(si->si_addr);
+		void* page_addr = (void *)(addr & ~uintptr_t(Page::size()-1));
+		// Surfaces first, as a surface may be inside a protected arena
+		auto* tracker = SurfaceWriteTracker::find(addr);
+		auto* arena = find_arena(addr);
+		if (arena != nullptr) {
+			const uintptr_t offset = addr - arena->begin;
+			const size_t page = offset / Page::size();
+			if (arena->host_protection(page) == (PROT_READ | PROT_WRITE)) {
+				// Only surface write tracking protected this page
+				if (tracker != nullptr)
+					tracker->generation.fetch_add(1, std::memory_order_release);
+				if (mprotect(page_addr, Page::size(), PROT_READ | PROT_WRITE) == 0)
+					return;
+			} else if (FaultLandingPad::active()) {
+				// A guest access. Leaving with longjmp() keeps SIGSEGV
+				// blocked, which would make the next fault fatal.
+				sigset_t set;
+				sigemptyset(&set);
+				sigaddset(&set, SIGSEGV);
+				pthread_sigmask(SIG_UNBLOCK, &set, nullptr);
+				FaultLandingPad::raise(PROTECTION_FAULT, "Protection fault", offset);
+			} else {
+				// Host code ignores arena protections
+				if (tracker != nullptr)
+					tracker->generation.fetch_add(1, std::memory_order_release);
+				if (arena->unprotect(page))
+					return;
+			}
+		} else if (tracker != nullptr) {
+			// The first write to this page since the last protect()
+			tracker->generation.fetch_add(1, std::memory_order_release);
+			if (mprotect(page_addr, Page::size(), PROT_READ | PROT_WRITE) == 0)
+				return;
+		}
+		// Not ours, or the page could not be made accessible:
+		// Forward to the previous handler
+		if (g_previous_segv.sa_flags & SA_SIGINFO) {
+			g_previous_segv.sa_sigaction(sig, si, usr);
+		} else if (g_previous_segv.sa_handler == SIG_DFL || g_previous_segv.sa_handler == SIG_IGN) {
+			// Restore the default action, and let the access fault again
+			sigaction(SIGSEGV, &g_previous_segv, nullptr);
+		} else {
+			g_previous_segv.sa_handler(sig);
+		}
+	}
+
+	void install_host_fault_handler()
+	{
+		// Protections are applied with Page::size() granularity
+		if (sysconf(_SC_PAGESIZE) != long(Page::size()))
+			throw MachineException(FEATURE_DISABLED,
+				"Host memory protections require a host page size of 4KB", sysconf(_SC_PAGESIZE));
+
+		static std::once_flag handler_installed;
+		std::call_once(handler_installed, [] {
+			struct sigaction sa {};
+			sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+			sa.sa_sigaction = host_fault_sighandler;
+			sigemptyset(&sa.sa_mask);
+			if (::sigaction(SIGSEGV, &sa, &g_previous_segv) < 0)
+				throw MachineException(ILLEGAL_OPERATION, "sigaction failed");
+		});
+	}
+
+	bool host_protect_range(uintptr_t begin, uintptr_t end, int prot) noexcept
+	{
+		for (auto& slot : g_arenas) {
+			auto* arena = slot.load(std::memory_order_acquire);
+			if (arena != nullptr && begin < arena->end && end > arena->begin) {
+				bool success = true;
+				if (begin < arena->begin)
+					success &= host_protect_range(begin, arena->begin, prot);
+				if (end > arena->end)
+					success &= host_protect_range(arena->end, end, prot);
+				const uintptr_t first = std::max(begin, arena->begin) - arena->begin;
+				const uintptr_t last  = std::min(end, arena->end) - arena->begin;
+				success &= arena->protect_at_most(first / Page::size(), last / Page::size(), prot);
+				return success;
+			}
+		}
+		return mprotect((void *)begin, end - begin, prot) == 0;
+	}
+
+	ArenaHostProtection::ArenaHostProtection(void* arena, size_t pages)
+		: begin(uintptr_t(arena)), end(uintptr_t(arena) + pages * Page::size()),
+		  m_prot(new uint8_t[pages])
+	{
+		std::memset(m_prot.get(), PROT_READ | PROT_WRITE, pages);
+
+		install_host_fault_handler();
+
+		for (auto& slot : g_arenas) {
+			ArenaHostProtection* expected = nullptr;
+			if (slot.compare_exchange_strong(expected, this, std::memory_order_acq_rel))
+				return;
+		}
+		throw MachineException(RESOURCE_LIMIT_REACHED, "Too many protected arenas", MAX_ARENAS);
+	}
+
+	ArenaHostProtection::~ArenaHostProtection()
+	{
+		for (auto& slot : g_arenas) {
+			ArenaHostProtection* expected = this;
+			if (slot.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+	void ArenaHostProtection::protect(size_t first, size_t last, PageAttributes attr)
+	{
+		const int prot = host_prot(attr);
+		std::memset(&m_prot[first], prot, last - first);
+		if (mprotect((void *)(begin + first * Page::size()), (last - first) * Page::size(), prot) < 0)
+			throw MachineException(ILLEGAL_OPERATION, "Unable to protect arena pages", first * Page::size());
+	}
+
+	bool ArenaHostProtection::unprotect(size_t page) noexcept
+	{
+		const size_t index = m_unprotected_count.fetch_add(1, std::memory_order_acq_rel);
+		if (index < MAX_UNPROTECTED)
+			m_unprotected[index].store(page, std::memory_order_relaxed);
+		return mprotect((void *)(begin + page * Page::size()), Page::size(), PROT_READ | PROT_WRITE) == 0;
+	}
+
+	bool ArenaHostProtection::protect_at_most(size_t first, size_t last, int prot) noexcept
+	{
+		bool success = true;
+		for (size_t page = first; page < last; ) {
+			size_t next = page + 1;
+			while (next < last && m_prot[next] == m_prot[page])
+				next++;
+			success &= mprotect((void *)(begin + page * Page::size()),
+				(next - page) * Page::size(), prot & m_prot[page]) == 0;
+			page = next;
+		}
+		return success;
+	}
+
+	void ArenaHostProtection::restore()
+	{
+		bool success = true;
+		const size_t count = m_unprotected_count.exchange(0, std::memory_order_acq_rel);
+		if (count <= MAX_UNPROTECTED) {
+			for (size_t i = 0; i < count; i++) {
+				const size_t page = m_unprotected[i].load(std::memory_order_relaxed);
+				success &= mprotect((void *)(begin + page * Page::size()), Page::size(), m_prot[page]) == 0;
+			}
+		} else {
+			// Too many pages to remember: Protect all runs of protected pages
+			const size_t pages = (end - begin) / Page::size();
+			for (size_t page = 0; page < pages; ) {
+				size_t last = page + 1;
+				while (last < pages && m_prot[last] == m_prot[page])
+					last++;
+				if (m_prot[page] != (PROT_READ | PROT_WRITE))
+					success &= mprotect((void *)(begin + page * Page::size()), (last - page) * Page::size(), m_prot[page]) == 0;
+				page = last;
+			}
+		}
+		if (!success)
+			throw MachineException(ILLEGAL_OPERATION, "Unable to restore arena protections");
+	}
+#else
+	ArenaHostProtection::ArenaHostProtection(void* arena, size_t pages)
+		: begin(uintptr_t(arena)), end(uintptr_t(arena) + pages * Page::size())
+	{
+		throw MachineException(FEATURE_DISABLED,
+			"Arena host protections are only supported on Linux");
+	}
+	ArenaHostProtection::~ArenaHostProtection() {}
+	void ArenaHostProtection::protect(size_t, size_t, PageAttributes) {}
+	bool ArenaHostProtection::unprotect(size_t) noexcept { return false; }
+	bool ArenaHostProtection::protect_at_most(size_t, size_t, int) noexcept { return false; }
+	void ArenaHostProtection::restore() {}
+#endif
+
+} // riscv
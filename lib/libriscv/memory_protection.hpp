@@ -0,0 +1,58 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <memory>
+#include "page.hpp"
+
+namespace riscv
+{
+	/// Guest page protections mirrored onto the host mapping of the flat
+	/// arena, so that guard pages, write barriers and W^X flips are enforced
+	/// by the host MMU while accesses stay on the arena fast-path. Guest
+	/// accesses to protected pages take a host fault, which becomes a guest
+	/// PROTECTION_FAULT at the active FaultLandingPad.
+	/// Host code (eg. system call handlers) ignores arena protections, as
+	/// before: When it faults, the page is unprotected until restore().
+	/// Only available on Linux. See MachineOptions::use_arena_host_protections.
+	struct ArenaHostProtection
+	{
+		static constexpr size_t MAX_UNPROTECTED = 64;
+
+		ArenaHostProtection(void* arena, size_t pages);
+		~ArenaHostProtection();
+		ArenaHostProtection(const ArenaHostProtection&) = delete;
+		ArenaHostProtection& operator=(const ArenaHostProtection&) = delete;
+
+		/// @brief Apply the attributes to arena pages [first, last).
+		void protect(size_t first, size_t last, PageAttributes attr);
+		/// @brief Protect pages that host code had to unprotect again.
+		void restore();
+		bool needs_restore() const noexcept { return m_unprotected_count.load(std::memory_order_relaxed) != 0; }
+
+		/// @brief Called from the fault handler: Host code touched the page.
+		bool unprotect(size_t page) noexcept;
+		/// @brief Apply a host protection to arena pages [first, last), but
+		/// never grant more than the arena protection of each page.
+		bool protect_at_most(size_t first, size_t last, int prot) noexcept;
+		/// @brief The host protection of an arena page.
+		int host_protection(size_t page) const noexcept { return m_prot[page]; }
+
+		const uintptr_t begin;
+		const uintptr_t end;
+	private:
+		// Host protection of each arena page
+		std::unique_ptr<uint8_t[]> m_prot;
+		std::array<std::atomic<size_t>, MAX_UNPROTECTED> m_unprotected {};
+		std::atomic<size_t> m_unprotected_count = 0;
+	};
+
+	/// @brief Install the one process-wide SIGSEGV handler of the library.
+	/// @details Exported surfaces are consulted before arena protections,
+	/// as a surface may be inside a protected arena. Other faults are
+	/// forwarded to the handler that was installed before.
+	void install_host_fault_handler();
+	/// @brief Change the host protection of [begin, end) without granting
+	/// more than the protections of an arena that overlaps the range.
+	bool host_protect_range(uintptr_t begin, uintptr_t end, int prot) noexcept;
+
+} // riscv
@@ -29,7 +29,15 @@ namespace riscv
 			if (LIKELY(page.attr.write)) {
 				return page;
 			} else if (page.attr.is_cow) {
-				m_page_write_handler(*this, pageno, page);
+				const bool was_owned = !page.attr.non_owning;
+				if (!was_owned)
+					this->check_owned_pages_limit();
+				{
+					ScopedThrowingFaults throwing_faults;
+					m_page_write_handler(*this, pageno, page);
+				}
+				if (!was_owned && !page.attr.non_owning)
+					this->m_owned_pages++;
 				// The page may be read-cached at this time
 				// and the page data has likely changed now.
 				this->invalidate_cache(pageno, &page);
@@ -37,7 +45,10 @@ namespace riscv
 			}
 		} else {
 			// Handler must produce a new page, or throw
-			Page& page = m_page_fault_handler(*this, pageno, init);
+			Page& page = [&] () -> Page& {
+				ScopedThrowingFaults throwing_faults;
+				return m_page_fault_handler(*this, pageno, init);
+			}();
 			if (LIKELY(page.attr.write)) {
 				this->invalidate_cache(pageno, &page);
 				return page;
@@ -60,6 +71,10 @@ namespace riscv
 				page.attr.is_cow = true;
 				page.attr.write = false;
 			}
+			// Cached pages may no longer have the same permissions
+			this->invalidate_cache(pageno, &page);
+			if (m_wr_cache.pageno == pageno)
+				m_wr_cache.pageno = (address_t)-1;
 			return;
 		}
 
@@ -68,6 +83,9 @@ namespace riscv
 		{
 			auto& page = this->create_writable_pageno(pageno);
 			page.attr.apply_regular_attributes(attr);
+			this->invalidate_cache(pageno, &page);
+			if (m_wr_cache.pageno == pageno)
+				m_wr_cache.pageno = (address_t)-1;
 			return;
 		}
 
@@ -87,10 +105,99 @@ namespace riscv
 
 	template <int W>
 	void Memory<W>::memdiscard(address_t dst, size_t len, bool ignore_protections)
+	{
+		if constexpr (MADVISE_ENABLED && flat_readwrite_arena) {
+			// Whole pages inside the arena are discarded as one range
+			const address_t begin = (dst + PageMask) & ~address_t(PageMask);
+			const address_t end = std::min(address_t((dst + len) & ~address_t(PageMask)), address_t(memory_arena_size()));
+			// Forks share the arena with their master, so they discard page by page
+			if (!this->is_forked() && dst + len >= dst && begin >= dst && begin < end) {
+				this->memdiscard_pages(dst, begin - dst, ignore_protections);
+				this->memdiscard_arena(begin, end, ignore_protections);
+				this->memdiscard_pages(end, dst + len - end, ignore_protections);
+				return;
+			}
+		}
+		this->memdiscard_pages(dst, len, ignore_protections);
+	}
+
+	template <int W>
+	void Memory<W>::memdiscard_arena(address_t begin, address_t end, bool ignore_protections)
+	{
+		const address_t first = page_number(begin);
+		const address_t last  = page_number(end);
+		// Pages that are not simply arena-backed are handled individually
+		std::vector<address_t> others;
+		this->foreach_page_in(first, last, [&] (address_t pageno, const Page& page) {
+			if (page.is_cow_page())
+				return;
+			if (page.attr.is_cow || page.m_page.get() != &m_arena.data[pageno])
+				others.push_back(pageno);
+			else if (!page.attr.write && !ignore_protections)
+				this->protection_fault(pageno * Page::size());
+		});
+		// A single host call zeroes the whole range
+		this->zero_arena_pages(first, last);
+
+		for (const address_t pageno : others)
+			this->memdiscard_pages(pageno * Page::size(), Page::size(), ignore_protections);
+	}
+
+	template <int W>
+	void Memory<W>::zero_arena_pages(address_t first, address_t last, bool unshare)
 	{
 #ifndef MADV_DONTNEED
 		static constexpr int MADV_DONTNEED = 0x4;
 #endif
+		last = std::min(last, address_t(m_arena.pages));
+		if (first >= last)
+			return;
+		if constexpr (MADVISE_ENABLED) {
+			madvise(&m_arena.data[first], (last - first) * Page::size(), MADV_DONTNEED);
+		} else {
+			std::memset(m_arena.data[first].buffer8.data(), 0, (last - first) * Page::size());
+		}
+		// MADV_DONTNEED does not zero pages aliased from shared memory
+		for (const auto& range : m_arena.shared) {
+			const address_t begin = std::max(first, range.first);
+			const address_t end   = std::min(last, range.second);
+			if (begin >= end)
+				continue;
+			const size_t len = (end - begin) * Page::size();
+#ifdef __linux__
+			if (unshare) {
+				// Replace the alias with private zero pages
+				void* res = mmap(&m_arena.data[begin], len, PROT_READ | PROT_WRITE,
+					MAP_FIXED | MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+				if (res == MAP_FAILED)
+					throw MachineException(OUT_OF_MEMORY, "Unable to unshare arena memory", begin * Page::size());
+				if (m_arena.protection != nullptr)
+					m_arena.protection->protect_at_most(begin, end, PROT_READ | PROT_WRITE);
+				continue;
+			}
+#endif
+			std::memset(m_arena.data[begin].buffer8.data(), 0, len);
+		}
+		if (unshare)
+			this->forget_shared_arena(first, last);
+	}
+
+	template <int W>
+	void Memory<W>::forget_shared_arena(address_t first, address_t last)
+	{
+		std::vector<std::pair<address_t, address_t>> remaining;
+		for (const auto& range : m_arena.shared) {
+			if (range.first < first)
+				remaining.emplace_back(range.first, std::min(range.second, first));
+			if (range.second > last)
+				remaining.emplace_back(std::max(range.first, last), range.second);
+		}
+		m_arena.shared = std::move(remaining);
+	}
+
+	template <int W>
+	void Memory<W>::memdiscard_pages(address_t dst, size_t len, bool ignore_protections)
+	{
 		while (len > 0)
 		{
 			const size_t offset = dst & (Page::size()-1); // offset within page
@@ -107,14 +214,25 @@ namespace riscv
 					// This is the zero-page
 				} else {
 					if (page.attr.is_cow) {
-						m_page_write_handler(*this, pageno, page);
+						const bool was_owned = !page.attr.non_owning;
+						if (!was_owned)
+							this->check_owned_pages_limit();
+						{
+							ScopedThrowingFaults throwing_faults;
+							m_page_write_handler(*this, pageno, page);
+						}
+						if (!was_owned && !page.attr.non_owning)
+							this->m_owned_pages++;
+						this->invalidate_cache(pageno, &page);
 					}
 					if (page.attr.write || ignore_protections) {
 
 						if constexpr (MADVISE_ENABLED) {
 							// madvise "fast-path" (XXX: doesn't scale on busy server)
-							if (offset == 0 && size == Page::size()) {
-								madvise(page.data(), Page::size(), MADV_DONTNEED);
+							// Only arena pages are backed by page-aligned host memory
+							if (offset == 0 && size == Page::size() && pageno < m_arena.pages
+								&& page.m_page.get() == &m_arena.data[pageno]) {
+								this->zero_arena_pages(pageno, pageno + 1);
 							} else {
 								std::memset(page.data() + offset, 0, size);
 							}
@@ -131,26 +249,8 @@ namespace riscv
 				// Create arena-page
 				if (flat_readwrite_arena && pageno < this->m_arena.pages)
 				{
-					// Fast-path using madvise
-					if constexpr (MADVISE_ENABLED) {
-						// XXX: doesn't scale on busy server
-						if (offset == 0 && size == Page::size()) {
-							address_t new_dst = dst + (len & ~address_t(Page::size()-1));
-							new_dst = std::min(new_dst, (address_t)memory_arena_size());
-							const size_t new_size = new_dst - dst;
-
-							auto* baseptr = &((uint8_t *)m_arena.data)[dst];
-							madvise(baseptr, Page::size(), MADV_DONTNEED);
-
-							dst += new_size;
-							len -= new_size;
-							continue;
-						}
-					}
-
 					auto& page = this->create_writable_pageno(pageno);
-					// Unfortunately we don't know if this page is untouched,
-					// but we can use MADV_DONTNEED
+					// Unfortunately we don't know if this page is untouched
 					if (page.attr.write || ignore_protections) {
 						std::memset(page.data() + offset, 0, size);
 					} else if (!ignore_protections) {
@@ -167,21 +267,109 @@ namespace riscv
 		}
 	}
 
+	static constexpr size_t POPULATE_RESERVE_MAX = 16384;
+
+	template <int W>
+	void Memory<W>::populate_pages(address_t dst, size_t len)
+	{
+		const address_t first = page_number(dst);
+		const address_t last  = page_number(dst + len + PageMask);
+		if (dst + len < dst || first >= last)
+			return;
+
+		address_t pageno = first;
+		if constexpr (MADVISE_ENABLED && flat_readwrite_arena) {
+			// Pre-fault the arena part of the range with a single host call
+			const address_t arena_last = std::min(last, address_t(m_arena.pages));
+			if (pageno < arena_last) {
+#ifdef MADV_POPULATE_WRITE
+				madvise(&m_arena.data[pageno], (arena_last - pageno) * Page::size(), MADV_POPULATE_WRITE);
+#else
+				madvise(&m_arena.data[pageno], (arena_last - pageno) * Page::size(), MADV_WILLNEED);
+#endif
+				pageno = arena_last;
+			}
+		}
+		if (pageno >= last)
+			return;
+
+		// Allocate the remaining writable pages up front
+		m_pages.reserve(m_pages.size() + std::min(size_t(last - pageno), POPULATE_RESERVE_MAX));
+		try {
+			for (; pageno < last; pageno++) {
+				auto it = m_pages.find(pageno);
+				if (it == m_pages.end() || it->second.attr.is_cow)
+					this->create_writable_pageno(pageno);
+			}
+		} catch (const MachineException&) {
+			// Pre-population is only advice, so memory limits end it early
+		}
+	}
+
 	template <int W>
 	bool Memory<W>::free_pageno(address_t pageno)
 	{
-		return m_pages.erase(pageno) != 0;
+		auto it = m_pages.find(pageno);
+		if (it == m_pages.end())
+			return false;
+		auto& page = it->second;
+		if (!page.attr.non_owning) {
+			this->m_owned_pages--;
+			// Keep the page data around for the next page fault
+			if (m_page_pool.size() < PAGE_POOL_MAX && page.m_page != nullptr && !page.is_cow_page())
+				m_page_pool.push_back(std::move(page.m_page));
+		}
+		m_pages.erase(it);
+		return true;
+	}
+
+	template <int W>
+	Page& Memory<W>::allocate_pooled_page(address_t pageno, bool init)
+	{
+		if (m_page_pool.empty())
+			return this->allocate_page(pageno,
+				init ? PageData::INITIALIZED : PageData::UNINITIALIZED);
+
+		auto data = std::move(m_page_pool.back());
+		m_page_pool.pop_back();
+		if (init)
+			data->buffer8 = {};
+		return this->allocate_page(pageno, std::move(data));
+	}
+
+	template <int W>
+	void Memory<W>::check_owned_pages_limit() const
+	{
+		if (UNLIKELY(this->m_owned_pages >= this->m_owned_pages_max)) {
+			throw MachineException(RESOURCE_LIMIT_REACHED, "Owned pages limit reached", m_owned_pages_max);
+		}
+	}
+
+	template <int W>
+	void Memory<W>::set_resource_limits(const ResourceLimits& limits)
+	{
+		this->m_owned_pages_max = limits.owned_pages;
+		this->m_exec_segs_max = std::min(size_t(limits.execute_segments), MAX_EXECUTE_SEGS);
 	}
 
 	template <int W>
 	void Memory<W>::free_pages(address_t dst, size_t len)
 	{
-		address_t pageno = page_number(dst);
-		address_t end = pageno + (len /= Page::size());
-		while (pageno < end)
-		{
+		const address_t first = page_number(dst);
+		const address_t last  = first + len / Page::size();
+		std::vector<address_t> pages;
+		this->foreach_page_in(first, last, [&] (address_t pageno, const Page&) {
+			pages.push_back(pageno);
+		});
+		for (const address_t pageno : pages)
 			this->free_pageno(pageno);
-			pageno ++;
+
+		if constexpr (MADVISE_ENABLED && flat_readwrite_arena) {
+			// Give the freed arena memory back to the host with a single call.
+			// Forks share the arena with their master, so they must not.
+			const address_t arena_last = std::min(last, address_t(m_arena.pages));
+			if (first < arena_last && !this->is_forked())
+				this->zero_arena_pages(first, arena_last, true);
 		}
 		// TODO: This can be improved by invalidating matches only
 		this->invalidate_reset_cache();
@@ -233,6 +421,11 @@ namespace riscv
 			0x73, 0x00, 0xf0, 0x7f,
 			// JMP -4 (jump back to STOP): 0xffdff06f
 			0x6f, 0xf0, 0xdf, 0xff,
+			// Signal return trampoline
+			// LI A7, 139 (rt_sigreturn): 0x08b00893
+			0x93, 0x08, 0xb0, 0x08,
+			// ECALL: 0x00000073
+			0x73, 0x00, 0x00, 0x00,
 			0x0
 		}
 	};
@@ -294,10 +487,91 @@ namespace riscv
 		this->invalidate_reset_cache();
 	}
 
+	template <int W>
+	void Memory<W>::insert_shared_memory(
+		address_t dst, void* src, size_t size, PageAttributes attr)
+	{
+		if (dst % Page::size() != 0 || size % Page::size() != 0 || uintptr_t(src) % Page::size() != 0)
+			throw MachineException(INVALID_ALIGNMENT, "Shared memory must be page-aligned", dst);
+		if (dst + size < dst)
+			throw MachineException(INVALID_PROGRAM, "Shared memory range overflows", dst);
+
+		const address_t arena_end = uses_flat_memory_arena() ? memory_arena_size() : 0;
+		if (dst < arena_end)
+		{
+			if (dst + size > arena_end)
+				throw MachineException(ILLEGAL_OPERATION,
+					"Shared memory cannot straddle the end of the arena", dst);
+			// Arena writes above the read-only data bypass page protections
+			if (!attr.write && dst + size > m_arena.initial_rodata_end)
+				throw MachineException(ILLEGAL_OPERATION,
+					"Read-only shared memory in the arena must end before rodata ends", dst);
+#ifdef __linux__
+			// Alias the same (shared) host pages into the arena. Any existing
+			// pages refer to arena memory, and so they see the new contents.
+			char* arena_dst = (char *)m_arena.data + dst;
+			void* res = mremap(src, 0, size, MREMAP_MAYMOVE | MREMAP_FIXED, arena_dst);
+			if (res == MAP_FAILED)
+				throw MachineException(ILLEGAL_OPERATION,
+					"Shared memory in the arena must come from allocate_shared_memory()", dst);
+			if (dst < m_arena.initial_rodata_end)
+				this->set_page_attr(dst, size, attr);
+			this->forget_shared_arena(page_number(dst), page_number(dst + size));
+			m_arena.shared.emplace_back(page_number(dst), page_number(dst + size));
+#else
+			throw MachineException(FEATURE_DISABLED,
+				"Shared memory in the arena is only supported on Linux", dst);
+#endif
+		}
+		else
+		{
+			// Writes go straight to the shared buffer
+			attr.is_cow = false;
+			this->free_pages(dst, size);
+			this->insert_non_owned_memory(dst, src, size, attr);
+		}
+		this->invalidate_reset_cache();
+	}
+
+	template <int W>
+	void* Memory<W>::allocate_shared_memory(size_t size)
+	{
+		size = (size + Page::size() - 1) & ~(Page::size() - 1);
+#ifdef __linux__
+		// Shared mappings can be aliased into flat arenas with mremap()
+		void* data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			throw MachineException(OUT_OF_MEMORY, "Unable to allocate shared memory", size);
+		return data;
+#else
+		return new PageData[size / Page::size()];
+#endif
+	}
+
+	template <int W>
+	void Memory<W>::free_shared_memory(void* src, size_t size)
+	{
+		size = (size + Page::size() - 1) & ~(Page::size() - 1);
+#ifdef __linux__
+		munmap(src, size);
+#else
+		(void)size;
+		delete[] (PageData *)src;
+#endif
+	}
+
 	template <int W> void
 	Memory<W>::set_page_attr(address_t dst, size_t len, PageAttributes attr)
 	{
 		//printf("set_page_attr(0x%lX, %zu, prot=%X)\n", long(dst), len, attr.to_prot());
+		if (m_arena.protection != nullptr && !this->is_forked() && len > 0) {
+			// Forks share the arena, and so also the protections of the master
+			const address_t first = page_number(dst);
+			const address_t last  = std::min(page_number(dst + len - 1) + 1, address_t(m_arena.pages));
+			if (first < last)
+				m_arena.protection->protect(first, last, attr);
+		}
 		while (len > 0)
 		{
 			const size_t size = std::min(Page::size(), len);
@@ -307,6 +581,8 @@ namespace riscv
 			dst += size;
 			len -= size;
 		}
+		// Cached pages may no longer have the same permissions
+		this->invalidate_reset_cache();
 	}
 
 	template <int W>
@@ -325,6 +601,7 @@ namespace riscv
 				(page.attr.non_owning && page_number < m_arena.pages))
 					total += Page::size();
 		}
+		total += m_page_pool.size() * Page::size();
 
 		for (const auto& exec : m_exec) {
 			if (exec)
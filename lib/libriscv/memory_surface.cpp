@@ -0,0 +1,183 @@
+#include "machine.hpp"
+
+#include "internal_common.hpp"
+#include "memory_protection.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <array>
+#include <sys/mman.h>
+#endif
+
+namespace riscv
+{
+#ifdef __linux__
+	static constexpr size_t MAX_TRACKERS = 256;
+	static std::array<std::atomic<SurfaceWriteTracker*>, MAX_TRACKERS> g_trackers {};
+
+	SurfaceWriteTracker* SurfaceWriteTracker::find(uintptr_t addr) noexcept
+	{
+		for (auto& slot : g_trackers) {
+			auto* tracker = slot.load(std::memory_order_acquire);
+			if (tracker != nullptr && addr >= tracker->begin && addr < tracker->end)
+				return tracker;
+		}
+		return nullptr;
+	}
+
+	void SurfaceWriteTracker::start(void* data, size_t len)
+	{
+		install_host_fault_handler();
+
+		this->begin = uintptr_t(data);
+		this->end   = uintptr_t(data) + len;
+		for (auto& slot : g_trackers) {
+			SurfaceWriteTracker* expected = nullptr;
+			if (slot.compare_exchange_strong(expected, this, std::memory_order_acq_rel))
+				return;
+		}
+		throw MachineException(RESOURCE_LIMIT_REACHED, "Too many exported surfaces", MAX_TRACKERS);
+	}
+
+	void SurfaceWriteTracker::stop()
+	{
+		// Make the pages writable before faults stop being handled
+		host_protect_range(begin, end, PROT_READ | PROT_WRITE);
+		for (auto& slot : g_trackers) {
+			SurfaceWriteTracker* expected = this;
+			if (slot.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+				return;
+		}
+	}
+
+	void SurfaceWriteTracker::protect()
+	{
+		if (!host_protect_range(begin, end, PROT_READ))
+			throw MachineException(ILLEGAL_OPERATION, "Unable to write-protect surface", begin);
+	}
+
+	void SurfaceWriteTracker::written()
+	{
+		generation.fetch_add(1, std::memory_order_release);
+		if (!host_protect_range(begin, end, PROT_READ | PROT_WRITE))
+			throw MachineException(ILLEGAL_OPERATION, "Unable to unprotect surface", begin);
+	}
+#else
+	SurfaceWriteTracker* SurfaceWriteTracker::find(uintptr_t) noexcept
+	{
+		return nullptr;
+	}
+	void SurfaceWriteTracker::start(void* data, size_t len)
+	{
+		this->begin = uintptr_t(data);
+		this->end   = uintptr_t(data) + len;
+	}
+	void SurfaceWriteTracker::stop() {}
+	void SurfaceWriteTracker::protect()
+	{
+		// Writes cannot be tracked, so assume that there were some
+		generation.fetch_add(1, std::memory_order_release);
+	}
+	void SurfaceWriteTracker::written() {}
+#endif
+
+	template <int W>
+	MemorySurface<W>::MemorySurface(address_t addr, size_t size, address_t pbase, uint8_t* pages, size_t plen, bool pinned)
+		: m_addr(addr), m_size(size), m_pbase(pbase), m_pages(pages), m_plen(plen),
+		  m_data(pages + (addr - pbase)), m_pinned(pinned)
+	{
+		m_tracker.start(pages, plen);
+	}
+
+	template <int W>
+	MemorySurface<W>::~MemorySurface()
+	{
+		m_tracker.stop();
+		if (m_pinned)
+			Memory<W>::free_shared_memory(m_pages, m_plen);
+	}
+
+	template <int W>
+	bool MemorySurface<W>::acquire()
+	{
+		// Protect before reading the generation, so that no write goes unseen
+		m_tracker.protect();
+		const uint64_t generation = this->generation();
+		const bool written = generation != m_acquired;
+		m_acquired = generation;
+		return written;
+	}
+
+	template <int W>
+	MemorySurface<W>& Memory<W>::export_surface(address_t addr, size_t len)
+	{
+		const address_t pbase = addr & ~address_t(Page::size()-1);
+		const address_t pend  = (addr + len + Page::size()-1) & ~address_t(Page::size()-1);
+		if (UNLIKELY(len == 0 || addr + len < addr || pend <= pbase))
+			throw MachineException(INVALID_PROGRAM, "Invalid surface range", addr);
+		if (UNLIKELY(is_forked()))
+			throw MachineException(ILLEGAL_OPERATION, "Surfaces cannot be exported from forked machines", addr);
+		for (const auto& surface : m_surfaces) {
+			if (surface->overlaps(pbase, pend - pbase))
+				throw MachineException(ILLEGAL_OPERATION, "Exported surfaces cannot share pages", addr);
+		}
+		const size_t plen = pend - pbase;
+
+		if (uses_flat_memory_arena() && pend <= memory_arena_size())
+		{
+			// The arena is already contiguous host memory
+			this->foreach_page_in(page_number(pbase), page_number(pend), [&] (address_t pageno, const Page& page) {
+				if (page.m_page.get() != &m_arena.data[pageno])
+					throw MachineException(ILLEGAL_OPERATION, "Surface pages must be arena pages", pageno * Page::size());
+			});
+			auto* pages = (uint8_t *)m_arena.data + pbase;
+			return *m_surfaces.emplace_back(
+				std::make_unique<MemorySurface<W>>(addr, len, pbase, pages, plen, false));
+		}
+
+		// Pin the pages to one contiguous host buffer
+		auto* pages = (uint8_t *)allocate_shared_memory(plen);
+		try {
+			this->memcpy_out(pages, pbase, plen);
+			auto surface = std::make_unique<MemorySurface<W>>(addr, len, pbase, pages, plen, true);
+			this->free_pages(pbase, plen);
+			this->insert_non_owned_memory(pbase, pages, plen, PageAttributes{});
+			return *m_surfaces.emplace_back(std::move(surface));
+		} catch (...) {
+			free_shared_memory(pages, plen);
+			throw;
+		}
+	}
+
+	template <int W>
+	void Memory<W>::release_surface(MemorySurface<W>& surface)
+	{
+		auto it = std::find_if(m_surfaces.begin(), m_surfaces.end(),
+			[&] (const auto& s) { return s.get() == &surface; });
+		if (it == m_surfaces.end())
+			throw MachineException(ILLEGAL_OPERATION, "Not an exported surface", surface.address());
+
+		if (surface.m_pinned) {
+			// Move the contents back into regular pages
+			surface.m_tracker.stop();
+			this->free_pages(surface.m_pbase, surface.m_plen);
+			this->memcpy(surface.m_pbase, surface.m_pages, surface.m_plen);
+		}
+		m_surfaces.erase(it);
+	}
+
+	template <int W>
+	void Memory<W>::surfaces_written(address_t addr, size_t len)
+	{
+		for (auto& surface : m_surfaces) {
+			if (surface->overlaps(addr, len))
+				surface->m_tracker.written();
+		}
+	}
+
+	INSTANTIATE_32_IF_ENABLED(MemorySurface);
+	INSTANTIATE_32_IF_ENABLED(Memory);
+	INSTANTIATE_64_IF_ENABLED(MemorySurface);
+	INSTANTIATE_64_IF_ENABLED(Memory);
+	INSTANTIATE_128_IF_ENABLED(MemorySurface);
+	INSTANTIATE_128_IF_ENABLED(Memory);
+} // riscv
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include "types.hpp"
+
+namespace riscv
+{
+	/// Write tracking for a range of host memory, used by MemorySurface.
+	/// While armed, the pages are write-protected on the host, and the first
+	/// write to each page takes a host fault that bumps the generation and
+	/// makes the page writable again. Only available on Linux. Elsewhere
+	/// every protect() counts as a write.
+	struct SurfaceWriteTracker
+	{
+		uintptr_t begin = 0;
+		uintptr_t end   = 0;
+		std::atomic<uint64_t> generation = 1;
+
+		void start(void* data, size_t len);
+		void stop();
+		// Write-protect the whole range
+		void protect();
+		// Writes from the host that cannot fault, eg. system calls
+		void written();
+		// The tracker that contains a host address, see install_host_fault_handler()
+		static SurfaceWriteTracker* find(uintptr_t addr) noexcept;
+	};
+
+	/// @brief A range of guest memory exported to the host, such as a
+	/// framebuffer or an audio ring buffer. The host reads the guest's
+	/// data in place through data(), and acquire() tells whether the guest
+	/// wrote to it since the last time. Presenting a frame needs no copy
+	/// and no system call.
+	///
+	/// In the flat arena data() points into the arena. Elsewhere the pages
+	/// are pinned to one contiguous host buffer for the life of the surface.
+	/// Writes are tracked per page, so writes to other data that shares the
+	/// first or last page also count.
+	/// See Memory::export_surface() and Memory::release_surface().
+	template <int W>
+	struct MemorySurface
+	{
+		using address_t = address_type<W>;
+
+		address_t address() const noexcept { return m_addr; }
+		size_t size() const noexcept { return m_size; }
+		/// @brief Host pointer to the guest range, stable for the life of the surface.
+		uint8_t* data() const noexcept { return m_data; }
+		template <typename T>
+		T* data_as() const noexcept { return (T *)m_data; }
+
+		/// @brief Increases when the guest writes to the surface.
+		uint64_t generation() const noexcept { return m_tracker.generation.load(std::memory_order_acquire); }
+		/// @brief Returns true if the guest wrote to the surface since the
+		/// last call (or since it was exported), and starts tracking again.
+		bool acquire();
+
+		bool overlaps(address_t addr, size_t len) const noexcept {
+			return addr < m_pbase + m_plen && addr + len > m_pbase;
+		}
+
+		MemorySurface(address_t addr, size_t size, address_t pbase, uint8_t* pages, size_t plen, bool pinned);
+		~MemorySurface();
+		MemorySurface(const MemorySurface&) = delete;
+		MemorySurface& operator=(const MemorySurface&) = delete;
+
+	private:
+		template <int> friend struct Memory;
+		const address_t m_addr;
+		const size_t    m_size;
+		const address_t m_pbase;
+		uint8_t* const  m_pages;
+		const size_t    m_plen;
+		uint8_t* const  m_data;
+		const bool      m_pinned; // m_pages is owned by the surface
+		uint64_t        m_acquired = 0;
+		SurfaceWriteTracker m_tracker;
+	};
+
+} // riscv
@@ -244,7 +244,7 @@ inline ArenaChunk* Arena::new_chunk(Args&&... args)
 {
 	if (UNLIKELY(m_free_chunks.empty())) {
 		if (m_chunks.size() >= this->m_max_chunks)
-			throw MachineException(INVALID_PROGRAM, "Too many arena chunks", this->m_max_chunks);
+			throw MachineException(RESOURCE_LIMIT_REACHED, "Too many arena chunks", this->m_max_chunks);
 
 		m_chunks.emplace_back(std::forward<Args>(args)...);
 		return &m_chunks.back();
@@ -131,6 +131,7 @@ template <int W>
 void Machine<W>::setup_native_heap(size_t sysnum, uint64_t base, size_t max_memory)
 {
 	m_arena.reset(new Arena(base, base + max_memory));
+	m_arena->set_max_chunks(m_limits.heap_chunks);
 
 	this->setup_native_heap_internal(sysnum);
 }
@@ -138,6 +139,7 @@ template <int W>
 void Machine<W>::transfer_arena_from(const Machine& other)
 {
 	m_arena.reset(new Arena(other.arena()));
+	m_arena->set_max_chunks(m_limits.heap_chunks);
 }
 
 template <int W>
@@ -1,5 +1,6 @@
 #pragma once
 #include "common.hpp"
+#include "landing_pad.hpp"
 #include "types.hpp"
 #include <cassert>
 #include <memory>
@@ -88,6 +89,8 @@ struct Page
 	Page() { m_page.reset(new PageData {}); };
 	// create a new possibly uninitialized page
 	Page(PageData::Initialization i) { m_page.reset(new PageData {i}); };
+	// take ownership of recycled page data
+	Page(std::unique_ptr<PageData> data) : m_page(std::move(data)) {}
 	// copy another page (or data)
 	Page(const PageAttributes& a, const PageData& d = {})
 		: attr(a), m_page(new PageData{d}) { attr.non_owning = false; }
@@ -203,6 +206,8 @@ inline void Page::new_data(PageData* data, bool data_owned)
 
 inline void Page::trap(uint32_t offset, int mode, int64_t value) const
 {
+	// Trap handlers are user code, which must not be jumped over
+	ScopedThrowingFaults throwing_faults;
 	this->m_trap((Page&) *this, offset, mode, value);
 }
 inline bool Page::set_trap(mmio_cb_t newtrap) const {
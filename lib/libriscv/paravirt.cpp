@@ -0,0 +1,205 @@
+#include "machine.hpp"
+
+#include "internal_common.hpp"
+#include <algorithm>
+#include <cerrno>
+
+namespace riscv {
+	static constexpr uint32_t PARAVIRT_CALL_PENALTY = 100u;
+
+template <int W>
+typename Machine<W>::ParavirtGuest& Machine<W>::paravirt_guest(int handle)
+{
+	if (UNLIKELY(handle < 0 || size_t(handle) >= m_paravirt.size() || m_paravirt[handle].machine == nullptr))
+		throw MachineException(ILLEGAL_OPERATION, "Invalid paravirtual machine handle", handle);
+	return m_paravirt[handle];
+}
+
+template <int W>
+size_t Machine<W>::paravirt_guests() const noexcept
+{
+	return std::count_if(m_paravirt.begin(), m_paravirt.end(),
+		[] (const auto& guest) { return guest.machine != nullptr; });
+}
+
+template <int W>
+machine_status Machine<W>::paravirt_run(Machine& guest, uint64_t counter, uint64_t max)
+{
+	// The guest machine runs on our remaining instruction budget
+	const uint64_t budget = (this->instruction_counter() < this->max_instructions())
+		? this->max_instructions() - this->instruction_counter() : 0;
+	const bool limited_by_us = max >= budget;
+	max = std::min({max, budget, UINT64_MAX - counter});
+
+	const auto status = guest.try_simulate(counter + max, counter);
+	this->increment_counter(guest.instruction_counter() - counter);
+	this->penalize(PARAVIRT_CALL_PENALTY);
+
+	if (status == MACHINE_TIMEOUT && limited_by_us) {
+		// Exhausting the guest machine exhausts us
+		this->set_instruction_counter(this->max_instructions());
+	}
+	auto& regs = this->cpu.registers();
+	regs.get(REG_ARG1) = (status == MACHINE_FAULT) ? guest.fault().type : 0;
+	regs.get(REG_ARG2) = (status == MACHINE_FAULT) ? guest.fault().data : 0;
+	return status;
+}
+
+template <int W>
+void Machine<W>::setup_paravirt_calls(size_t sysnum)
+{
+	install_syscall_handlers({
+	{sysnum + PV_PROBE, [] (Machine<W>& machine) {
+		machine.set_result(PARAVIRT_VERSION);
+	}},
+	{sysnum + PV_CREATE, [] (Machine<W>& machine) {
+		const auto [src, len, memory_max] =
+			machine.template sysargs<address_t, address_t, uint64_t> ();
+		const uint64_t our_max = machine.has_options() ? machine.options().memory_max : MachineOptions<W>{}.memory_max;
+		if (UNLIKELY(len == 0 || len > our_max || memory_max == 0 || memory_max > our_max)) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		// All delegated machines share our own memory budget
+		uint64_t delegated = 0;
+		for (const auto& guest : machine.m_paravirt)
+			if (guest.machine != nullptr) delegated += guest.memory_max;
+		if (UNLIKELY(memory_max > our_max - std::min(delegated, our_max))) {
+			machine.set_result(-ENOMEM);
+			return;
+		}
+		// Reuse a destroyed slot, or add a new one
+		auto it = std::find_if(machine.m_paravirt.begin(), machine.m_paravirt.end(),
+			[] (const auto& guest) { return guest.machine == nullptr; });
+		if (it == machine.m_paravirt.end()) {
+			if (machine.m_paravirt.size() >= PARAVIRT_MAX_GUESTS) {
+				machine.set_result(-EMFILE);
+				return;
+			}
+			it = machine.m_paravirt.emplace(machine.m_paravirt.end());
+		}
+		it->binary.resize(len);
+		machine.memory.memcpy_out(it->binary.data(), src, len);
+		machine.penalize(len / 64);
+
+		MachineOptions<W> options = machine.has_options() ? machine.options() : MachineOptions<W>{};
+		options.memory_max = memory_max;
+		try {
+			it->machine = std::make_unique<Machine<W>>(it->binary, options);
+			it->memory_max = memory_max;
+		} catch (const MachineException&) {
+			it->binary = {};
+			machine.set_result(-ENOEXEC);
+			return;
+		}
+		auto& guest = *it->machine;
+		guest.set_resource_limits(machine.resource_limits());
+		// Output from the guest machine is our output
+		guest.set_userdata(&machine);
+		guest.set_printer([] (const Machine<W>& guest, const char* buffer, size_t len) {
+			guest.template get_userdata<Machine<W>>()->print(buffer, len);
+		});
+		machine.set_result(it - machine.m_paravirt.begin());
+	}},
+	{sysnum + PV_SETUP_LINUX, [] (Machine<W>& machine) {
+		const auto [handle, argv, argv_len, envp, envp_len] =
+			machine.template sysargs<int, address_t, address_t, address_t, address_t> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+
+		auto split = [&machine] (address_t addr, address_t len) {
+			std::vector<std::string> result;
+			if (len == 0)
+				return result;
+			const std::string strings = machine.memory.membuffer(addr, len, 64 * 1024).to_string();
+			for (size_t start = 0; start < strings.size(); ) {
+				const size_t end = std::min(strings.find('\0', start), strings.size());
+				result.push_back(strings.substr(start, end - start));
+				start = end + 1;
+			}
+			return result;
+		};
+		const auto args = split(argv, argv_len);
+		const auto env = split(envp, envp_len);
+		try {
+			guest.setup_linux(args, env);
+		} catch (const MachineException&) {
+			machine.set_result(-ENOMEM);
+			return;
+		}
+		machine.set_result(0);
+	}},
+	{sysnum + PV_SIMULATE, [] (Machine<W>& machine) {
+		const auto [handle, max] = machine.template sysargs<int, uint64_t> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+		machine.set_result(machine.paravirt_run(guest, guest.instruction_counter(), max));
+	}},
+	{sysnum + PV_VMCALL, [] (Machine<W>& machine) {
+		const auto [handle, func, args, nargs, max] =
+			machine.template sysargs<int, address_t, address_t, unsigned, uint64_t> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+		if (UNLIKELY(nargs > PARAVIRT_MAX_ARGS)) {
+			machine.set_result(-EINVAL);
+			return;
+		}
+		address_t argv[PARAVIRT_MAX_ARGS];
+		machine.copy_from_guest(argv, args, nargs * sizeof(address_t));
+
+		guest.cpu.reset_stack_pointer();
+		guest.cpu.reg(REG_RA) = guest.memory.exit_address();
+		for (unsigned i = 0; i < nargs; i++)
+			guest.cpu.reg(REG_ARG0 + i) = argv[i];
+		guest.cpu.jump(func);
+		machine.set_result(machine.paravirt_run(guest, 0, max));
+	}},
+	{sysnum + PV_REG, [] (Machine<W>& machine) {
+		const auto [handle, index, value, write] =
+			machine.template sysargs<int, unsigned, address_t, int> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+		if (index < 32) {
+			if (write && index != 0)
+				guest.cpu.reg(index) = value;
+			machine.set_result(guest.cpu.reg(index));
+		} else if (index == 32) {
+			if (write)
+				guest.cpu.jump(value);
+			machine.set_result(guest.cpu.pc());
+		} else if (index == 33) {
+			if (write)
+				guest.set_instruction_counter(value);
+			machine.set_result(guest.instruction_counter());
+		} else {
+			machine.set_result(-EINVAL);
+		}
+	}},
+	{sysnum + PV_COPY, [] (Machine<W>& machine) {
+		const auto [handle, guest_addr, addr, len, to_guest] =
+			machine.template sysargs<int, address_t, address_t, address_t, int> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+		// Memory is copied directly between the two machines
+		if (to_guest)
+			guest.memory.memcpy(guest_addr, machine, addr, len);
+		else
+			machine.memory.memcpy(addr, guest, guest_addr, len);
+		machine.penalize(len / 64);
+		machine.set_result(0);
+	}},
+	{sysnum + PV_ADDRESS_OF, [] (Machine<W>& machine) {
+		const auto [handle, name, len] =
+			machine.template sysargs<int, address_t, address_t> ();
+		auto& guest = *machine.paravirt_guest(handle).machine;
+		const std::string symbol = machine.memory.membuffer(name, len, 4096).to_string();
+		machine.set_result(guest.address_of(symbol));
+	}},
+	{sysnum + PV_DESTROY, [] (Machine<W>& machine) {
+		const auto handle = machine.template sysarg<int>(0);
+		auto& slot = machine.paravirt_guest(handle);
+		slot.machine = nullptr;
+		slot.binary = {};
+		slot.memory_max = 0;
+		machine.set_result(0);
+	}}});
+}
+
+INSTANTIATE_32_IF_ENABLED(Machine);
+INSTANTIATE_64_IF_ENABLED(Machine);
+} // riscv
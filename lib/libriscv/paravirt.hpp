@@ -0,0 +1,158 @@
+#pragma once
+#include "types.hpp"
+#if defined(RISCV_PARAVIRT) && defined(__riscv)
+#include <string_view>
+#include <vector>
+#endif
+
+namespace riscv
+{
+	/// Paravirtualized nested machines
+	///
+	/// A guest that itself runs libriscv can delegate its machines to the
+	/// host, instead of interpreting them with an interpreted emulator. The
+	/// host installs the system calls with Machine::setup_paravirt_calls(),
+	/// and the guest library is built with RISCV_PARAVIRT, which provides
+	/// ParavirtMachine below. Delegated machines keep their memory in the
+	/// host, and data is copied directly between the two guests' memories.
+	///
+	/// System calls, relative to the base (a7). Handles are small integers:
+	///  +0: probe() -> PARAVIRT_VERSION
+	///  +1: create(binary, binary_len, memory_max) -> handle
+	///      The memory_max of all delegated machines together is limited
+	///      by the memory_max of the caller, or -ENOMEM is returned
+	///  +2: setup_linux(handle, argv, argv_len, envp, envp_len) -> 0
+	///      argv and envp are sequences of zero-terminated strings
+	///  +3: simulate(handle, max_instructions) -> machine_status
+	///      Resumes from the current PC and instruction counter
+	///  +4: vmcall(handle, func, args, nargs, max_instructions) -> machine_status
+	///      args is an array of up to 8 address-sized integers
+	///  +5: reg(handle, index, value, write) -> value
+	///      index 0-31 are the integer registers, 32 is PC and 33 is
+	///      the instruction counter. Writes if write != 0.
+	///  +6: copy(handle, machine_addr, addr, len, to_machine) -> 0
+	///      Copies between the delegated machine and the caller
+	///  +7: address_of(handle, name, name_len) -> address or 0
+	///  +8: destroy(handle) -> 0
+	/// simulate() and vmcall() return MACHINE_FAULT with the fault type in
+	/// a1 and the fault data in a2. Other errors are returned as -errno.
+	static constexpr int PARAVIRT_SYSCALLS_BASE = 501;
+	static constexpr int PARAVIRT_SYSCALLS = 9;
+	static constexpr int PARAVIRT_VERSION = 1;
+	static constexpr unsigned PARAVIRT_MAX_GUESTS = 64;
+	static constexpr unsigned PARAVIRT_MAX_ARGS = 8;
+
+	enum paravirt_call {
+		PV_PROBE = 0,
+		PV_CREATE,
+		PV_SETUP_LINUX,
+		PV_SIMULATE,
+		PV_VMCALL,
+		PV_REG,
+		PV_COPY,
+		PV_ADDRESS_OF,
+		PV_DESTROY,
+	};
+
+#if defined(RISCV_PARAVIRT) && defined(__riscv)
+	/// @brief A machine that is delegated to the paravirtualizing host.
+	/// Only available when libriscv is built for RISC-V with RISCV_PARAVIRT.
+	/// The API mirrors the subset of Machine that nested emulators need.
+	/// Methods return negative errno values when the host refuses a call.
+	struct ParavirtMachine
+	{
+		using address_t = unsigned long;
+
+		/// @brief Check if the host provides paravirtual machines.
+		static bool available() {
+			static const bool result = pvcall(PV_PROBE, 0).a0 == PARAVIRT_VERSION;
+			return result;
+		}
+
+		ParavirtMachine(std::string_view binary, uint64_t memory_max = 64ull << 20)
+			: m_handle(pvcall(PV_CREATE, (long)binary.data(), binary.size(), memory_max).a0) {}
+		~ParavirtMachine() { if (m_handle >= 0) pvcall(PV_DESTROY, m_handle); }
+		ParavirtMachine(const ParavirtMachine&) = delete;
+		ParavirtMachine& operator=(const ParavirtMachine&) = delete;
+
+		/// @brief True if the host created the machine.
+		bool valid() const noexcept { return m_handle >= 0; }
+
+		long setup_linux(const std::vector<std::string>& args, const std::vector<std::string>& env = {}) {
+			const auto argv = join(args);
+			const auto envp = join(env);
+			return pvcall(PV_SETUP_LINUX, m_handle, (long)argv.data(), argv.size(), (long)envp.data(), envp.size()).a0;
+		}
+
+		/// @brief Run until the machine stops, or max_instructions more
+		/// instructions have been executed. Can be resumed after a timeout.
+		machine_status simulate(uint64_t max_instructions = UINT64_MAX) {
+			return status(pvcall(PV_SIMULATE, m_handle, max_instructions));
+		}
+
+		/// @brief Call a function with up to 8 integer arguments.
+		/// The return value is available from return_value().
+		template <typename... Args>
+		machine_status vmcall(address_t func, Args... args) {
+			static_assert(sizeof...(Args) <= PARAVIRT_MAX_ARGS, "Too many arguments");
+			const long argv[] = { 0, (long)args... };
+			return status(pvcall(PV_VMCALL, m_handle, func, (long)&argv[1], sizeof...(Args), UINT64_MAX));
+		}
+
+		address_t reg(int index) const { return pvcall(PV_REG, m_handle, index, 0, 0).a0; }
+		void set_reg(int index, address_t value) { pvcall(PV_REG, m_handle, index, value, 1); }
+		address_t pc() const { return reg(32); }
+		uint64_t instruction_counter() const { return reg(33); }
+		address_t return_value() const { return reg(10); }
+
+		long copy_to_guest(address_t dst, const void* src, size_t len) {
+			return pvcall(PV_COPY, m_handle, dst, (long)src, len, 1).a0;
+		}
+		long copy_from_guest(void* dst, address_t src, size_t len) const {
+			return pvcall(PV_COPY, m_handle, src, (long)dst, len, 0).a0;
+		}
+		address_t address_of(std::string_view name) const {
+			return pvcall(PV_ADDRESS_OF, m_handle, (long)name.data(), name.size()).a0;
+		}
+
+		/// @brief The fault from the last simulate() or vmcall() that
+		/// returned MACHINE_FAULT. The message is not transferred.
+		const MachineFault& fault() const noexcept { return m_fault; }
+
+	private:
+		struct Result { long a0, a1, a2; };
+
+		machine_status status(Result res) {
+			if (res.a0 < 0) {
+				m_fault = { INVALID_PROGRAM, nullptr, uint64_t(-res.a0) };
+				return MACHINE_FAULT;
+			}
+			m_fault = { int(res.a1), nullptr, uint64_t(res.a2) };
+			return machine_status(res.a0);
+		}
+		static std::string join(const std::vector<std::string>& strings) {
+			std::string result;
+			for (const auto& str : strings) {
+				result += str;
+				result.push_back('\0');
+			}
+			return result;
+		}
+		static Result pvcall(long n, long a0, long a1 = 0, long a2 = 0, long a3 = 0, long a4 = 0) {
+			register long r0 asm("a0") = a0;
+			register long r1 asm("a1") = a1;
+			register long r2 asm("a2") = a2;
+			register long r3 asm("a3") = a3;
+			register long r4 asm("a4") = a4;
+			register long sysno asm("a7") = PARAVIRT_SYSCALLS_BASE + n;
+			asm volatile ("ecall" : "+r"(r0), "+r"(r1), "+r"(r2)
+				: "r"(r3), "r"(r4), "r"(sysno) : "memory");
+			return { r0, r1, r2 };
+		}
+
+		long m_handle;
+		MachineFault m_fault;
+	};
+#endif
+
+} // riscv
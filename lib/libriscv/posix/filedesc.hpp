@@ -1,8 +1,15 @@
 #pragma once
+#include <array>
 #include <functional>
 #include <string>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include "../landing_pad.hpp"
 #include "../types.hpp"
+#include "vfs.hpp"
 
 #if defined(__APPLE__) || defined(__LINUX__)
 #include <errno.h>
@@ -27,8 +34,13 @@ struct FileDescriptors
     real_fd_type translate(int vfd);
 	// Remove virtual FD and return real FD
     real_fd_type erase(int vfd);
+	// Close a real FD that is not (or no longer) assigned
+	static void close_real(real_fd_type fd, bool socket);
 
 	bool is_socket(int) const;
+	bool is_vfs(int vfd) const noexcept {
+		return vfd >= VFS_D_BASE && vfd < SOCKET_D_BASE;
+	}
 	bool permit_write(int vfd) {
 		if (is_socket(vfd)) return true;
 		else return proxy_mode;
@@ -38,14 +50,43 @@ struct FileDescriptors
 
     std::map<int, real_fd_type> translation;
 
+	// Open files and directories in the read-only virtual filesystem
+	struct VirtualFile {
+		const VirtualFileSystem::Entry* entry;
+		std::string path; // Normalized, for *at() calls on directories
+		uint64_t offset = 0;
+	};
+	int assign_vfs(const VirtualFileSystem::Entry* entry, std::string path) {
+		check_limit();
+		const int vfd = vfs_counter++;
+		vfs_files.emplace(vfd, VirtualFile{entry, std::move(path)});
+		return vfd;
+	}
+	VirtualFile* get_vfs(int vfd) {
+		auto it = vfs_files.find(vfd);
+		return (it != vfs_files.end()) ? &it->second : nullptr;
+	}
+	std::map<int, VirtualFile> vfs_files;
+	std::shared_ptr<VirtualFileSystem> vfs = nullptr;
+
 	// Default working directory (fake root)
 	std::string cwd = "/home";
 
 	static constexpr int FILE_D_BASE = 0x1000;
+	static constexpr int VFS_D_BASE = 0x20001000;
 	static constexpr int SOCKET_D_BASE = 0x40001000;
 	int file_counter = FILE_D_BASE;
+	int vfs_counter = VFS_D_BASE;
 	int socket_counter = SOCKET_D_BASE;
 
+	// Open files, sockets and virtual files (see ResourceLimits)
+	size_t open_count() const noexcept { return translation.size() + vfs_files.size(); }
+	uint32_t max_descriptors = UINT32_MAX;
+	void check_limit(size_t count = 1) const {
+		if (open_count() + count > max_descriptors)
+			FaultLandingPad::raise(RESOURCE_LIMIT_REACHED, "Too many open file descriptors", max_descriptors);
+	}
+
 	bool permit_filesystem = false;
 	bool permit_sockets = false;
 	bool proxy_mode = false;
@@ -54,10 +95,105 @@ struct FileDescriptors
 	std::function<bool(void*, std::string&)> filter_readlink = nullptr; /* NOTE: Can modify path */
 	std::function<bool(void*, const std::string&)> filter_stat = nullptr;
 	std::function<bool(void*, uint64_t)> filter_ioctl = nullptr;
+
+	// Optional cache of filter_open, filter_readlink and filter_stat
+	// decisions, keyed on the guest path. Denials and rewritten paths are
+	// cached too, so that a cached path never reaches the filter again.
+	// Only use it when the filters depend on nothing but the path, and
+	// call invalidate() when their answers change. Like the VFS, a cache
+	// can be shared between forks of a machine by assigning it to each.
+	struct FilterCache {
+		enum Filter : unsigned { OPEN, READLINK, STAT, FILTERS };
+
+		template <typename Func>
+		bool apply(Filter filter, std::string& path, Func&& func);
+		void invalidate();
+		size_t size() const;
+
+		size_t max_entries = 4096; // Per filter
+	private:
+		struct Entry {
+			bool allowed;
+			std::string path; // Rewritten path
+		};
+		std::array<std::unordered_map<std::string, Entry>, FILTERS> m_entries;
+		mutable std::shared_mutex m_mutex;
+	};
+	std::shared_ptr<FilterCache> filter_cache = nullptr;
+
+	// Apply the filters, through the filter cache when there is one
+	bool apply_filter_open(void* user, std::string& path);
+	bool apply_filter_readlink(void* user, std::string& path);
+	bool apply_filter_stat(void* user, const std::string& path);
 };
 
+template <typename Func>
+inline bool FileDescriptors::FilterCache::apply(Filter filter, std::string& path, Func&& func)
+{
+	auto& entries = m_entries[filter];
+	{
+		std::shared_lock lock(m_mutex);
+		auto it = entries.find(path);
+		if (it != entries.end()) {
+			if (it->second.allowed)
+				path = it->second.path;
+			return it->second.allowed;
+		}
+	}
+	std::string original = path;
+	const bool allowed = func(path);
+
+	std::unique_lock lock(m_mutex);
+	if (entries.size() < max_entries)
+		entries.try_emplace(std::move(original), Entry{allowed, allowed ? path : std::string()});
+	return allowed;
+}
+inline void FileDescriptors::FilterCache::invalidate()
+{
+	std::unique_lock lock(m_mutex);
+	for (auto& entries : m_entries)
+		entries.clear();
+}
+inline size_t FileDescriptors::FilterCache::size() const
+{
+	std::shared_lock lock(m_mutex);
+	size_t total = 0;
+	for (const auto& entries : m_entries)
+		total += entries.size();
+	return total;
+}
+
+inline bool FileDescriptors::apply_filter_open(void* user, std::string& path)
+{
+	if (filter_cache == nullptr)
+		return filter_open(user, path);
+	return filter_cache->apply(FilterCache::OPEN, path,
+		[&] (std::string& path) { return filter_open(user, path); });
+}
+inline bool FileDescriptors::apply_filter_readlink(void* user, std::string& path)
+{
+	if (filter_cache == nullptr)
+		return filter_readlink(user, path);
+	return filter_cache->apply(FilterCache::READLINK, path,
+		[&] (std::string& path) { return filter_readlink(user, path); });
+}
+inline bool FileDescriptors::apply_filter_stat(void* user, const std::string& path)
+{
+	if (filter_cache == nullptr)
+		return filter_stat(user, path);
+	std::string copy = path;
+	return filter_cache->apply(FilterCache::STAT, copy,
+		[&] (std::string& path) { return filter_stat(user, path); });
+}
+
 inline int FileDescriptors::assign(FileDescriptors::real_fd_type real_fd, bool socket)
 {
+	// Over the limit, the real fd was never handed out, so we close it
+	if (open_count() >= max_descriptors) {
+		close_real(real_fd, socket);
+		check_limit();
+	}
+
 	int virtfd;
 	if (!socket)
 		virtfd = file_counter++;
@@ -95,5 +95,8 @@ namespace riscv
 	FileDescriptors::~FileDescriptors()
 	{
 	}
+	void FileDescriptors::close_real(real_fd_type, bool)
+	{
+	}
 #endif
 } // riscv
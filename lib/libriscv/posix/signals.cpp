@@ -3,8 +3,47 @@
 #include "../machine.hpp"
 #include "../internal_common.hpp"
 #include "../threads.hpp"
+#include <cstddef>
+#include <cstring>
 
 namespace riscv {
+	static constexpr int LINUX_SI_KERNEL = 0x80;
+	static constexpr int LINUX_SI_TKILL  = -6;
+	static constexpr int LINUX_SS_ONSTACK = 1;
+	static constexpr int LINUX_SS_DISABLE = 2;
+	static constexpr int LINUX_SIG_BLOCK   = 0;
+	static constexpr int LINUX_SIG_UNBLOCK = 1;
+	static constexpr int LINUX_SIG_SETMASK = 2;
+	// SIGKILL and SIGSTOP cannot be blocked
+	static constexpr uint64_t UNBLOCKABLE = (uint64_t(1) << (9-1)) | (uint64_t(1) << (19-1));
+
+	// The Linux RISC-V signal frame: siginfo_t followed by ucontext_t
+	template <int W>
+	struct GuestSigframe {
+		using address_t = address_type<W>;
+		struct {
+			int32_t si_signo;
+			int32_t si_errno;
+			int32_t si_code;
+			uint8_t si_fields[128 - 12];
+		} info;
+		struct {
+			address_t uc_flags;
+			address_t uc_link;
+			address_t ss_sp;
+			int32_t   ss_flags;
+			address_t ss_size;
+			uint8_t   uc_sigmask[128];
+			// mcontext_t: pc followed by x1-x31, then the FP state
+			alignas(16) address_t gregs[32];
+			uint64_t  fpregs[32];
+			uint32_t  fcsr;
+			uint8_t   fp_reserved[528 - 260];
+		} uc;
+	};
+	static_assert(offsetof(GuestSigframe<4>, uc) == 128 && sizeof(GuestSigframe<4>::uc) == 816);
+	static_assert(offsetof(GuestSigframe<8>, uc) == 128 && sizeof(GuestSigframe<8>::uc) == 960);
+	static_assert(offsetof(GuestSigframe<8>, uc.gregs) == 128 + 176);
 
 template <int W>
 Signals<W>::Signals() {}
@@ -23,16 +62,187 @@ void Signals<W>::enter(Machine<W>& machine, int sig)
 {
 	if (sig == 0) return;
 
-	auto& sigact = signals.at(sig);
-	if (sigact.altstack) {
-		auto* thread = machine.threads().get_thread();
+	// We are mid-instruction (inside a system call), and jumping to the
+	// handler from here would rely on the dispatch adding 4 to the PC.
+	// Instead the signal is delivered once the system call has completed,
+	// where execution resumes exactly at the handler address.
+	auto& thread = per_thread(machine.gettid());
+	thread.pending |= uint64_t(1) << (sig-1);
+	thread.pending_tkill |= uint64_t(1) << (sig-1);
+	machine.request_signal_safepoint();
+}
+
+template <int W>
+void SignalPerThread<W>::drop_stale_frames(address_type<W> sp)
+{
+	const bool altstack = this->on_altstack(sp);
+	while (!sigret.empty() && sigret.back().altstack == altstack && sigret.back().frame < sp)
+		sigret.pop_back();
+}
+
+template <int W>
+void Signals<W>::setup_frame(Machine<W>& machine, int sig, int si_code, address_t resume_pc)
+{
+	auto& sigact = this->get(sig);
+	auto& thread = per_thread(machine.gettid());
+	auto& cpu = machine.cpu;
+	auto& regs = cpu.registers();
+
+	address_t sp = cpu.reg(REG_SP);
+	thread.drop_stale_frames(sp);
+	bool altstack = thread.on_altstack(sp);
+	if (sigact.altstack && thread.stack.ss_size != 0 && !altstack) {
 		// Change to alternate per-thread stack
-		auto& stack = per_thread(thread->tid).stack;
-		machine.cpu.reg(REG_SP) = stack.ss_sp + stack.ss_size;
+		sp = thread.stack.ss_sp + thread.stack.ss_size;
+		altstack = true;
+	}
+
+	// Write siginfo_t and ucontext_t below the stack pointer, so that
+	// SA_SIGINFO handlers can inspect and modify the interrupted context
+	const address_t frame = (sp - sizeof(GuestSigframe<W>)) & ~address_t(0xF);
+	GuestSigframe<W> sf {};
+	sf.info.si_signo = sig;
+	sf.info.si_code  = si_code;
+	sf.uc.ss_sp    = thread.stack.ss_sp;
+	sf.uc.ss_size  = thread.stack.ss_size;
+	sf.uc.ss_flags = (thread.stack.ss_size == 0) ? LINUX_SS_DISABLE : (altstack ? LINUX_SS_ONSTACK : 0);
+	std::memcpy(sf.uc.uc_sigmask, &thread.active, sizeof(thread.active));
+	sf.uc.gregs[0] = resume_pc;
+	for (unsigned i = 1; i < 32; i++)
+		sf.uc.gregs[i] = regs.get(i);
+	for (unsigned i = 0; i < 32; i++)
+		sf.uc.fpregs[i] = regs.getfl(i).i64;
+	sf.uc.fcsr = regs.fcsr().whole;
+	machine.memory.memcpy(frame, &sf, sizeof(sf));
+
+	// Save the full context, to be restored by rt_sigreturn
+	thread.sigret.push_back({regs, sig, frame, altstack});
+	thread.sigret.back().regs.pc = resume_pc;
+	thread.active |= (uint64_t(1) << (sig-1)) | (sigact.mask & ~UNBLOCKABLE);
+
+	cpu.reg(REG_SP) = frame;
+	cpu.reg(REG_ARG0) = sig;
+	cpu.reg(REG_ARG0+1) = frame + offsetof(GuestSigframe<W>, info);
+	cpu.reg(REG_ARG0+2) = frame + offsetof(GuestSigframe<W>, uc);
+	cpu.reg(REG_RA) = this->sigreturn_address(machine);
+	cpu.jump(sigact.handler);
+}
+
+template <int W>
+address_type<W> Signals<W>::sigreturn_address(Machine<W>& machine)
+{
+	if (m_sigreturn_address == 0x0) {
+		// The host code page has a rt_sigreturn trampoline after
+		// the STOP instruction. Map it in, like the exit function.
+		auto& mem = machine.memory;
+		const auto host_page = mem.mmap_allocate(Page::size());
+		mem.install_shared_page(mem.page_number(host_page), Page::host_page());
+		m_sigreturn_address = host_page + 8;
+	}
+	return m_sigreturn_address;
+}
+
+template <int W>
+void Signals<W>::queue(int tid, int sig)
+{
+	if (sig <= 0 || sig > int(signals.size()))
+		throw MachineException(ILLEGAL_OPERATION, "Invalid signal queued", sig);
+	per_thread(tid).pending |= uint64_t(1) << (sig-1);
+}
+
+template <int W>
+bool Signals<W>::has_pending(int tid) const
+{
+	auto it = m_per_thread.find(tid);
+	if (it == m_per_thread.end())
+		return false;
+	return (it->second.pending & ~it->second.active) != 0;
+}
+
+template <int W>
+bool Signals<W>::deliver_pending(Machine<W>& machine)
+{
+	auto& thread = per_thread(machine.gettid());
+	if (thread.returning)
+		this->restore_context(machine, thread);
+	while (const uint64_t deliverable = thread.pending & ~thread.active)
+	{
+		const int sig = __builtin_ctzll(deliverable) + 1;
+		const uint64_t bit = uint64_t(1) << (sig-1);
+		const int si_code = (thread.pending_tkill & bit) ? LINUX_SI_TKILL : LINUX_SI_KERNEL;
+		thread.pending &= ~bit;
+		thread.pending_tkill &= ~bit;
+		// Signals without a handler are ignored
+		if (this->get(sig).is_unset())
+			continue;
+		// We are at a safe point between instructions,
+		// so the current PC is where execution resumes.
+		this->setup_frame(machine, sig, si_code, machine.cpu.pc());
+		return true;
+	}
+	return false;
+}
+
+template <int W>
+bool Signals<W>::sigreturn(Machine<W>& machine)
+{
+	auto& thread = per_thread(machine.gettid());
+	thread.drop_stale_frames(machine.cpu.reg(REG_SP));
+	if (thread.sigret.empty())
+		return false;
+	// Restoring the PC from inside the system call would rely on the
+	// dispatch adding 4 to it. At the safe point it is restored exactly.
+	thread.returning = true;
+	machine.request_signal_safepoint();
+	return true;
+}
+
+template <int W>
+void Signals<W>::restore_context(Machine<W>& machine, SignalPerThread<W>& thread)
+{
+	thread.returning = false;
+	auto& frame = thread.sigret.back();
+	// The handler may have modified the context in the ucontext
+	GuestSigframe<W> sf;
+	machine.memory.memcpy_out(&sf.uc, frame.frame + offsetof(GuestSigframe<W>, uc), sizeof(sf.uc));
+
+	Registers<W> regs = frame.regs;
+	regs.pc = sf.uc.gregs[0];
+	for (unsigned i = 1; i < 32; i++)
+		regs.get(i) = sf.uc.gregs[i];
+	for (unsigned i = 0; i < 32; i++)
+		regs.getfl(i).i64 = sf.uc.fpregs[i];
+	regs.fcsr().whole = sf.uc.fcsr;
+
+	uint64_t mask;
+	std::memcpy(&mask, sf.uc.uc_sigmask, sizeof(mask));
+	thread.active = mask & ~UNBLOCKABLE;
+	machine.cpu.registers() = regs;
+	thread.sigret.pop_back();
+}
+
+template <int W>
+uint64_t Signals<W>::set_blocked(Machine<W>& machine, int how, uint64_t set)
+{
+	auto& thread = per_thread(machine.gettid());
+	const uint64_t old = thread.active;
+	set &= ~UNBLOCKABLE;
+	switch (how) {
+	case LINUX_SIG_BLOCK:
+		thread.active |= set;
+		break;
+	case LINUX_SIG_UNBLOCK:
+		thread.active &= ~set;
+		break;
+	case LINUX_SIG_SETMASK:
+		thread.active = set;
+		break;
+	default:
+		throw MachineException(ILLEGAL_OPERATION, "Invalid sigprocmask operation", how);
 	}
-	// We have to jump to handler-4 because we are mid-instruction
-	// WARNING: Assumption.
-	machine.cpu.jump(sigact.handler - 4);
+	// Eg. siglongjmp out of a handler restores the mask, and leaves its frame behind
+	thread.drop_stale_frames(machine.cpu.reg(REG_SP));
+	return old;
 }
 
 	INSTANTIATE_32_IF_ENABLED(Signals);
@@ -1,6 +1,7 @@
 #pragma once
-#include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 #include "../types.hpp"
 
 namespace riscv {
@@ -28,27 +29,72 @@ struct SignalAction {
 template <int W>
 struct SignalReturn {
 	Registers<W> regs;
+	int sig = 0;
+	// Guest address of the siginfo_t and ucontext_t frame
+	address_type<W> frame = 0x0;
+	bool altstack = false;
 };
 
 template <int W>
 struct SignalPerThread {
 	SignalStack<W> stack;
-	SignalReturn<W> sigret;
+	// Saved contexts of the signal handlers currently running,
+	// restored in LIFO order by rt_sigreturn.
+	std::vector<SignalReturn<W>> sigret;
+	// Queued signals not yet delivered, one bit per signal
+	uint64_t pending = 0x0;
+	// The pending signals that were sent by tkill or tgkill
+	uint64_t pending_tkill = 0x0;
+	// Blocked signals (the signal mask), which includes
+	// the signals whose handlers are currently running
+	uint64_t active  = 0x0;
+
+	bool on_altstack(address_type<W> sp) const noexcept {
+		return stack.ss_size != 0 && sp - stack.ss_sp <= stack.ss_size;
+	}
+	// Forget the frames of handlers that were left without
+	// rt_sigreturn (eg. siglongjmp), which are now above the stack
+	void drop_stale_frames(address_type<W> sp);
+	// rt_sigreturn was called, and the context is restored at the safe point
+	bool returning = false;
 };
 
 template <int W>
 struct Signals {
+	using address_t = address_type<W>;
+
 	SignalAction<W>& get(int sig);
+	// Synchronous delivery from inside a system call (eg. tkill), which
+	// enters the handler at the safe point right after the system call
 	void enter(Machine<W>&, int sig);
+	// Changes the signal mask of the current thread (rt_sigprocmask)
+	uint64_t set_blocked(Machine<W>&, int how, uint64_t set);
+	// Asynchronous delivery: Queue a signal for a thread, and
+	// deliver it at the next safe point (see Machine::queue_signal)
+	void queue(int tid, int sig);
+	bool has_pending(int tid) const;
+	// Completes rt_sigreturn, then delivers one pending signal
+	// to the current thread, if any
+	bool deliver_pending(Machine<W>&);
+	// Restores the context saved on signal delivery at the safe point
+	// right after the system call (rt_sigreturn)
+	bool sigreturn(Machine<W>&);
 
 	// TODO: Lock this in the future, for multiproessing
 	auto& per_thread(int tid) { return m_per_thread[tid]; }
+	// Forget the signal state of an exited thread
+	void erase_thread(int tid) { m_per_thread.erase(tid); }
 
 	Signals();
 	~Signals();
 private:
+	void setup_frame(Machine<W>&, int sig, int si_code, address_t resume_pc);
+	address_t sigreturn_address(Machine<W>&);
+	void restore_context(Machine<W>&, SignalPerThread<W>&);
+
 	std::array<SignalAction<W>, 64> signals {};
-	std::map<int, SignalPerThread<W>> m_per_thread;
+	std::unordered_map<int, SignalPerThread<W>> m_per_thread;
+	address_t m_sigreturn_address = 0x0;
 };
 
 } // riscv
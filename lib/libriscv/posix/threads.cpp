@@ -121,7 +121,7 @@ void Machine<W>::setup_posix_threads()
 				if (!thread->exit())
 					return;
 			} else {
-				// Jump to signal handler and change to altstack, if set
+				// Enter the signal handler after the system call, and change to altstack, if set
 				machine.signals().enter(machine, sig);
 				THPRINT(machine,
 					"<<< tgkill signal=%d jumping to 0x%lX (sp=0x%lX)\n",
@@ -0,0 +1,176 @@
+#include "vfs.hpp"
+#include <algorithm>
+
+namespace riscv {
+
+VirtualFileSystem::VirtualFileSystem()
+{
+	m_entries.push_back(std::make_unique<Entry>());
+	m_root = m_entries.back().get();
+	m_root->is_dir = true;
+	m_root->ino = 1;
+	m_root->parent = m_root;
+}
+
+std::string VirtualFileSystem::normalize(std::string_view base, std::string_view path)
+{
+	std::vector<std::string_view> parts;
+	auto split = [&parts] (std::string_view p) {
+		while (!p.empty()) {
+			const size_t next = p.find('/');
+			const auto part = p.substr(0, next);
+			if (part == "..") {
+				if (!parts.empty()) parts.pop_back();
+			} else if (!part.empty() && part != ".") {
+				parts.push_back(part);
+			}
+			if (next == std::string_view::npos) break;
+			p.remove_prefix(next + 1);
+		}
+	};
+	if (path.empty() || path[0] != '/')
+		split(base);
+	split(path);
+
+	if (parts.empty())
+		return "/";
+	// Join with a single allocation
+	size_t len = 0;
+	for (const auto part : parts)
+		len += 1 + part.size();
+	std::string result(len, '/');
+	char* out = result.data();
+	for (const auto part : parts)
+		out = std::copy(part.begin(), part.end(), out + 1);
+	return result;
+}
+
+VirtualFileSystem::Entry& VirtualFileSystem::create(std::string_view path, bool is_dir)
+{
+	const std::string normalized = normalize("/", path);
+	std::string_view p = normalized;
+	p.remove_prefix(1);
+
+	Entry* dir = m_root;
+	while (!p.empty()) {
+		const size_t next = p.find('/');
+		const auto name = p.substr(0, next);
+		const bool last = (next == std::string_view::npos);
+
+		auto it = dir->children.find(name);
+		if (it == dir->children.end()) {
+			m_entries.push_back(std::make_unique<Entry>());
+			Entry* entry = m_entries.back().get();
+			entry->parent = dir;
+			entry->ino = m_entries.size();
+			entry->is_dir = !last || is_dir;
+			it = dir->children.emplace(std::string(name), entry).first;
+		} else if (!it->second->is_dir && !last) {
+			throw MachineException(INVALID_PROGRAM,
+				"VFS: Path component is not a directory");
+		}
+		dir = it->second;
+		if (last) break;
+		p.remove_prefix(next + 1);
+	}
+	if (dir->is_dir != is_dir)
+		throw MachineException(INVALID_PROGRAM,
+			"VFS: Path already exists with a different type");
+	return *dir;
+}
+
+VirtualFileSystem::Entry& VirtualFileSystem::add_file(std::string_view path, std::string_view contents)
+{
+	Entry& entry = create(path, false);
+	entry.data = contents;
+	return entry;
+}
+
+VirtualFileSystem::Entry& VirtualFileSystem::add_file(std::string_view path, std::vector<char> contents)
+{
+	// Moving a vector keeps its buffer, so the view stays valid
+	m_owned.push_back(std::move(contents));
+	const auto& owned = m_owned.back();
+	return add_file(path, std::string_view(owned.data(), owned.size()));
+}
+
+VirtualFileSystem::Entry& VirtualFileSystem::add_directory(std::string_view path)
+{
+	return create(path, true);
+}
+
+size_t VirtualFileSystem::load_tar(std::string_view archive)
+{
+	static constexpr size_t BLOCK = 512;
+	auto field = [] (const char* p, size_t maxlen) {
+		size_t len = 0;
+		while (len < maxlen && p[len] != 0) len++;
+		return std::string_view(p, len);
+	};
+
+	size_t count = 0;
+	size_t offset = 0;
+	while (offset + BLOCK <= archive.size())
+	{
+		const char* hdr = archive.data() + offset;
+		// Two zero blocks end the archive, but one is enough for us
+		if (hdr[0] == 0)
+			break;
+
+		uint64_t size = 0;
+		for (const char c : field(hdr + 124, 12)) {
+			if (c < '0' || c > '7') break;
+			size = size * 8 + (c - '0');
+		}
+		const size_t data_offset = offset + BLOCK;
+		if (size > archive.size() - data_offset)
+			throw MachineException(INVALID_PROGRAM, "VFS: Truncated tar archive");
+
+		std::string name;
+		if (field(hdr + 257, 6) == "ustar") {
+			const auto prefix = field(hdr + 345, 155);
+			if (!prefix.empty()) {
+				name = prefix;
+				name += '/';
+			}
+		}
+		name += field(hdr, 100);
+
+		const char type = hdr[156];
+		if (type == '0' || type == '\0') {
+			add_file(name, archive.substr(data_offset, size));
+			count++;
+		} else if (type == '5') {
+			add_directory(name);
+			count++;
+		}
+		offset = data_offset + (size + BLOCK - 1) / BLOCK * BLOCK;
+	}
+	return count;
+}
+
+const VirtualFileSystem::Entry* VirtualFileSystem::lookup(std::string_view path) const
+{
+	if (path.empty() || path[0] != '/')
+		return nullptr;
+	path.remove_prefix(1);
+
+	const Entry* entry = m_root;
+	while (!path.empty()) {
+		const size_t next = path.find('/');
+		const auto name = path.substr(0, next);
+		if (!name.empty()) {
+			if (!entry->is_dir)
+				return nullptr;
+			auto it = entry->children.find(name);
+			if (it == entry->children.end())
+				return nullptr;
+			entry = it->second;
+		}
+		if (next == std::string_view::npos) break;
+		path.remove_prefix(next + 1);
+	}
+	return entry;
+}
+
+} // riscv
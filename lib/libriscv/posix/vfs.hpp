@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../types.hpp"
+
+namespace riscv {
+
+/// @brief A read-only in-memory filesystem presented to the guest through
+/// the regular file system calls (openat, read, pread64, lseek, fstat,
+/// fstatat, getdents64 and mmap). File contents are never copied into the
+/// VFS: borrowed buffers must outlive it. Lookups happen before the
+/// host filesystem is consulted, and do not require permit_filesystem.
+struct VirtualFileSystem
+{
+	struct Entry {
+		std::string_view data; // File contents (empty for directories)
+		std::map<std::string, Entry*, std::less<>> children;
+		Entry* parent = nullptr;
+		uint64_t ino = 0;
+		bool is_dir = false;
+
+		uint64_t size() const noexcept { return data.size(); }
+	};
+
+	/// @brief Add a file with borrowed contents. Missing parent
+	/// directories are created. An existing file is replaced.
+	Entry& add_file(std::string_view path, std::string_view contents);
+	/// @brief Add a file whose contents are owned by the VFS.
+	Entry& add_file(std::string_view path, std::vector<char> contents);
+	/// @brief Add a directory, and any missing parent directories.
+	Entry& add_directory(std::string_view path);
+
+	/// @brief Add every regular file and directory in a ustar archive.
+	/// File contents are borrowed from the archive, which must outlive
+	/// the VFS. Other entry types (links, devices) are skipped.
+	/// @return The number of entries added.
+	size_t load_tar(std::string_view archive);
+
+	/// @brief Find an entry by absolute path. Returns nullptr if not found.
+	const Entry* lookup(std::string_view path) const;
+	const Entry& root() const noexcept { return *m_root; }
+
+	/// @brief Resolve path relative to base, collapsing "." and ".."
+	/// and repeated slashes. The result is always absolute.
+	static std::string normalize(std::string_view base, std::string_view path);
+
+	VirtualFileSystem();
+
+private:
+	Entry& create(std::string_view path, bool is_dir);
+	Entry* m_root = nullptr;
+	std::vector<std::unique_ptr<Entry>> m_entries;
+	std::vector<std::vector<char>> m_owned;
+};
+
+} // riscv
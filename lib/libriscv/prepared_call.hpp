@@ -200,7 +200,7 @@ namespace riscv
 				}
 				else if (results.counter >= max) {
 					[[unlikely]];
-					throw MachineTimeoutException(MAX_INSTRUCTIONS_REACHED,
+					FaultLandingPad::raise(MAX_INSTRUCTIONS_REACHED,
 						"PreparedCall: execution timeout", max);
 				}
 				// Continue with normal simulation
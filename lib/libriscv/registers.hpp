@@ -85,6 +85,9 @@ namespace riscv
 		RISCV_ALWAYS_INLINE register_t& get(uint32_t idx) noexcept { return m_reg[idx]; }
 		RISCV_ALWAYS_INLINE const register_t& get(uint32_t idx) const noexcept { return m_reg[idx]; }
 
+		RISCV_ALWAYS_INLINE auto& getfl() noexcept { return m_regfl; }
+		RISCV_ALWAYS_INLINE const auto& getfl() const noexcept { return m_regfl; }
+
 		RISCV_ALWAYS_INLINE fp64reg& getfl(uint32_t idx) noexcept { return m_regfl[idx]; }
 		RISCV_ALWAYS_INLINE const fp64reg& getfl(uint32_t idx) const noexcept { return m_regfl[idx]; }
 
@@ -92,17 +95,27 @@ namespace riscv
 		const register_t& at(uint32_t idx) const { return m_reg.at(idx); }
 
 		FCSR& fcsr() noexcept { return m_fcsr; }
+		FCSR fcsr() const noexcept { return m_fcsr; }
 
 		std::string to_string() const;
 		std::string flp_to_string() const;
 
 #ifdef RISCV_EXT_VECTOR
-		auto& rvv() noexcept {
-			return m_rvv;
+		/// @brief Access the vector register file. It is allocated
+		/// on first use, after which it is saved and copied along
+		/// with the rest of the registers.
+		VectorRegisters<W>& rvv() {
+			if (UNLIKELY(m_rvv == nullptr))
+				m_rvv = std::make_unique<VectorRegisters<W>>();
+			return *m_rvv;
 		}
-		const auto& rvv() const noexcept {
-			return m_rvv;
+		const VectorRegisters<W>& rvv() const {
+			static const VectorRegisters<W> unused_vectors {};
+			return (m_rvv != nullptr) ? *m_rvv : unused_vectors;
 		}
+		bool has_vector_state() const noexcept { return m_rvv != nullptr; }
+#else
+		bool has_vector_state() const noexcept { return false; }
 #endif
 		bool has_vectors() const noexcept { return vector_extension; }
 
@@ -111,7 +124,8 @@ namespace riscv
 			: pc    { other.pc }, m_reg { other.m_reg }, m_fcsr { other.m_fcsr }, m_regfl { other.m_regfl }
 		{
 #ifdef RISCV_EXT_VECTOR
-			m_rvv = other.m_rvv;
+			if (other.m_rvv != nullptr)
+				m_rvv = std::make_unique<VectorRegisters<W>>(*other.m_rvv);
 #endif
 		}
 		enum class Options { Everything, NoVectors };
@@ -127,7 +141,13 @@ namespace riscv
 			this->m_regfl = other.m_regfl;
 #ifdef RISCV_EXT_VECTOR
 			if (opts == Options::Everything) {
-				m_rvv = other.m_rvv;
+				// Scalar-only register files carry no vector state
+				if (other.m_rvv == nullptr)
+					m_rvv = nullptr;
+				else if (m_rvv != nullptr)
+					*m_rvv = *other.m_rvv;
+				else
+					m_rvv = std::make_unique<VectorRegisters<W>>(*other.m_rvv);
 			}
 #endif
 			(void)opts;
@@ -142,7 +162,8 @@ namespace riscv
 		// General FP registers
 		std::array<fp64reg, 32> m_regfl {};
 #ifdef RISCV_EXT_VECTOR
-		VectorRegisters<W> m_rvv;
+		// Lazily allocated vector register file
+		std::unique_ptr<VectorRegisters<W>> m_rvv;
 #endif
 	};
 
@@ -1,5 +1,8 @@
 #pragma once
 #include <cstdint>
+#if __has_include(<atomic>)
+#include <atomic>
+#endif
 #include "types.hpp"
 
 namespace riscv
@@ -17,6 +20,10 @@ namespace riscv
 			m_reservation = addr;
 			return true;
 		}
+		// The value observed by the most recent LR, so that SC can detect
+		// stores from other machines sharing the same memory (which never
+		// see our reservation).
+		void set_reserved_value(address_t value) noexcept { m_reserved_value = value; }
 
 		// Volume I: RISC-V Unprivileged ISA V20190608 p.49:
 		// An SC can only pair with the most recent LR in program order.
@@ -32,6 +39,48 @@ namespace riscv
 			return result;
 		}
 
+		// Completes a successful SC: Stores the value only if the memory
+		// still holds the value observed by LR, atomically with respect to
+		// other host threads.
+		template <typename T>
+		bool compare_and_store(T& mem, T value) noexcept
+		{
+			T expected = T(m_reserved_value);
+#ifdef __cpp_lib_atomic_ref
+			if constexpr (sizeof(T) <= 8) {
+				return std::atomic_ref(mem).compare_exchange_strong(expected, value);
+			}
+#endif
+			if (mem != expected)
+				return false;
+			mem = value;
+			return true;
+		}
+
+		// Read-modify-write operations for the AMO fast-paths
+		template <typename T>
+		static T fetch_add(T& mem, T value) noexcept
+		{
+#ifdef __cpp_lib_atomic_ref
+			return std::atomic_ref(mem).fetch_add(value);
+#else
+			const T old_value = mem;
+			mem += value;
+			return old_value;
+#endif
+		}
+		template <typename T>
+		static T exchange(T& mem, T value) noexcept
+		{
+#ifdef __cpp_lib_atomic_ref
+			return std::atomic_ref(mem).exchange(value);
+#else
+			const T old_value = mem;
+			mem = value;
+			return old_value;
+#endif
+		}
+
 	private:
 		inline bool check_alignment(int size, address_t addr) RISCV_INTERNAL
 		{
@@ -39,5 +88,6 @@ namespace riscv
 		}
 
 		address_t m_reservation = 0x0;
+		address_t m_reserved_value = 0x0;
 	};
 }
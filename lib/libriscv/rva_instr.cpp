@@ -333,6 +333,7 @@ namespace riscv
 		else {
 			cpu.trigger_exception(ILLEGAL_OPCODE);
 		}
+		cpu.atomics().set_reserved_value(value);
 		if (instr.Atype.rd != 0)
 			cpu.reg(instr.Atype.rd) = value;
 	},
@@ -353,7 +354,8 @@ namespace riscv
 		{
 			resv = cpu.atomics().store_conditional(4, addr);
 			if (resv) {
-				cpu.machine().memory.template write<uint32_t> (addr, cpu.reg(instr.Atype.rs2));
+				auto& mem = cpu.machine().memory.template writable_read<uint32_t> (addr);
+				resv = cpu.atomics().compare_and_store(mem, uint32_t(cpu.reg(instr.Atype.rs2)));
 			}
 		}
 		else if (instr.Atype.funct3 == AMOSIZE_D)
@@ -361,7 +363,8 @@ namespace riscv
 			if constexpr (RVISGE64BIT(cpu)) {
 				resv = cpu.atomics().store_conditional(8, addr);
 				if (resv) {
-					cpu.machine().memory.template write<uint64_t> (addr, cpu.reg(instr.Atype.rs2));
+					auto& mem = cpu.machine().memory.template writable_read<uint64_t> (addr);
+					resv = cpu.atomics().compare_and_store(mem, uint64_t(cpu.reg(instr.Atype.rs2)));
 				}
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
@@ -371,7 +374,8 @@ namespace riscv
 			if constexpr (RVIS128BIT(cpu)) {
 				resv = cpu.atomics().store_conditional(16, addr);
 				if (resv) {
-					cpu.machine().memory.template write<RVREGTYPE(cpu)> (addr, cpu.reg(instr.Atype.rs2));
+					auto& mem = cpu.machine().memory.template writable_read<RVREGTYPE(cpu)> (addr);
+					resv = cpu.atomics().compare_and_store(mem, RVREGTYPE(cpu)(cpu.reg(instr.Atype.rs2)));
 				}
 			} else
 				cpu.trigger_exception(ILLEGAL_OPCODE);
@@ -532,18 +532,28 @@ namespace riscv
 		auto& dst = cpu.reg(fi.R4type.rd);
 		switch (fi.R4type.funct2) {
 		case 0x0: // from float32
-			if (fi.R4type.rs2 == 0x0)
+			switch (fi.R4type.rs2) {
+			case 0x0: // FCVT.W.S
 				dst = (int32_t) rs1.f32[0];
-			else
-				dst = (uint32_t) rs1.f32[0];
-			return;
+				return;
+			case 0x1: // FCVT.WU.S (sign-extended)
+				dst = (RVSIGNTYPE(cpu))(int32_t)(uint32_t) rs1.f32[0];
+				return;
+			case 0x2: // FCVT.L.S
+				dst = (int64_t) rs1.f32[0];
+				return;
+			case 0x3: // FCVT.LU.S
+				dst = (uint64_t) rs1.f32[0];
+				return;
+			}
+			break;
 		case 0x1: // from float64
 			switch (fi.R4type.rs2) {
 			case 0x0: // FCVT.W.D
 				dst = (int32_t) rs1.f64;
 				return;
-			case 0x1: // FCVT.WU.D
-				dst = (uint32_t) rs1.f64;
+			case 0x1: // FCVT.WU.D (sign-extended)
+				dst = (RVSIGNTYPE(cpu))(int32_t)(uint32_t) rs1.f64;
 				return;
 			case 0x2: // FCVT.L.D
 				dst = (int64_t) rs1.f64;
@@ -573,11 +583,21 @@ namespace riscv
 		auto& dst = cpu.registers().getfl(fi.R4type.rd);
 		switch (fi.R4type.funct2) {
 		case 0x0: // to float32
-			if (fi.R4type.rs2 == 0x0)
-				dst.set_float((RVSIGNTYPE(cpu)) rs1);
-			else
+			switch (fi.R4type.rs2) {
+			case 0x0: // FCVT.S.W
+				dst.set_float((int32_t)rs1);
+				return;
+			case 0x1: // FCVT.S.WU
+				dst.set_float((uint32_t)rs1);
+				return;
+			case 0x2: // FCVT.S.L
+				dst.set_float((RVSIGNTYPE(cpu))rs1);
+				return;
+			case 0x3: // FCVT.S.LU
 				dst.set_float(rs1);
-			return;
+				return;
+			}
+			break;
 		case 0x1: // to float64
 			switch (fi.R4type.rs2) {
 			case 0x0: // FCVT.D.W
@@ -1,6 +1,9 @@
 #include <libriscv/machine.hpp>
 
 #include "internal_common.hpp"
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #ifdef __GNUG__
 #define RISCV_PACKED __attribute__((packed))
 #else
@@ -9,7 +12,7 @@
 
 namespace riscv
 {
-	static const uint64_t MAGiC_V4LUE = 0x9c36ab9301aed873;
+	static const uint64_t MAGiC_V4LUE = 0x9c36ab9301aed875;
 	template <int W>
 	struct SerializedMachine
 	{
@@ -22,27 +25,53 @@ namespace riscv
 		uint16_t page_size;
 		uint16_t attr_size;
 		uint16_t serp_size;
-		uint16_t reserved;
+		uint16_t vector_size; // Vector register file at cpu_offset, if used
 		uint16_t cpu_offset;
 		uint32_t mem_offset;
 
-		Registers<W> registers;
-		uint64_t     counter;
+		address_t pc;
+		std::array<register_type<W>, 32> regs;
+		std::array<fp64reg, 32> fregs;
+		uint32_t  fcsr;
+		uint64_t  counter;
 
 		address_t start_address = 0;
 		address_t stack_address = 0;
 		address_t mmap_address  = 0;
 		address_t heap_address  = 0;
 		address_t exit_address  = 0;
+		address_t arena_read_boundary  = 0;
+		address_t arena_write_boundary = 0;
 	};
 	struct SerializedPage
 	{
 		uint64_t addr;
 		PageAttributes attr;
 		bool is_cow_page = false;
-		uint8_t padding[3] {0};
+		// Flat arena page without a page table entry
+		bool is_arena_page = false;
+		uint8_t padding[2] {0};
 	} RISCV_PACKED;
 
+	static bool is_zeroed_page(const void* arena, uint64_t pageno)
+	{
+		const auto* data = (const uint64_t *)((const uint8_t *)arena + pageno * Page::size());
+		for (size_t i = 0; i < Page::size() / sizeof(uint64_t); i++)
+			if (data[i] != 0) return false;
+		return true;
+	}
+
+	template <int W>
+	static uint16_t serialized_vector_size(const Registers<W>& regs)
+	{
+#ifdef RISCV_EXT_VECTOR
+		if (regs.has_vector_state())
+			return sizeof(VectorRegisters<W>);
+#endif
+		(void)regs;
+		return 0;
+	}
+
 	template <int W>
 	size_t Machine<W>::serialize_to(std::vector<uint8_t>& vec) const
 	{
@@ -52,48 +81,65 @@ namespace riscv
 		for (const auto& it : memory.pages()) {
 			if (!it.second.is_cow_page()) datapage_count++;
 		}
+		const auto arena_pages = memory.touched_arena_pages();
+		for (const address_t pageno : arena_pages) {
+			if (!is_zeroed_page(memory.memory_arena_ptr(), pageno)) datapage_count++;
+		}
+
+		const auto& regs = cpu.registers();
+		const uint16_t vector_size = serialized_vector_size(regs);
 
 		const SerializedMachine<W> header {
 			.magic    = MAGiC_V4LUE,
-			.n_pages  = (unsigned) memory.pages().size(),
+			.n_pages  = (unsigned) (memory.pages().size() + arena_pages.size()),
 			.n_datapages = datapage_count,
 			.reg_size = sizeof(Registers<W>),
 			.page_size = Page::size(),
 			.attr_size = sizeof(PageAttributes),
 			.serp_size = sizeof(SerializedPage),
-			.reserved = 0,
+			.vector_size = vector_size,
 			.cpu_offset = sizeof(SerializedMachine<W>),
-			.mem_offset = sizeof(SerializedMachine<W>) + 0x0,
+			.mem_offset = uint32_t(sizeof(SerializedMachine<W>) + vector_size),
 
-			.registers = cpu.registers(),
-			.counter   = this->instruction_counter(),
+			.pc      = regs.pc,
+			.regs    = regs.get(),
+			.fregs   = regs.getfl(),
+			.fcsr    = regs.fcsr().whole,
+			.counter = this->instruction_counter(),
 
 			.start_address = memory.start_address(),
 			.stack_address = memory.stack_initial(),
 			.mmap_address  = memory.mmap_address(),
 			.heap_address  = memory.heap_address(),
 			.exit_address  = memory.exit_address(),
+			.arena_read_boundary  = memory.memory_arena_read_boundary(),
+			.arena_write_boundary = memory.memory_arena_write_boundary(),
 		};
 		const auto* hptr = (const uint8_t*) &header;
 		vec.insert(vec.end(), hptr, hptr + sizeof(header));
 		this->cpu.serialize_to(vec);
-		this->memory.serialize_to(vec);
+		this->memory.serialize_to(vec, arena_pages);
 
 		const size_t after = vec.size();
 		return after - before;
 	}
 	template <int W>
-	void CPU<W>::serialize_to(std::vector<uint8_t>& /* vec */) const
+	void CPU<W>::serialize_to(std::vector<uint8_t>& vec) const
 	{
+#ifdef RISCV_EXT_VECTOR
+		// Vector registers are only stored once the guest has used them
+		if (registers().has_vector_state()) {
+			const auto* vptr = (const uint8_t*) &registers().rvv();
+			vec.insert(vec.end(), vptr, vptr + sizeof(VectorRegisters<W>));
+		}
+#else
+		(void)vec;
+#endif
 	}
 	template <int W>
-	size_t Memory<W>::serialize_to(std::vector<uint8_t>& vec) const
+	size_t Memory<W>::serialize_to(std::vector<uint8_t>& vec, const std::vector<address_t>& arena_pages) const
 	{
 		const size_t before = vec.size();
-		if (this->m_arena.pages > 0 && riscv::flat_readwrite_arena) {
-			throw MachineException(
-				FEATURE_DISABLED, "Serialize is incompatible with flat read-write arena");
-		}
 
 		const size_t est_page_bytes =
 			this->m_pages.size() * (sizeof(SerializedPage) + sizeof(PageData));
@@ -125,10 +171,54 @@ namespace riscv
 			vec.insert(vec.end(), page.data(), page.data() + sizeof(PageData));
 		}
 
+		for (const address_t pageno : arena_pages)
+		{
+			const auto& data = this->m_arena.data[pageno];
+			SerializedPage spage {
+				.addr = static_cast<uint64_t>(pageno),
+				.attr = {},
+				.is_cow_page = is_zeroed_page(this->m_arena.data, pageno),
+				.is_arena_page = true,
+			};
+			auto* sptr = (const uint8_t*) &spage;
+			vec.insert(vec.end(), sptr, sptr + sizeof(SerializedPage));
+
+			if (!spage.is_cow_page)
+				vec.insert(vec.end(), data.buffer8.data(), data.buffer8.data() + sizeof(PageData));
+		}
+
 		const size_t after = vec.size();
 		return after - before;
 	}
 
+	template <int W>
+	std::vector<address_type<W>> Memory<W>::touched_arena_pages() const
+	{
+		std::vector<address_t> result;
+		// The flat arena is accessed without page table entries, so
+		// we have to find the pages that were touched ourselves.
+		if (this->m_arena.pages == 0 || !riscv::flat_readwrite_arena)
+			return result;
+#ifdef __linux__
+		// Pages that were never accessed are not resident
+		std::vector<unsigned char> residency(this->m_arena.pages);
+		if (mincore(this->m_arena.data, this->m_arena.pages * Page::size(), residency.data()) < 0) {
+			throw MachineException(
+				FEATURE_DISABLED, "Serialize was unable to inspect the flat read-write arena");
+		}
+		for (address_t pageno = 0; pageno < this->m_arena.pages; pageno++)
+		{
+			// Pages with page table entries are serialized with their attributes
+			if ((residency[pageno] & 1) && m_pages.count(pageno) == 0)
+				result.push_back(pageno);
+		}
+#else
+		throw MachineException(
+			FEATURE_DISABLED, "Serialize is incompatible with flat read-write arena");
+#endif
+		return result;
+	}
+
 	template <int W>
 	int Machine<W>::deserialize_from(const std::vector<uint8_t>& vec)
 	{
@@ -140,12 +230,26 @@ namespace riscv
 			return -1;
 		if (header.reg_size != sizeof(Registers<W>))
 			return -2;
+#ifdef RISCV_EXT_VECTOR
+		if (header.vector_size != 0 && header.vector_size != sizeof(VectorRegisters<W>))
+			return -2;
+#else
+		if (header.vector_size != 0)
+			return -2;
+#endif
+		if (vec.size() < size_t(header.cpu_offset) + header.vector_size
+			|| header.mem_offset < size_t(header.cpu_offset) + header.vector_size)
+			return -1;
 		if (header.page_size != Page::size())
 			return -3;
 		if (header.attr_size != sizeof(PageAttributes))
 			return -4;
 		if (header.serp_size != sizeof(SerializedPage))
 			return -5;
+		// Forks share the arena of their master, which would be overwritten
+		if (memory.is_forked() && memory.uses_flat_memory_arena())
+			throw MachineException(FEATURE_DISABLED,
+				"Deserialize is incompatible with forked machines sharing an arena");
 		this->m_counter = header.counter;
 		this->m_max_counter = 0;
 		cpu.deserialize_from(vec, header);
@@ -153,11 +257,21 @@ namespace riscv
 		return 0;
 	}
 	template <int W>
-	void CPU<W>::deserialize_from(const std::vector<uint8_t>& /* vec */,
+	void CPU<W>::deserialize_from(const std::vector<uint8_t>& vec,
 					const SerializedMachine<W>& state)
 	{
 		// restore CPU registers and counters
-		this->m_regs = state.registers;
+		this->m_regs = {};
+		this->m_regs.pc = state.pc;
+		this->m_regs.get() = state.regs;
+		this->m_regs.getfl() = state.fregs;
+		this->m_regs.fcsr().whole = state.fcsr;
+#ifdef RISCV_EXT_VECTOR
+		if (state.vector_size != 0)
+			std::memcpy(&this->m_regs.rvv(), &vec[state.cpu_offset], state.vector_size);
+#else
+		(void)vec;
+#endif
 		this->m_cache = {};
 	}
 	template <int W>
@@ -169,6 +283,10 @@ namespace riscv
 		this->m_mmap_address  = state.mmap_address;
 		this->m_heap_address  = state.heap_address;
 		this->m_exit_address  = state.exit_address;
+		if (this->uses_flat_memory_arena()) {
+			this->m_arena.read_boundary  = state.arena_read_boundary;
+			this->m_arena.write_boundary = state.arena_write_boundary;
+		}
 
 #ifdef RISCV_EXT_ATOMICS
 		this->m_atomics = {};
@@ -185,6 +303,9 @@ namespace riscv
 		// all pages will be completely replaced
 		this->clear_all_pages();
 		this->evict_execute_segments();
+		// Arena pages that are missing from the state were zero when it
+		// was taken, so nothing from before the restore may remain there
+		this->zero_arena_pages(0, this->m_arena.pages, true);
 
 		size_t off = state.mem_offset;
 		for (size_t p = 0; p < state.n_pages; p++)
@@ -193,6 +314,19 @@ namespace riscv
 			off += sizeof(SerializedPage);
 
 			PageAttributes new_attr = page.attr;
+			// Flat arena pages without page table entries
+			if (page.is_arena_page) {
+				if (page.addr >= this->m_arena.pages)
+					throw MachineException(INVALID_PROGRAM, "Serialized arena page was outside of arena");
+				auto* dst = this->m_arena.data[page.addr].buffer8.data();
+				if (page.is_cow_page) {
+					std::memset(dst, 0, sizeof(PageData));
+				} else {
+					std::copy(&vec[off], &vec[off] + sizeof(PageData), dst);
+					off += sizeof(PageData);
+				}
+				continue;
+			}
 			// Pages with data
 			if (!page.is_cow_page) {
 				Page* new_page = nullptr;
@@ -227,6 +361,7 @@ namespace riscv
 				);
 			}
 		}
+		this->recount_owned_pages();
 		// page tables have been changed
 		this->invalidate_reset_cache();
 	}
@@ -5,6 +5,7 @@
 #include "threaded_bytecodes.hpp"
 #include "rv32i_instr.hpp"
 #include "rvfd.hpp"
+#include <cmath>
 #ifdef RISCV_EXT_COMPRESSED
 #include "rvc.hpp"
 #endif
@@ -14,10 +15,17 @@
 
 #define MUSTTAIL __attribute__((musttail))
 #define MUNUSED  [[maybe_unused]]
+// preserve_none lets every handler keep the dispatch state in
+// argument registers without saving callee-saved registers
+#if defined(__clang__) && __clang_major__ >= 19 && (defined(__x86_64__) || defined(__aarch64__))
+#define TCO_CC   __attribute__((preserve_none))
+#else
+#define TCO_CC   /* */
+#endif
 #define DISPATCH_MODE_TAILCALL
 #define INSTRUCTION(bytecode, name) \
 	template <int W>                \
-	static TcoRet<W> name(DecoderData<W>* d, MUNUSED DecodedExecuteSegment<W>* exec, MUNUSED CPU<W>& cpu, MUNUSED address_type<W> pc, MUNUSED InstrCounter& counter)
+	static TCO_CC TcoRet<W> name(DecoderData<W>* d, MUNUSED DecodedExecuteSegment<W>* exec, MUNUSED CPU<W>& cpu, MUNUSED address_type<W> pc, MUNUSED InstrCounter counter)
 #define addr_t  address_type<W>
 #define saddr_t signed_address_type<W>
 #define XLEN    (8 * W)
@@ -37,8 +45,9 @@
 	d += 1;            \
 	EXECUTE_CURRENT()
 
+// The counter travels in registers, and is only spilled on exit
 #define RETURN_VALUES()   \
-	{pc}
+	(counter.apply(MACHINE()), TcoRet<W>{pc})
 #define UNUSED_FUNCTION() \
 	cpu.trigger_exception(ILLEGAL_OPCODE);
 
@@ -113,9 +122,11 @@ namespace riscv
 
 	template <int W>
 	using TcoRet = std::tuple<address_type<W>>;
+	// Passed by value, the counter occupies two argument registers
+	static_assert(std::is_trivially_copyable_v<InstrCounter> && sizeof(InstrCounter) == 16);
 
 	template <int W>
-	using DecoderFunc = TcoRet<W>(*)(DecoderData<W>*, DecodedExecuteSegment<W>*, CPU<W> &, address_type<W> pc, InstrCounter& counter);
+	using DecoderFunc = TcoRet<W>(TCO_CC *)(DecoderData<W>*, DecodedExecuteSegment<W>*, CPU<W> &, address_type<W> pc, InstrCounter counter);
 	namespace {
 		template <int W>
 		extern const DecoderFunc<W> computed_opcode[BYTECODES_MAX];
@@ -206,6 +217,7 @@ namespace riscv
 		// Check if the instruction is still invalid
 		bool stale = false;
 		try {
+			ScopedThrowingFaults throwing_faults;
 			if (d->instr == 0 && MACHINE().memory.template read<uint16_t>(pc) != 0) {
 				exec->set_stale(true);
 				stale = true;
@@ -342,6 +354,26 @@ namespace riscv
 		[RV32F_BC_FMUL]    = rv32f_fmul,
 		[RV32F_BC_FDIV]    = rv32f_fdiv,
 		[RV32F_BC_FMADD]   = rv32f_fmadd,
+		[RV32F_BC_FSGNJ]   = rv32f_fsgnj,
+		[RV32F_BC_FMINMAX] = rv32f_fminmax,
+		[RV32F_BC_FCMP]    = rv32f_fcmp,
+		[RV32F_BC_FCVT_SD_DS] = rv32f_fcvt_sd_ds,
+		[RV32F_BC_FCVT_W_SD]  = rv32f_fcvt_w_sd,
+		[RV32F_BC_FCVT_SD_W]  = rv32f_fcvt_sd_w,
+		[RV32F_BC_FMV_X_W] = rv32f_fmv_x_w,
+		[RV32F_BC_FMV_W_X] = rv32f_fmv_w_x,
+#ifdef RISCV_EXT_ATOMICS
+		[RV32A_BC_LR_W]    = rv32a_lr_w,
+		[RV32A_BC_SC_W]    = rv32a_sc_w,
+		[RV32A_BC_AMOADD_W]  = rv32a_amoadd_w,
+		[RV32A_BC_AMOSWAP_W] = rv32a_amoswap_w,
+#ifdef RISCV_64I
+		[RV64A_BC_LR_D]    = rv64a_lr_d,
+		[RV64A_BC_SC_D]    = rv64a_sc_d,
+		[RV64A_BC_AMOADD_D]  = rv64a_amoadd_d,
+		[RV64A_BC_AMOSWAP_D] = rv64a_amoswap_d,
+#endif
+#endif
 #ifdef RISCV_EXT_VECTOR
 		[RV32V_BC_VLE32]   = rv32v_vle32,
 		[RV32V_BC_VSE32]   = rv32v_vse32,
@@ -352,6 +384,7 @@ namespace riscv
 		[RV32I_BC_FUNCBLOCK] = execute_function_block,
 #ifdef RISCV_BINARY_TRANSLATION
 		[RV32I_BC_TRANSLATOR] = translated_function,
+		[RV32I_BC_BRANCH_PROFILE] = rv32i_branch_profile,
 #endif
 		[RV32I_BC_LIVEPATCH] = execute_livepatch,
 		[RV32I_BC_SYSTEM]  = rv32i_system,
@@ -382,10 +415,9 @@ namespace riscv
 		auto [new_pc] = EXECUTE_INSTR();
 
 		cpu.registers().pc = new_pc;
-		MACHINE().set_instruction_counter(counter.value());
 
-		// Machine stopped normally?
-		return counter.max() == 0;
+		// Machine stopped normally? (counters were spilled on exit)
+		return MACHINE().max_instructions() == 0;
 
 	} // CPU::simulate()
 
@@ -116,6 +116,26 @@ static constexpr void *computed_opcode[] = {
 	[RV32F_BC_FMUL] = &&rv32f_fmul,
 	[RV32F_BC_FDIV] = &&rv32f_fdiv,
 	[RV32F_BC_FMADD] = &&rv32f_fmadd,
+	[RV32F_BC_FSGNJ] = &&rv32f_fsgnj,
+	[RV32F_BC_FMINMAX] = &&rv32f_fminmax,
+	[RV32F_BC_FCMP] = &&rv32f_fcmp,
+	[RV32F_BC_FCVT_SD_DS] = &&rv32f_fcvt_sd_ds,
+	[RV32F_BC_FCVT_W_SD] = &&rv32f_fcvt_w_sd,
+	[RV32F_BC_FCVT_SD_W] = &&rv32f_fcvt_sd_w,
+	[RV32F_BC_FMV_X_W] = &&rv32f_fmv_x_w,
+	[RV32F_BC_FMV_W_X] = &&rv32f_fmv_w_x,
+#ifdef RISCV_EXT_ATOMICS
+	[RV32A_BC_LR_W] = &&rv32a_lr_w,
+	[RV32A_BC_SC_W] = &&rv32a_sc_w,
+	[RV32A_BC_AMOADD_W] = &&rv32a_amoadd_w,
+	[RV32A_BC_AMOSWAP_W] = &&rv32a_amoswap_w,
+#ifdef RISCV_64I
+	[RV64A_BC_LR_D] = &&rv64a_lr_d,
+	[RV64A_BC_SC_D] = &&rv64a_sc_d,
+	[RV64A_BC_AMOADD_D] = &&rv64a_amoadd_d,
+	[RV64A_BC_AMOSWAP_D] = &&rv64a_amoswap_d,
+#endif
+#endif
 #ifdef RISCV_EXT_VECTOR
 	[RV32V_BC_VLE32] = &&rv32v_vle32,
 	[RV32V_BC_VSE32] = &&rv32v_vse32,
@@ -126,6 +146,7 @@ static constexpr void *computed_opcode[] = {
 	[RV32I_BC_FUNCBLOCK] = &&execute_function_block,
 #ifdef RISCV_BINARY_TRANSLATION
 	[RV32I_BC_TRANSLATOR] = &&translated_function,
+	[RV32I_BC_BRANCH_PROFILE] = &&rv32i_branch_profile,
 #endif
 	[RV32I_BC_LIVEPATCH]  = &&execute_livepatch,
 	[RV32I_BC_SYSTEM] = &&rv32i_system,
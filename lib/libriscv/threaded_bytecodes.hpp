@@ -125,6 +125,26 @@ namespace riscv
 		RV32F_BC_FMUL,
 		RV32F_BC_FDIV,
 		RV32F_BC_FMADD,
+		RV32F_BC_FSGNJ,
+		RV32F_BC_FMINMAX,
+		RV32F_BC_FCMP,
+		RV32F_BC_FCVT_SD_DS,
+		RV32F_BC_FCVT_W_SD,
+		RV32F_BC_FCVT_SD_W,
+		RV32F_BC_FMV_X_W,
+		RV32F_BC_FMV_W_X,
+#ifdef RISCV_EXT_ATOMICS
+		RV32A_BC_LR_W,
+		RV32A_BC_SC_W,
+		RV32A_BC_AMOADD_W,
+		RV32A_BC_AMOSWAP_W,
+#ifdef RISCV_64I
+		RV64A_BC_LR_D,
+		RV64A_BC_SC_D,
+		RV64A_BC_AMOADD_D,
+		RV64A_BC_AMOSWAP_D,
+#endif
+#endif
 #ifdef RISCV_EXT_VECTOR
 		RV32V_BC_VLE32,
 		RV32V_BC_VSE32,
@@ -135,6 +155,7 @@ namespace riscv
 		RV32I_BC_FUNCBLOCK,
 #ifdef RISCV_BINARY_TRANSLATION
 		RV32I_BC_TRANSLATOR,
+		RV32I_BC_BRANCH_PROFILE,
 #endif
 		RV32I_BC_LIVEPATCH,
 		RV32I_BC_SYSTEM,
@@ -171,6 +192,36 @@ namespace riscv
 		}
 	};
 
+	// Conditional branches while recording a branch profile.
+	// The branch offset is kept with the counters of the branch.
+	union ProfiledBtype
+	{
+		uint32_t whole;
+
+		struct
+		{
+			uint16_t counters;
+			uint8_t  rs2 : 5;
+			uint8_t  compressed : 1;
+			uint8_t  unused : 2;
+			uint8_t  rs1 : 5;
+			uint8_t  funct3 : 3;
+		};
+
+		RISCV_ALWAYS_INLINE
+		auto get_rs1() const noexcept {
+			return rs1;
+		}
+		RISCV_ALWAYS_INLINE
+		auto get_rs2() const noexcept {
+			return rs2;
+		}
+		RISCV_ALWAYS_INLINE
+		unsigned length() const noexcept {
+			return compressed ? 2 : 4;
+		}
+	};
+
 	union FasterOpType
 	{
 		uint32_t whole;
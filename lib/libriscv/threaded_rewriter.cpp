@@ -122,6 +122,18 @@ namespace riscv
 					return RV32I_BC_INVALID;
 				}
 
+#ifdef RISCV_BINARY_TRANSLATION
+				if (this->m_do_record_branch_profile && this->m_branch_counters.size() <= UINT16_MAX) {
+					ProfiledBtype rewritten {};
+					rewritten.rs1 = original.Btype.rs1;
+					rewritten.rs2 = original.Btype.rs2;
+					rewritten.funct3 = original.Btype.funct3;
+					rewritten.counters = this->add_branch_counters(pc, imm);
+
+					instr.whole = rewritten.whole;
+					return RV32I_BC_BRANCH_PROFILE;
+				}
+#endif
 				FasterItype rewritten;
 				rewritten.rs1 = original.Btype.rs1;
 				rewritten.rs2 = original.Btype.rs2;
@@ -298,10 +310,64 @@ namespace riscv
 				instr.whole = rewritten.whole;
 				return bytecode;
 			}
+			case RV32F_BC_FSGNJ:
+			case RV32F_BC_FMINMAX:
+			case RV32F_BC_FCMP: {
+				const rv32f_instruction fi{instr};
+
+				FasterFloatType rewritten;
+				rewritten.rd  = fi.R4type.rd;
+				rewritten.rs1 = fi.R4type.rs1;
+				rewritten.rs2 = fi.R4type.rs2;
+				rewritten.func = fi.R4type.funct3 | (fi.R4type.funct2 << 4);
+
+				instr.whole = rewritten.whole;
+				return bytecode;
+			}
+			case RV32F_BC_FCVT_SD_DS:
+			case RV32F_BC_FCVT_W_SD:
+			case RV32F_BC_FCVT_SD_W:
+			case RV32F_BC_FMV_X_W:
+			case RV32F_BC_FMV_W_X: {
+				const rv32f_instruction fi{instr};
+
+				// Conversions have a single source register, and
+				// rs2 selects the signedness and width of the integer
+				FasterFloatType rewritten;
+				rewritten.rd  = fi.R4type.rd;
+				rewritten.rs1 = fi.R4type.rs1;
+				rewritten.rs2 = 0;
+				rewritten.func = fi.R4type.rs2 | (fi.R4type.funct2 << 4);
+
+				instr.whole = rewritten.whole;
+				return bytecode;
+			}
 			case RV32F_BC_FMADD: {
 				// It's unclear how to optimize this instruction
 				return bytecode;
 			}
+			/** Atomic instructions **/
+#ifdef RISCV_EXT_ATOMICS
+			case RV32A_BC_LR_W:
+			case RV32A_BC_SC_W:
+			case RV32A_BC_AMOADD_W:
+			case RV32A_BC_AMOSWAP_W:
+#ifdef RISCV_64I
+			case RV64A_BC_LR_D:
+			case RV64A_BC_SC_D:
+			case RV64A_BC_AMOADD_D:
+			case RV64A_BC_AMOSWAP_D:
+#endif
+			{
+				FasterOpType rewritten;
+				rewritten.rd  = original.Atype.rd;
+				rewritten.rs1 = original.Atype.rs1;
+				rewritten.rs2 = original.Atype.rs2;
+
+				instr.whole = rewritten.whole;
+				return bytecode;
+			}
+#endif
 			/** Vector instructions **/
 #ifdef RISCV_EXT_VECTOR
 			case RV32V_BC_VLE32:
@@ -454,6 +520,20 @@ namespace riscv
 					return RV32I_BC_INVALID; // No, just return invalid
 				}
 
+#ifdef RISCV_BINARY_TRANSLATION
+				if (this->m_do_record_branch_profile && this->m_branch_counters.size() <= UINT16_MAX) {
+					// Profiled as BEQ/BNE against x0
+					ProfiledBtype rewritten {};
+					rewritten.rs1 = ci.CB.srs1 + 8;
+					rewritten.rs2 = 0;
+					rewritten.compressed = 1;
+					rewritten.funct3 = (bytecode == RV32C_BC_BEQZ) ? 0x0 : 0x1;
+					rewritten.counters = this->add_branch_counters(pc, imm);
+
+					instr.whole = rewritten.whole;
+					return RV32I_BC_BRANCH_PROFILE;
+				}
+#endif
 				FasterItype rewritten;
 				rewritten.rs1 = ci.CB.srs1 + 8;
 				rewritten.rs2 = 0;
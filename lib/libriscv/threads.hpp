@@ -65,6 +65,8 @@ struct MultiThreading
 	bool      suspend_and_yield(long result = 0);
 	bool      yield_to(int tid, bool store_retval = true);
 	void      erase_thread(int tid);
+	size_t    size() const noexcept { return m_threads.size(); }
+	void      set_max_threads(unsigned max) noexcept { m_max_threads = max; }
 	void      wakeup_next();
 	bool      block(address_t retval, uint32_t reason, uint32_t extra = 0);
 	void      unblock(int tid);
@@ -89,7 +91,7 @@ struct MultiThreading
 
 template <int W>
 inline MultiThreading<W>::MultiThreading(Machine<W>& mach)
-	: machine(mach)
+	: machine(mach), m_max_threads(mach.resource_limits().threads)
 {
 	// Best guess for default stack boundries
 	const address_t base = 0x1000;
@@ -128,9 +130,9 @@ inline void Thread<W>::resume()
 {
 	threading.m_current = this;
 	auto& m = threading.machine;
-	// restore registers
+	// restore registers, including vector lanes if this thread used them
 	m.cpu.registers().copy_from(
-		Registers<W>::Options::NoVectors,
+		Registers<W>::Options::Everything,
 		this->stored_regs);
 	THPRINT(threading.machine,
 		"Returning to tid=%d tls=0x%lX stack=0x%lX\n",
@@ -139,14 +141,17 @@ inline void Thread<W>::resume()
 			(long)this->stored_regs.get(REG_SP));
 	// this will ensure PC is executable in all cases
 	m.cpu.aligned_jump(m.cpu.pc());
+	// Deliver signals that were queued while this thread was suspended
+	if (UNLIKELY(m.has_signals() && m.signals().has_pending(this->tid)))
+		m.request_signal_safepoint();
 }
 
 template <int W>
 inline void Thread<W>::suspend()
 {
-	// copy all regs except vector lanes
+	// copy all regs (vector lanes only once they have been used)
 	this->stored_regs.copy_from(
-		Registers<W>::Options::NoVectors,
+		Registers<W>::Options::Everything,
 		threading.machine.cpu.registers());
 	// add to suspended (NB: can throw)
 	threading.m_suspended.push_back(this);
@@ -163,9 +168,9 @@ inline void Thread<W>::suspend(address_t return_value)
 template <int W>
 inline void Thread<W>::block(uint32_t reason, uint32_t extra)
 {
-	// copy all regs except vector lanes
+	// copy all regs (vector lanes only once they have been used)
 	this->stored_regs.copy_from(
-		Registers<W>::Options::NoVectors,
+		Registers<W>::Options::Everything,
 		threading.machine.cpu.registers());
 	this->block_word = reason;
 	this->block_extra = extra;
@@ -276,7 +281,7 @@ inline Thread<W>* MultiThreading<W>::create(
 			address_t stack, address_t tls, address_t stkbase, address_t stksize)
 {
 	if (this->m_threads.size() >= this->m_max_threads)
-		throw MachineException(INVALID_PROGRAM, "Too many threads", this->m_max_threads);
+		throw MachineException(RESOURCE_LIMIT_REACHED, "Too many threads", this->m_max_threads);
 
 	const int tid = ++this->m_thread_counter;
 	auto it = m_threads.try_emplace(tid, *this, tid, tls, stack, stkbase, stksize);
@@ -416,6 +421,8 @@ inline void MultiThreading<W>::erase_thread(int tid)
 	auto it = m_threads.find(tid);
 	assert(it != m_threads.end());
 	m_threads.erase(it);
+	if (machine.has_signals())
+		machine.signals().erase_thread(tid);
 }
 
 } // riscv
@@ -142,7 +142,7 @@ typedef struct {
 	uint32_t fcsr;
 	fp64reg fr[32];
 #ifdef RISCV_EXT_VECTOR
-	RVV rvv;
+	RVV* rvv; // Allocated on first use
 #endif
 } CPU;
 
@@ -173,16 +173,31 @@ static struct CallbackTable {
 	int (*ctzl) (uint64_t);
 	int (*cpop) (uint32_t);
 	int (*cpopl) (uint64_t);
+	addr_t (*segment_base)(const CPU*);
+	void (*vec_allocate)(CPU*);
 } api;
 #define ARENA_READ_BOUNDARY  (RISCV_ARENA_END - 0x1000)
 #define ARENA_WRITE_BOUNDARY (RISCV_ARENA_END - RISCV_ARENA_ROEND)
 #define ARENA_READABLE(x) ((x) - 0x1000 < ARENA_READ_BOUNDARY)
 #define ARENA_WRITABLE(x) ((x) - RISCV_ARENA_ROEND < ARENA_WRITE_BOUNDARY)
+// The whole range [x, x + len] is readable or writable
+#define ARENA_READABLE_RANGE(x, len) (ARENA_READ_BOUNDARY > (len) && (x) - 0x1000 < ARENA_READ_BOUNDARY - (len))
+#define ARENA_WRITABLE_RANGE(x, len) (ARENA_WRITE_BOUNDARY > (len) && (x) - RISCV_ARENA_ROEND < ARENA_WRITE_BOUNDARY - (len))
 
 INTERNAL static int32_t arena_offset;
 //#define ARENA_AT(cpu, x)  (arena_ptr + (x))
 #define ARENA_AT(cpu, x)  (*(char **)((uintptr_t)cpu + arena_offset) + (x))
 
+// Direct-mapped page cache for memory outside of the arena
+typedef struct {
+	addr_t pageno;
+	char*  data;
+} TLBEntry;
+INTERNAL static int32_t tlb_offset;
+#define TLB_READ(cpu, x)  (&((const TLBEntry *)((uintptr_t)cpu + tlb_offset))[PAGENO(x) & (RISCV_TLB_ENTRIES-1)])
+#define TLB_WRITE(cpu, x) (&((const TLBEntry *)((uintptr_t)cpu + tlb_offset))[RISCV_TLB_ENTRIES + (PAGENO(x) & (RISCV_TLB_ENTRIES-1))])
+#define TLB_HIT(e, x, size) ((e)->pageno == PAGENO(x) && PAGEOFF(x) <= 0x1000 - (size))
+
 INTERNAL static int32_t ins_counter_offset;
 INTERNAL static int32_t max_counter_offset;
 #define INS_COUNTER(cpu) (*(uint64_t *)((uintptr_t)cpu + ins_counter_offset))
@@ -192,17 +207,9 @@ static inline int do_syscall(CPU* cpu, uint64_t counter, uint64_t max_counter, a
 {
 	INS_COUNTER(cpu) = counter; // Reveal instruction counters
 	MAX_COUNTER(cpu) = max_counter;
-#ifdef __TINYC__
+	// The host suspends fault landing pads around the handler, so that
+	// guest faults inside handlers unwind instead of jumping over them.
 	return api.system_call(cpu, sysno);
-#else
-	addr_t old_pc = cpu->pc;
-	if (LIKELY(sysno < RISCV_MAX_SYSCALLS))
-		api.syscalls[SPECSAFE(sysno)](cpu);
-	else
-		api.unknown_syscall(cpu, sysno);
-	// Resume if the system call did not modify PC, or hit a limit
-	return (cpu->pc != old_pc || counter >= MAX_COUNTER(cpu));
-#endif
 }
 
 #define JUMP_TO(addr) \
@@ -235,12 +242,13 @@ static
 #else
 extern VISIBLE
 #endif
-void init(struct CallbackTable* table, int32_t arena_off, int32_t ins_counter_off, int32_t max_counter_off)
+void init(struct CallbackTable* table, int32_t arena_off, int32_t ins_counter_off, int32_t max_counter_off, int32_t tlb_off)
 {
 	api = *table;
 	arena_offset = arena_off;
 	ins_counter_offset = ins_counter_off;
 	max_counter_offset = max_counter_off;
+	tlb_offset = tlb_off;
 }
 
 typedef struct {
@@ -28,5 +28,7 @@ namespace riscv {
 		int (*ctzl) (uint64_t);
 		int (*cpop) (uint32_t);
 		int (*cpopl) (uint64_t);
+		address_type<W> (*segment_base)(CPU<W>&);
+		void (*vec_allocate)(CPU<W>&);
 	};
 }
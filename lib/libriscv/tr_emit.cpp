@@ -13,8 +13,8 @@
 #endif
 
 #define PCRELA(x) ((address_t) (this->pc() + (x)))
-#define PCRELS(x) hex_address(PCRELA(x)) + "L"
-#define STRADDR(x) (hex_address(x) + "L")
+#define PCRELS(x) pc_address(PCRELA(x))
+#define STRADDR(x) pc_address(x)
 // Reveal PC on unknown instructions
 #ifdef RISCV_LIBTCC
 // libtcc always runs on the current machine, so we can use the handler index directly
@@ -53,7 +53,7 @@
 	this->reload_all_registers(); \
 	this->untrack_all_gprs();     \
   } else if (m_zero_insn_counter <= 1) \
-    code += "api.exception(cpu, " + hex_address(this->pc()) + ", ILLEGAL_OPCODE);\n"; \
+    code += "api.exception(cpu, " + STRADDR(this->pc()) + ", ILLEGAL_OPCODE);\n"; \
 }
 #define WELL_KNOWN_INSTRUCTION() { \
 	code += "#ifdef __wasm__\n"; \
@@ -223,12 +223,23 @@ struct Emitter
 		}
 		return "(addr_t)0";
 	}
+	std::string loaded_fpregname(int reg) {
+		return "fpreg" + std::to_string(reg);
+	}
 	std::string from_fpreg(int reg) {
+		if (uses_register_caching()) {
+			fpr_exists[reg] = true;
+			return loaded_fpregname(reg);
+		}
 		return "cpu->fr[" + std::to_string(reg) + "]";
 	}
 #ifdef RISCV_EXT_VECTOR
 	std::string from_rvvreg(int reg) {
-		return "cpu->rvv.lane[" + std::to_string(reg) + "]";
+		return "cpu->rvv->lane[" + std::to_string(reg) + "]";
+	}
+	void emit_vector_state() {
+		// The vector register file is allocated on first use
+		code += "if (UNLIKELY(cpu->rvv == 0)) api.vec_allocate(cpu);\n";
 	}
 #endif
 	std::string from_imm(int64_t imm) {
@@ -251,10 +262,19 @@ struct Emitter
 
 	void emit_system_call(const std::string& syscall_reg);
 
+	// Returns true if the CSR access was emitted in-line
+	bool emit_csr_access();
+
+	// Returns the end of a window of memory accesses starting at the given
+	// instruction, whose bounds-checks can be coalesced, or -1 if none.
+	int find_coalescing_window(int begin);
+	void emit_coalesced_range_check();
+
 	// Returns true if the function call has exited/returned from the block
 	bool emit_function_call(address_t target, address_t dest_pc);
 
 	bool gpr_exists_at(int reg) const noexcept { return this->gpr_exists.at(reg); }
+	bool fpr_exists_at(int reg) const noexcept { return this->fpr_exists.at(reg); }
 	auto& get_gpr_exists() const noexcept { return this->gpr_exists; }
 
 	bool uses_flat_memory_arena() noexcept {
@@ -319,6 +339,9 @@ struct Emitter
 	template <typename T>
 	bool try_tracking_memory(address_t absolute_vaddr, int reg, T value) {
 		(void)value;
+		// Read-only memory may differ wherever a relocatable translation is used
+		if (tinfo.relocatable)
+			return false;
 		if (absolute_vaddr != 0 && absolute_vaddr >= 0x1000 && absolute_vaddr + sizeof(T) <= tinfo.arena_roend && absolute_vaddr + sizeof(T) > absolute_vaddr) {
 			auto* ptr = reinterpret_cast<T*>(this->tinfo.arena_ptr + absolute_vaddr);
 			if constexpr (std::is_signed_v<T>) {
@@ -356,7 +379,7 @@ struct Emitter
 		}
 
 		const auto address = from_reg(reg) + " + " + from_imm(imm);
-		if (uses_Nbit_encompassing_arena())
+		if (uses_Nbit_encompassing_arena() || m_range_checked[reg])
 		{
 			add_code(dst + " = " + cast + "*(" + type + "*)" + arena_at(address) + ";");
 		}
@@ -365,14 +388,35 @@ struct Emitter
 				"if (LIKELY(ARENA_READABLE(" + address + ")))",
 					dst + " = " + cast + "*(" + type + "*)" + arena_at(address) + ";",
 				"else {",
-					dst + " = " + cast + "(" + type + ")api.mem_ld(cpu, " + address + ", " + std::to_string(sizeof(T)) + ");",
+					paged_load<T>(dst, cast, type, address),
 				"}");
 		} else {
 			add_code(
-				dst + " = " + cast + "(" + type + ")api.mem_ld(cpu, " + address + ", " + std::to_string(sizeof(T)) + ");"
+				paged_load<T>(dst, cast, type, address)
 			);
 		}
 	}
+	// Probe the page cache before falling back to a full page lookup
+	template <typename T>
+	std::string paged_load(const std::string& dst, const std::string& cast, const std::string& type, const std::string& address)
+	{
+		const std::string size = std::to_string(sizeof(T));
+		if constexpr (sizeof(T) > 8) {
+			return dst + " = " + cast + "(" + type + ")api.mem_ld(cpu, " + address + ", " + size + ");";
+		} else {
+			return "{ const addr_t tlb_addr = " + address + "; const TLBEntry* tlb_e = TLB_READ(cpu, tlb_addr);\n"
+				"if (LIKELY(TLB_HIT(tlb_e, tlb_addr, " + size + "))) " + dst + " = " + cast + "*(" + type + "*)(tlb_e->data + PAGEOFF(tlb_addr));\n"
+				"else " + dst + " = " + cast + "(" + type + ")api.mem_ld(cpu, tlb_addr, " + size + "); }";
+		}
+	}
+	std::string paged_store(const std::string& type, const std::string& address, const std::string& value)
+	{
+		if (type == "VectorLane")
+			return "api.mem_st(cpu, " + address + ", " + value + ", sizeof(" + type + "));";
+		return "{ const addr_t tlb_addr = " + address + "; const TLBEntry* tlb_e = TLB_WRITE(cpu, tlb_addr);\n"
+			"if (LIKELY(TLB_HIT(tlb_e, tlb_addr, sizeof(" + type + ")))) *(" + type + "*)(tlb_e->data + PAGEOFF(tlb_addr)) = " + value + ";\n"
+			"else api.mem_st(cpu, tlb_addr, " + value + ", sizeof(" + type + ")); }";
+	}
 	void memory_store(std::string type, int reg, int32_t imm, std::string value)
 	{
 		if (uses_flat_memory_arena()) {
@@ -390,7 +434,7 @@ struct Emitter
 		}
 
 		const auto address = from_reg(reg) + " + " + from_imm(imm);
-		if (uses_Nbit_encompassing_arena())
+		if (uses_Nbit_encompassing_arena() || m_range_checked[reg])
 		{
 			add_code("*(" + type + "*)" + arena_at(address) + " = " + value + ";");
 		}
@@ -399,11 +443,11 @@ struct Emitter
 				"if (LIKELY(ARENA_WRITABLE(" + address + ")))",
 				"  *(" + type + "*)" + arena_at(address) + " = " + value + ";",
 				"else {",
-				"  api.mem_st(cpu, " + address + ", " + value + ", sizeof(" + type + "));",
+				"  " + paged_store(type, address, value),
 				"}");
 		} else {
 			add_code(
-				"api.mem_st(cpu, " + address + ", " + value + ", sizeof(" + type + "));"
+				paged_store(type, address, value)
 			);
 		}
 	}
@@ -481,6 +525,12 @@ private:
 	static std::string speculation_safe(const std::string& address) {
 		return "SPECSAFE(" + address + ")";
 	}
+	// Guest PCs are relative to the segment base in relocatable translations
+	std::string pc_address(address_t addr) const {
+		if (tinfo.relocatable)
+			return "(segbase + " + hex_address(addr - tinfo.segment_basepc) + ")";
+		return hex_address(addr) + "L";
+	}
 	static std::string speculation_safe(const address_t address) {
 		return "SPECSAFE(" + hex_address(address) + ")";
 	}
@@ -544,6 +594,16 @@ private:
 	bool m_used_store_syscalls = false;
 
 	std::array<bool, 32> gpr_exists {};
+	std::array<bool, 32> fpr_exists {};
+	// Base registers whose accesses are covered by a coalesced range check
+	struct RangeAccess {
+		unsigned count = 0;
+		int32_t min = 0;
+		int32_t max = 0;
+		bool store = false;
+	};
+	std::array<RangeAccess, 32> m_window_ranges {};
+	std::array<bool, 32> m_range_checked {};
 	// Register tracking
 	std::array<std::variant<std::monostate, address_t>, 32> gpr_values {};
 
@@ -563,10 +623,18 @@ template <int W>
 inline void Emitter<W>::emit_branch(const BranchInfo& binfo, const std::string& op)
 {
 	using address_t = address_type<W>;
+	std::string cond;
 	if (binfo.sign == false)
-		code += "if (" + from_reg(instr.Btype.rs1) + op + from_reg(instr.Btype.rs2) + ")";
+		cond = from_reg(instr.Btype.rs1) + op + from_reg(instr.Btype.rs2);
 	else
-		code += "if ((saddr_t)" + from_reg(instr.Btype.rs1) + op + " (saddr_t)" + from_reg(instr.Btype.rs2) + ")";
+		cond = "(saddr_t)" + from_reg(instr.Btype.rs1) + op + " (saddr_t)" + from_reg(instr.Btype.rs2);
+
+	// Let the compiler lay out the profiled hot path as the fall-through
+	auto hint = tinfo.branch_hints->find(this->pc());
+	if (hint != tinfo.branch_hints->end())
+		code += std::string(hint->second ? "if (LIKELY(" : "if (UNLIKELY(") + cond + "))";
+	else
+		code += "if (" + cond + ")";
 
 	if (UNLIKELY(PCRELA(instr.Btype.signed_imm()) & ALIGN_MASK))
 	{
@@ -608,13 +676,17 @@ inline bool Emitter<W>::emit_function_call(address_t target_funcaddr, address_t
 
 	auto target_func = funclabel<W>("f", target_funcaddr);
 	add_forward(target_func);
+	// Relocatable functions pass on the segment base
+	const std::string segbase = tinfo.relocatable ? ", segbase" : "";
+	if (tinfo.relocatable)
+		target_func += "_r";
 	if (!tinfo.ignore_instruction_limit) {
 		// Call the function and get the return values
-		add_code("{ReturnValues rv = " + target_func + "(cpu, counter, max_counter, " + STRADDR(dest_pc) + ");");
+		add_code("{ReturnValues rv = " + target_func + "(cpu, counter, max_counter, " + STRADDR(dest_pc) + segbase + ");");
 		// Update the local counter registers
 		add_code("counter = rv.counter; max_counter = rv.max_counter;}");
 	} else {
-		add_code("{ReturnValues rv = " + target_func + "(cpu, 0, max_counter, " + STRADDR(dest_pc) + ");");
+		add_code("{ReturnValues rv = " + target_func + "(cpu, 0, max_counter, " + STRADDR(dest_pc) + segbase + ");");
 		add_code("max_counter = rv.max_counter;}");
 	}
 
@@ -652,8 +724,9 @@ inline void Emitter<W>::emit_system_call(const std::string& syscall_reg)
 		static constexpr int SYSCALL_FUTEX_TIME64 = 422;
 		static constexpr int SYSCALL_TKILL        = 130;
 		static constexpr int SYSCALL_TGKILL       = 131;
+		static constexpr int SYSCALL_RT_SIGRETURN = 139;
 		// There may be more, but these are known to clobber all registers
-		static constexpr std::array<int, 9> clobbering_syscalls = {
+		static constexpr std::array<int, 10> clobbering_syscalls = {
 			SYSCALL_CLONE,
 			SYSCALL_CLONE3,
 			SYSCALL_SCHED_YIELD,
@@ -663,6 +736,7 @@ inline void Emitter<W>::emit_system_call(const std::string& syscall_reg)
 			SYSCALL_FUTEX_TIME64,
 			SYSCALL_TKILL,
 			SYSCALL_TGKILL,
+			SYSCALL_RT_SIGRETURN,
 		};
 
 		if (this->gpr_has_known_value(REG_ECALL)) {
@@ -697,7 +771,7 @@ inline void Emitter<W>::emit_system_call(const std::string& syscall_reg)
 			code += "  STORE_NON_SYS_REGS_" + this->func + "();\n";
 			code += "}\n";
 		}
-		code += "  cpu->pc += 4; return (ReturnValues){counter, MAX_COUNTER(cpu)};}\n"; // Correct for +4 expectation outside of bintr
+		code += "  cpu->pc += 4; return (ReturnValues){INS_COUNTER(cpu), MAX_COUNTER(cpu)};}\n"; // Correct for +4 expectation outside of bintr
 		code += "counter = INS_COUNTER(cpu);\n"; // Restore instruction counter
 	} else {
 		code += "if (UNLIKELY(do_syscall(cpu, 0, max_counter, " + syscall_reg + "))) {\n";
@@ -707,6 +781,220 @@ inline void Emitter<W>::emit_system_call(const std::string& syscall_reg)
 	this->reload_syscall_registers();
 }
 
+template <int W>
+inline bool Emitter<W>::emit_csr_access()
+{
+	const uint32_t funct3 = instr.Itype.funct3;
+	const uint32_t csr = instr.Itype.imm;
+	const int rd = instr.Itype.rd;
+	const int rs1 = instr.Itype.rs1;
+
+	switch (csr) {
+	case 0xC00: // RDCYCLE (lower)
+	case 0xC02: // RDINSTRET (lower)
+	case 0xC80: // RDCYCLE (upper)
+	case 0xC82: // RDINSTRET (upper)
+	case 0xF11: // marchid
+	case 0xF12: // mvendorid
+	case 0xF13: // mimpid
+		// Only plain reads (CSRRS rd, csr, zero) are handled in-line
+		if (funct3 != 0x2 || rs1 != 0 || rd == 0)
+			return false;
+		if (csr >= 0xF11) {
+			add_code(to_reg(rd) + " = " + (csr == 0xF13 ? "1" : "0") + ";");
+			this->track_gpr(rd, (csr == 0xF13) ? 1 : 0);
+			return true;
+		}
+		// Without instruction counting there is no live counter to read,
+		// so the counter CSRs are read by the system handler instead.
+		if (tinfo.ignore_instruction_limit)
+			return false;
+		// The instruction counter is the live local counter
+		this->increment_counter_so_far();
+		{
+			const std::string shift = (csr >= 0xC80) ? " >> 32" : "";
+			if constexpr (W == 4)
+				add_code(to_reg(rd) + " = (uint32_t)(counter" + shift + ");");
+			else
+				add_code(to_reg(rd) + " = counter" + shift + ";");
+		}
+		this->untrack_gpr(rd);
+		return true;
+	case 0x001: // fflags
+	case 0x002: // frm
+	case 0x003: // fcsr
+		break;
+	default:
+		return false;
+	}
+
+	// FCSR accesses: fflags is bits 0-4, frm is bits 5-7, fcsr is both
+	const unsigned shift = (csr == 0x002) ? 5 : 0;
+	const unsigned mask  = (csr == 0x001) ? 0x1F : (csr == 0x002) ? 0x7 : 0xFF;
+	std::string src;
+	switch (funct3) {
+	case 0x1: // CSRRW
+	case 0x2: // CSRRS
+	case 0x3: // CSRRC
+		src = from_reg(rs1);
+		break;
+	case 0x5: // CSRRWI
+	case 0x7: // CSRRCI
+		src = std::to_string(rs1);
+		break;
+	default:
+		return false;
+	}
+	std::string value;
+	switch (funct3) {
+	case 0x1:
+	case 0x5:
+		value = "(" + src + ")";
+		break;
+	case 0x2:
+		value = "(old | " + src + ")";
+		break;
+	default:
+		value = "(old & ~" + src + ")";
+		break;
+	}
+	const std::string smask = std::to_string(mask);
+	code += "{ const uint32_t old = (cpu->fcsr >> " + std::to_string(shift) + ") & " + smask + ";\n";
+	// Writes to fflags or frm leave the other field intact
+	if (funct3 != 0x2 || rs1 != 0) {
+		code += "cpu->fcsr = (cpu->fcsr & ~" + hex_address(mask << shift) + ") | ((uint32_t)("
+			+ value + " & " + smask + ") << " + std::to_string(shift) + ");\n";
+	}
+	if (rd != 0)
+		code += to_reg(rd) + " = old;\n";
+	code += "}\n";
+	this->untrack_gpr(rd);
+	return true;
+}
+
+template <int W>
+inline int Emitter<W>::find_coalescing_window(int begin)
+{
+	static constexpr int MAX_WINDOW_LENGTH = 32;
+	if (!uses_flat_memory_arena() || uses_Nbit_encompassing_arena() || tinfo.trace_instructions)
+		return -1;
+
+	m_window_ranges = {};
+	std::array<bool, 32> modified {};
+	const int count = int(tinfo.instr.size());
+	address_t pc = this->pc();
+	int end = -1;
+	bool coalescable = false;
+
+	// The window must end before the last instruction of the block,
+	// so that the fallback path can be closed by the emitter loop.
+	for (int k = begin; k < count - 1 && k - begin < MAX_WINDOW_LENGTH; k++) {
+		rv32i_instruction ins = tinfo.instr[k];
+		const unsigned length = (compressed_enabled) ? ins.length() : 4;
+		// Jump targets and ebreak locations inside the window would be emitted twice
+		if (k > begin && (mapping_labels.count(k) || tinfo.global_jump_locations.count(pc)
+			|| tinfo.jump_locations.count(pc) || tinfo.ebreak_locations->count(pc)))
+			break;
+		if (compressed_enabled && length == 4 && tinfo.jump_locations.count(pc + 2))
+			break;
+		if (ins.is_illegal())
+			break;
+#ifdef RISCV_EXT_C
+		if (ins.is_compressed()) {
+			const auto current = this->instr;
+			this->instr = ins;
+			ins = this->emit_rvc();
+			this->instr = current;
+			if (ins.is_compressed())
+				break;
+		}
+#endif
+		int base = -1;
+		int32_t imm = 0;
+		bool store = false;
+		int rd = 0;
+		switch (ins.opcode()) {
+		case RV32I_LOAD:
+			if (ins.Itype.rd != 0 && ins.Itype.funct3 <= 0x6) {
+				base = ins.Itype.rs1;
+				imm = ins.Itype.signed_imm();
+				rd = ins.Itype.rd;
+			}
+			break;
+		case RV32I_STORE:
+			if (ins.Stype.funct3 <= 0x3) {
+				base = ins.Stype.rs1;
+				imm = ins.Stype.signed_imm();
+				store = true;
+			}
+			break;
+		case RV32F_LOAD: {
+			const rv32f_instruction fi{ins};
+			if (fi.Itype.funct3 == 0x2 || fi.Itype.funct3 == 0x3) {
+				base = fi.Itype.rs1;
+				imm = fi.Itype.signed_imm();
+			}
+			} break;
+		case RV32F_STORE: {
+			const rv32f_instruction fi{ins};
+			if (fi.Stype.funct3 == 0x2 || fi.Stype.funct3 == 0x3) {
+				base = fi.Stype.rs1;
+				imm = fi.Stype.signed_imm();
+				store = true;
+			}
+			} break;
+		default:
+			break;
+		}
+		// Only loads and stores are part of a window
+		if (base < 0)
+			break;
+		// The base register must be unmodified since the start of the window
+		if (modified[base])
+			break;
+		// Accesses with known addresses are already unchecked
+		if (!(base == REG_GP && tinfo.gp != 0x0) && !gpr_has_known_value(base)) {
+			auto& range = m_window_ranges[base];
+			if (range.count == 0) {
+				range.min = imm;
+				range.max = imm;
+			} else {
+				range.min = std::min(range.min, imm);
+				range.max = std::max(range.max, imm);
+				coalescable = true;
+			}
+			range.count++;
+			range.store |= store;
+		}
+		if (rd != 0)
+			modified[rd] = true;
+
+		end = k + 1;
+		pc += length;
+	}
+	if (!coalescable)
+		return -1;
+	return end;
+}
+
+template <int W>
+inline void Emitter<W>::emit_coalesced_range_check()
+{
+	std::string cond;
+	for (int reg = 1; reg < 32; reg++) {
+		const auto& range = m_window_ranges[reg];
+		if (range.count < 2)
+			continue;
+		if (!cond.empty())
+			cond += " && ";
+		// A store anywhere in the range requires the whole range to be writable
+		cond += std::string(range.store ? "ARENA_WRITABLE_RANGE(" : "ARENA_READABLE_RANGE(")
+			+ from_reg(reg) + " + " + from_imm(range.min) + ", " + std::to_string(range.max - range.min) + ")";
+		m_range_checked[reg] = true;
+	}
+	code += "if (LIKELY(" + cond + ")) {\n";
+}
+
 #ifdef RISCV_EXT_C
 #include "tr_emit_rvc.cpp"
 #endif
@@ -719,7 +1007,32 @@ void Emitter<W>::emit()
 	auto next_pc = tinfo.basepc;
 	address_t current_callable_pc = 0;
 
+	// A window of memory accesses is emitted twice: first with coalesced
+	// bounds-checks and then again as a fallback with individual checks
+	int window_begin = -1, window_end = -1;
+	bool window_fallback = false;
+	address_t window_pc = 0;
+	uint64_t window_icounter = 0;
+	decltype(gpr_values) window_gpr_values;
+
 	for (int i = 0; i < int(tinfo.instr.size()); i++) {
+		bool replay = false;
+		if (i == window_end) {
+			if (!window_fallback) {
+				code += "} else {\n";
+				this->m_range_checked = {};
+				this->m_instr_counter = window_icounter;
+				this->gpr_values = window_gpr_values;
+				window_fallback = true;
+				i = window_begin;
+				next_pc = window_pc;
+				replay = true;
+			} else {
+				code += "}\n";
+				window_begin = window_end = -1;
+				window_fallback = false;
+			}
+		}
 		this->m_idx = i;
 		this->instr = tinfo.instr[i];
 		this->m_pc = next_pc;
@@ -729,72 +1042,87 @@ void Emitter<W>::emit()
 			this->m_instr_length = 4;
 		next_pc = this->m_pc + this->m_instr_length;
 
-		if (this->instr.is_illegal()) {
-			this->m_zero_insn_counter ++;
-		} else if (this->m_zero_insn_counter >= 4) {
-			// After a ream of zero instructions, we predict a jump target
-			this->m_zero_insn_counter = 0;
-			mapping_labels.insert(i);
-		}
+		if (!replay) {
+			if (this->instr.is_illegal()) {
+				this->m_zero_insn_counter ++;
+			} else if (this->m_zero_insn_counter >= 4) {
+				// After a ream of zero instructions, we predict a jump target
+				this->m_zero_insn_counter = 0;
+				mapping_labels.insert(i);
+			}
 
-		// If the address is a return address or a global JAL target
-		if (i > 0 && (mapping_labels.count(i) || tinfo.global_jump_locations.count(this->pc()))) {
-			this->increment_counter_so_far();
-			// Re-entry through the current function
-			code.append(FUNCLABEL(this->pc()) + ":;\n");
-			this->mappings.push_back({
-				this->pc(), this->func
-			});
-			this->untrack_all_gprs();
-		}
-		// known jump locations
-		else if (i > 0 && tinfo.jump_locations.count(this->pc())) {
-			this->increment_counter_so_far();
-			code.append(FUNCLABEL(this->pc()) + ":;\n");
-			this->untrack_all_gprs();
-		}
+			// If the address is a return address or a global JAL target
+			if (i > 0 && (mapping_labels.count(i) || tinfo.global_jump_locations.count(this->pc()))) {
+				this->increment_counter_so_far();
+				// Re-entry through the current function
+				code.append(FUNCLABEL(this->pc()) + ":;\n");
+				this->mappings.push_back({
+					this->pc(), this->func
+				});
+				this->untrack_all_gprs();
+			}
+			// known jump locations
+			else if (i > 0 && tinfo.jump_locations.count(this->pc())) {
+				this->increment_counter_so_far();
+				code.append(FUNCLABEL(this->pc()) + ":;\n");
+				this->untrack_all_gprs();
+			}
 
-		// With garbage instructions, it's possible that someone is trying to jump to
-		// the middle of an instruction. This technically allowed, so we need to check
-		// there's a jump label in the middle of this instruction.
-		if (compressed_enabled && this->m_instr_length == 4 && tinfo.jump_locations.count(this->pc() + 2)) {
-			// This occurence should be very rare, so we permit outselves to jump over it, so that
-			// we can trigger an exception for anyone trying to jump to the middle of an instruction.
-			// It is technically possible to create an endless loop without this, as we are not
-			// counting instructions correctly for this case.
-			code.append("goto " + FUNCLABEL(this->pc() + 2) + "_skip;\n");
-			code.append(FUNCLABEL(this->pc() + 2) + ":;\n");
-			code.append("api.exception(cpu, " + STRADDR(this->pc() + 2) + ", MISALIGNED_INSTRUCTION); return (ReturnValues){0, 0};\n");
-			code.append(FUNCLABEL(this->pc() + 2) + "_skip:;\n");
-		}
+			// With garbage instructions, it's possible that someone is trying to jump to
+			// the middle of an instruction. This technically allowed, so we need to check
+			// there's a jump label in the middle of this instruction.
+			if (compressed_enabled && this->m_instr_length == 4 && tinfo.jump_locations.count(this->pc() + 2)) {
+				// This occurence should be very rare, so we permit outselves to jump over it, so that
+				// we can trigger an exception for anyone trying to jump to the middle of an instruction.
+				// It is technically possible to create an endless loop without this, as we are not
+				// counting instructions correctly for this case.
+				code.append("goto " + FUNCLABEL(this->pc() + 2) + "_skip;\n");
+				code.append(FUNCLABEL(this->pc() + 2) + ":;\n");
+				code.append("api.exception(cpu, " + STRADDR(this->pc() + 2) + ", MISALIGNED_INSTRUCTION); return (ReturnValues){0, 0};\n");
+				code.append(FUNCLABEL(this->pc() + 2) + "_skip:;\n");
+			}
 
-		auto it = tinfo.single_return_locations.find(this->pc());
-		if (it != tinfo.single_return_locations.end()) {
-			// We don't know what function we are in, but we do know what functions get called
-			// Track the current callable PC, so that we can use that for JALR return addresses
-			// If the address is zero, it means many places call this function, so we can't predict
-			// a single return address.
-			if (it->second != 0)
-				current_callable_pc = this->pc();
-			else
-				current_callable_pc = 0;
-		}
+			auto it = tinfo.single_return_locations.find(this->pc());
+			if (it != tinfo.single_return_locations.end()) {
+				// We don't know what function we are in, but we do know what functions get called
+				// Track the current callable PC, so that we can use that for JALR return addresses
+				// If the address is zero, it means many places call this function, so we can't predict
+				// a single return address.
+				if (it->second != 0)
+					current_callable_pc = this->pc();
+				else
+					current_callable_pc = 0;
+			}
+
+			this->m_instr_counter += 1;
 
-		this->m_instr_counter += 1;
+			if (tinfo.trace_instructions) {
+				char buffer[128];
+				const int len = snprintf(buffer, sizeof(buffer),
+					"api.trace(cpu, \"%s\", 0x%" PRIx64 ", 0x%X);\n",
+					this->func.c_str(), uint64_t(this->pc()), instr.whole);
+				code.append(buffer, len);
+			}
 
-		if (tinfo.trace_instructions) {
-			char buffer[128];
-			const int len = snprintf(buffer, sizeof(buffer),
-				"api.trace(cpu, \"%s\", 0x%" PRIx64 ", 0x%X);\n",
-				this->func.c_str(), uint64_t(this->pc()), instr.whole);
-			code.append(buffer, len);
+			if (tinfo.ebreak_locations->count(this->pc())) {
+				this->store_loaded_registers();
+				this->emit_system_call(std::to_string(SYSCALL_EBREAK));
+				this->reload_all_registers();
+				this->untrack_all_gprs();
+			}
 		}
 
-		if (tinfo.ebreak_locations->count(this->pc())) {
-			this->store_loaded_registers();
-			this->emit_system_call(std::to_string(SYSCALL_EBREAK));
-			this->reload_all_registers();
-			this->untrack_all_gprs();
+		// Try to coalesce the bounds-checks of the following memory accesses
+		if (!replay && window_begin < 0) {
+			const int end = this->find_coalescing_window(i);
+			if (end > i) {
+				window_begin = i;
+				window_end = end;
+				window_pc = this->pc();
+				window_icounter = this->m_instr_counter;
+				window_gpr_values = this->gpr_values;
+				this->emit_coalesced_range_check();
+			}
 		}
 
 		// instruction generation
@@ -889,7 +1217,7 @@ void Emitter<W>::emit()
 			this->untrack_gpr(instr.Itype.rd);
 			} else {
 				// We don't care about where we are in the page when rd=0
-				const auto temp = "tmp" + PCRELS(0);
+				const auto temp = "tmp" + hex_address(PCRELA(0));
 				add_code("uint8_t " + temp + ";");
 				this->memory_load<uint8_t>(temp, "volatile uint8_t", instr.Itype.rs1, instr.Itype.signed_imm());
 				add_code("(void)" + temp + ";");
@@ -1470,7 +1798,10 @@ void Emitter<W>::emit()
 				break;
 			add_code(
 				to_reg(instr.Utype.rd) + " = " + PCRELS(instr.Utype.upper_imm()) + ";");
-			this->track_gpr(instr.Utype.rd, this->pc() + instr.Utype.upper_imm());
+			if (!tinfo.relocatable)
+				this->track_gpr(instr.Utype.rd, this->pc() + instr.Utype.upper_imm());
+			else
+				this->untrack_gpr(instr.Utype.rd);
 			break;
 		case RV32I_FENCE:
 			break;
@@ -1508,6 +1839,9 @@ void Emitter<W>::emit()
 					this->untrack_all_gprs();
 					break;
 				}
+			} else if (this->emit_csr_access()) {
+				// Common CSR accesses and counter reads are emitted in-line
+				break;
 			} else {
 				// Non-zero funct3: CSR and other system functions
 				this->load_register(instr.Itype.rd);
@@ -1687,6 +2021,7 @@ void Emitter<W>::emit()
 #ifdef RISCV_EXT_VECTOR
 			case 0x6: { // VLE32
 				const rv32v_instruction vi { instr };
+				this->emit_vector_state();
 				this->memory_load<VectorLane>(from_rvvreg(vi.VLS.vd), "VectorLane", vi.VLS.rs1, 0);
 				break;
 			}
@@ -1708,6 +2043,7 @@ void Emitter<W>::emit()
 #ifdef RISCV_EXT_VECTOR
 			case 0x6: { // VSE32
 				const rv32v_instruction vi { instr };
+				this->emit_vector_state();
 				this->memory_store("VectorLane", vi.VLS.rs1, 0, from_rvvreg(vi.VLS.vd));
 				break;
 			}
@@ -1855,7 +2191,9 @@ void Emitter<W>::emit()
 					UNKNOWN_INSTRUCTION();
 				} break;
 			case RV32F__FCVT_SD_W: {
-				const std::string sign((fi.R4type.rs2 == 0x0) ? "(saddr_t)" : "");
+				// rs2 selects W, WU, L and LU
+				static const char* casts[4] = { "(int32_t)", "(uint32_t)", "(saddr_t)", "" };
+				const std::string sign(casts[fi.R4type.rs2 & 0x3]);
 				if (fi.R4type.funct2 == 0x0) {
 					code += "set_fl(&" + dst + ", " + sign + from_reg(fi.R4type.rs1) + ");\n";
 				} else if (fi.R4type.funct2 == 0x1) {
@@ -1865,7 +2203,8 @@ void Emitter<W>::emit()
 				}
 				} break;
 			case RV32F__FCVT_W_SD: {
-				const std::string sign((fi.R4type.rs2 == 0x0) ? "(int32_t)" : "(uint32_t)");
+				static const char* casts[4] = { "(int32_t)", "(saddr_t)(int32_t)(uint32_t)", "(int64_t)", "(uint64_t)" };
+				const std::string sign(casts[fi.R4type.rs2 & 0x3]);
 				if (fi.R4type.rd != 0 && fi.R4type.funct2 == 0x0) {
 					code += to_reg(fi.R4type.rd) + " = " + sign + rs1 + ".f32[0];\n";
 				} else if (fi.R4type.rd != 0 && fi.R4type.funct2 == 0x1) {
@@ -1918,6 +2257,7 @@ void Emitter<W>::emit()
 #ifdef RISCV_EXT_VECTOR
 			const rv32v_instruction vi{instr};
 			const unsigned vlen = RISCV_EXT_VECTOR / 4;
+			this->emit_vector_state();
 			switch (instr.vwidth()) {
 			case 0x1: // OPF.VV
 				switch (vi.OPVV.funct6)
@@ -1939,7 +2279,7 @@ void Emitter<W>::emit()
 				}
 				break;
 			case 0x5: { // OPF.VF
-				const std::string scalar = "scalar" + PCRELS(0);
+				const std::string scalar = "scalar" + hex_address(PCRELA(0));
 				switch (vi.OPVV.funct6)
 				{
 				case 0b000000: // VFADD.VF
@@ -2005,12 +2345,28 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 
 	// Create register push and pop macros
 	if (tinfo.use_register_caching) {
+		// FP registers are stored and loaded together with the GPRs
+		auto store_fpregs = [&] (size_t first, size_t last) {
+			for (size_t reg = first; reg < last; reg++) {
+				if (e.fpr_exists_at(reg)) {
+					code += "  cpu->fr[" + std::to_string(reg) + "] = " + e.loaded_fpregname(reg) + "; \\\n";
+				}
+			}
+		};
+		auto load_fpregs = [&] (size_t first, size_t last) {
+			for (size_t reg = first; reg < last; reg++) {
+				if (e.fpr_exists_at(reg)) {
+					code += "  " + e.loaded_fpregname(reg) + " = cpu->fr[" + std::to_string(reg) + "]; \\\n";
+				}
+			}
+		};
 		code += "#define STORE_REGS_" + e.get_func() + "() \\\n";
 		for (size_t reg = 1; reg < 32; reg++) {
 			if (e.gpr_exists_at(reg)) {
 				code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
 			}
 		}
+		store_fpregs(0, 32);
 		code += "  ;\n";
 		code += "#define LOAD_REGS_" + e.get_func() + "() \\\n";
 		for (size_t reg = 1; reg < 32; reg++) {
@@ -2018,6 +2374,7 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 				code += "  " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "]; \\\n";
 			}
 		}
+		load_fpregs(0, 32);
 		code += "  ;\n";
 		if (e.used_store_syscalls()) {
 			code += "#define STORE_SYS_REGS_" + e.get_func() + "() \\\n";
@@ -2026,6 +2383,7 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 					code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
 				}
 			}
+			store_fpregs(10, 18);
 			code += "  ;\n";
 			code += "#define STORE_NON_SYS_REGS_" + e.get_func() + "() \\\n";
 			for (size_t reg = 0; reg < 10; reg++) {
@@ -2038,6 +2396,8 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 					code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + "; \\\n";
 				}
 			}
+			store_fpregs(0, 10);
+			store_fpregs(18, 32);
 			code += "  ;\n";
 		}
 		code += "#define LOAD_SYS_REGS_" + e.get_func() + "() \\\n";
@@ -2046,16 +2406,29 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 				code += "  " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "]; \\\n";
 			}
 		}
+		load_fpregs(10, 12);
 		code += "  ;\n";
 	}
 
 	// Forward declarations
 	for (const auto& entry : e.get_forward_declared()) {
-		code += "static ReturnValues " + entry + "(CPU*, uint64_t, uint64_t, addr_t);\n";
+		if (tinfo.relocatable)
+			code += "static ReturnValues " + entry + "_r(CPU*, uint64_t, uint64_t, addr_t, addr_t);\n";
+		else
+			code += "static ReturnValues " + entry + "(CPU*, uint64_t, uint64_t, addr_t);\n";
 	}
 
 	// Function header
-	code += "static ReturnValues " + e.get_func() + "(CPU* cpu, uint64_t counter, uint64_t max_counter, addr_t pc) {\n";
+	if (tinfo.relocatable) {
+		// Entries from outside look up the segment base, calls between functions pass it on
+		const auto& func = e.get_func();
+		code += "static ReturnValues " + func + "_r(CPU*, uint64_t, uint64_t, addr_t, addr_t);\n";
+		code += "static ReturnValues " + func + "(CPU* cpu, uint64_t counter, uint64_t max_counter, addr_t pc) {\n"
+			"  return " + func + "_r(cpu, counter, max_counter, pc, api.segment_base(cpu));\n}\n";
+		code += "static ReturnValues " + func + "_r(CPU* cpu, uint64_t counter, uint64_t max_counter, addr_t pc, const addr_t segbase) {\n";
+	} else {
+		code += "static ReturnValues " + e.get_func() + "(CPU* cpu, uint64_t counter, uint64_t max_counter, addr_t pc) {\n";
+	}
 
 	// Function GPRs
 	if (tinfo.use_register_caching) {
@@ -2064,6 +2437,11 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 				code += "addr_t " + e.loaded_regname(reg) + " = cpu->r[" + std::to_string(reg) + "];\n";
 			}
 		}
+		for (size_t reg = 0; reg < 32; reg++) {
+			if (e.fpr_exists_at(reg)) {
+				code += "fp64reg " + e.loaded_fpregname(reg) + " = cpu->fr[" + std::to_string(reg) + "];\n";
+			}
+		}
 	}
 
 	code += e.get_func() + "_jumptbl:;\n";
@@ -2097,11 +2475,12 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 	code += "goto *jumptbl[(pc - " + str_begin_pc + ") >> 1];\n";
 	code += "dispatch: {\n";
 #else
-	code += "switch (pc) {\n";
+	const address_t base = tinfo.relocatable ? tinfo.segment_basepc : 0;
+	code += tinfo.relocatable ? "switch (pc - segbase) {\n" : "switch (pc) {\n";
 	for (size_t idx = 0; idx < e.get_mappings().size(); idx++) {
 		auto& entry = e.get_mappings().at(idx);
 		const auto label = funclabel<W>(e.get_func(), entry.addr);
-		code += "case " + hex_address(entry.addr) + ": goto " + label + ";\n";
+		code += "case " + hex_address(entry.addr - base) + ": goto " + label + ";\n";
 	}
 	code += "default:\n";
 #endif
@@ -2110,6 +2489,11 @@ CPU<W>::emit(std::string& code, const TransInfo<W>& tinfo)
 			code += "  cpu->r[" + std::to_string(reg) + "] = " + e.loaded_regname(reg) + ";\n";
 		}
 	}
+	for (size_t reg = 0; reg < 32; reg++) {
+		if (e.fpr_exists_at(reg)) {
+			code += "  cpu->fr[" + std::to_string(reg) + "] = " + e.loaded_fpregname(reg) + ";\n";
+		}
+	}
 	code += "  cpu->pc = pc; return (ReturnValues){counter, max_counter};\n";
 	code += "}\n";
 
@@ -56,7 +56,7 @@ namespace riscv
 	extern void* dylib_lookup(void* dylib, const char*, bool is_libtcc);
 
 	template <int W>
-	using binary_translation_init_func = void (*)(const CallbackTable<W>&, int32_t, int32_t, int32_t);
+	using binary_translation_init_func = void (*)(const CallbackTable<W>&, int32_t, int32_t, int32_t, int32_t);
 	template <int W>
 	static CallbackTable<W> create_bintr_callback_table(DecodedExecuteSegment<W>&);
 
@@ -139,6 +139,25 @@ inline DecoderData<W>& decoder_entry_at(DecoderData<W>* cache, address_type<W> a
 	return cache[addr / DecoderCache<W>::DIVISOR];
 }
 
+// Branches need this many samples, and to go the same way 7 out of 8 times
+static constexpr uint64_t BRANCH_HINT_MIN_SAMPLES = 64;
+
+template <int W>
+static std::unordered_map<address_type<W>, bool> biased_branches(const MachineOptions<W>& options)
+{
+	std::unordered_map<address_type<W>, bool> result;
+	for (auto& hint : options.translator_branch_hints) {
+		const uint64_t total = hint.taken + hint.not_taken;
+		if (total < BRANCH_HINT_MIN_SAMPLES)
+			continue;
+		if (hint.taken >= total - total / 8)
+			result.emplace(hint.pc, true);
+		else if (hint.taken <= total / 8)
+			result.emplace(hint.pc, false);
+	}
+	return result;
+}
+
 template <int W>
 static std::unordered_map<std::string, std::string> create_defines_for(const Machine<W>& machine, const MachineOptions<W>& options)
 {
@@ -153,6 +172,7 @@ static std::unordered_map<std::string, std::string> create_defines_for(const Mac
 	std::unordered_map<std::string, std::string> defines;
 	defines.emplace("RISCV_TRANSLATION_DYLIB", std::to_string(W));
 	defines.emplace("RISCV_MAX_SYSCALLS", std::to_string(RISCV_SYSCALLS_MAX));
+	defines.emplace("RISCV_TLB_ENTRIES", std::to_string(Memory<W>::TLB_ENTRIES));
 	if constexpr (W == 16) {
 		defines.emplace("RISCV_ARENA_END", std::to_string(uint64_t(arena_end)));
 		defines.emplace("RISCV_ARENA_ROEND", std::to_string(uint64_t(initial_rodata_end)));
@@ -177,9 +197,28 @@ static std::unordered_map<std::string, std::string> create_defines_for(const Mac
 		// so it will be recompiled if the trace option is toggled.
 		defines.emplace("RISCV_TRACING", "1");
 	}
+	if (options.translate_use_register_caching) {
+		// Cached and uncached translations must not be mixed up
+		defines.emplace("RISCV_REGISTER_CACHING", "1");
+	}
 	if constexpr (encompassing_Nbit_arena != 0) {
 		defines.emplace("RISCV_NBIT_UNBOUNDED", std::to_string(encompassing_Nbit_arena));
 	}
+	if (options.translate_relocatable) {
+		defines.emplace("RISCV_RELOCATABLE", "1");
+	}
+	if (!options.translator_branch_hints.empty()) {
+		// The biased branches change the translation, but not their exact counts
+		const auto biased = biased_branches(options);
+		std::vector<std::pair<address_type<W>, bool>> sorted(biased.begin(), biased.end());
+		std::sort(sorted.begin(), sorted.end());
+		uint32_t checksum = 0;
+		for (auto& branch : sorted) {
+			const uint64_t value = uint64_t(branch.first) * 2 + branch.second;
+			checksum = crc32c(checksum, &value, sizeof(value));
+		}
+		defines.emplace("RISCV_BRANCH_HINTS", std::to_string(checksum));
+	}
 	return defines;
 }
 
@@ -210,6 +249,11 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 	}
 	// Also add the compiler flags to the checksum
 	checksum = crc32c(checksum, cflags.c_str(), cflags.size());
+	// Guest PCs are baked into the translation, unless it is relocatable
+	if (!options.translate_relocatable) {
+		const uint64_t base = exec.exec_begin();
+		checksum = crc32c(checksum, &base, sizeof(base));
+	}
 	exec.set_translation_hash(checksum);
 
 	if (options.translate_timing) {
@@ -218,7 +262,8 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 	}
 
 	// Check if translation is registered
-	if (options.translate_enable_embedded)
+	// JIT segments are already decoded, and can only be live-patched
+	if (options.translate_enable_embedded && !exec.is_likely_jit())
 	{
 		TIME_POINT(t6);
 
@@ -234,9 +279,10 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 				const int32_t ins_counter_offset = uintptr_t(&counters.first) - uintptr_t(&m);
 				const int32_t max_counter_offset = uintptr_t(&counters.second) - uintptr_t(&m);
 				const int32_t arena_offset = uintptr_t(&machine().memory.memory_arena_ptr_ref()) - uintptr_t(&m);
+				const int32_t tlb_offset = uintptr_t(&machine().memory.translator_tlb()) - uintptr_t(&m);
 
 				translation.init_func(create_bintr_callback_table(exec),
-					arena_offset, ins_counter_offset, max_counter_offset);
+					arena_offset, ins_counter_offset, max_counter_offset, tlb_offset);
 
 				if (options.verbose_loader) {
 					printf("libriscv: Found embedded translation for hash %08X, %u/%u mappings\n",
@@ -247,10 +293,11 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 				std::copy(translation.handlers, translation.handlers + translation.nhandlers, mappings.begin());
 
 				const uint8_t bytecode = RV32I_BC_TRANSLATOR;
+				const address_t mapping_base = options.translate_relocatable ? exec.exec_begin() : 0;
 				for (unsigned i = 0; i < translation.nmappings; i++) {
 					const auto& mapping = translation.mappings[i];
 
-					auto& entry = decoder_entry_at(exec.decoder_cache(), mapping.addr);
+					auto& entry = decoder_entry_at(exec.decoder_cache(), mapping_base + mapping.addr);
 					entry.set_bytecode(bytecode);
 					entry.set_invalid_handler();
 					entry.instr = mapping.mapping_index;
@@ -338,7 +385,7 @@ int CPU<W>::load_translation(const MachineOptions<W>& options,
 		return 1;
 	}
 
-	this->activate_dylib(options, exec, dylib, machine(), false, false);
+	this->activate_dylib(options, exec, dylib, machine(), false, exec.is_likely_jit());
 
 	if (options.translate_timing) {
 		TIME_POINT(t10);
@@ -437,6 +484,9 @@ if constexpr (SCAN_FOR_GP) {
 		printf(">> GP scan took %ld ns, GP=0x%lX\n", nanodiff(output.t0, t1), (long)gp);
 	}
 } // SCAN_FOR_GP
+	// A GP derived from AUIPC is only known relative to the segment base
+	if (options.translate_relocatable)
+		gp = 0;
 
 	// EBREAK locations
 	std::unordered_set<address_type<W>> ebreak_locations;
@@ -454,6 +504,12 @@ if constexpr (SCAN_FOR_GP) {
 		}
 	}
 
+	// Strongly biased branches from a recorded branch profile
+	const auto branch_hints = biased_branches(options);
+	if (verbose && !branch_hints.empty()) {
+		printf("libriscv: Binary translator has %zu biased branch hints\n", branch_hints.size());
+	}
+
 	// Code block and loop detection
 	TIME_POINT(t2);
 	static constexpr size_t ITS_TIME_TO_SPLIT = (libtcc_enabled) ? 150'000 : 1'250;
@@ -599,10 +655,12 @@ if constexpr (SCAN_FOR_GP) {
 				options.use_shared_execute_segments,
 				options.translate_use_register_caching,
 				options.translate_automatic_nbit_address_space,
+				options.translate_relocatable,
 				std::move(jump_locations),
 				std::move(single_return_locations),
 				nullptr, // blocks
 				&ebreak_locations,
+				&branch_hints,
 				global_jump_locations,
 				// Memory arena
 				arena_ponter_ref,
@@ -654,6 +712,8 @@ VISIBLE const struct Mapping mappings[] = {
 	std::unordered_map<std::string, unsigned> mapping_indices;
 	std::vector<const std::string*> handlers;
 	handlers.reserve(blocks.size());
+	// Relocatable mappings are relative to the segment base
+	const address_t mapping_base = options.translate_relocatable ? basepc : 0;
 
 	for (const auto& mapping : dlmappings)
 	{
@@ -671,7 +731,7 @@ VISIBLE const struct Mapping mappings[] = {
 		char buffer[128];
 		snprintf(buffer, sizeof(buffer), 
 			"{0x%lX, %u},\n",
-			(long)mapping.addr, mapping_index);
+			(long)(mapping.addr - mapping_base), mapping_index);
 		footer.append(buffer);
 	}
 	footer += "};\nVISIBLE const uint32_t no_handlers = "
@@ -740,6 +800,7 @@ static REGISTRATION_ATTR void register_translation() {
 
 	std::unordered_map<std::string, unsigned> mapping_indices;
 	std::vector<const std::string*> handlers;
+	const address_t mapping_base = options.translate_relocatable ? exec.exec_begin() : 0;
 
 	for (const auto& mapping : output.mappings)
 	{
@@ -757,7 +818,7 @@ static REGISTRATION_ATTR void register_translation() {
 		char buffer[128];
 		snprintf(buffer, sizeof(buffer), 
 			"{0x%lX, %u},\n",
-			(long)mapping.addr, mapping_index);
+			(long)(mapping.addr - mapping_base), mapping_index);
 		embed_code << buffer;
 	}
 	embed_code << "    };\n"
@@ -819,7 +880,8 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 	output.t0 = t0;
 
 	output.defines = create_defines_for(machine(), options);
-	const bool live_patch = options.translate_background_callback != nullptr;
+	// JIT segments are translated after decoding, so they must be live-patched
+	const bool live_patch = options.translate_background_callback != nullptr || shared_segment->is_likely_jit();
 
 	// Compilation step
 	std::function<void()> compilation_step =
@@ -916,6 +978,33 @@ void CPU<W>::try_translate(const MachineOptions<W>& options, const std::string&
 	}
 }
 
+template <int W>
+void CPU<W>::translate_jit_segment(DecodedExecuteSegment<W>& exec)
+{
+	const auto& options = machine().options();
+	auto& shared_segment = machine().memory.exec_segment_for(exec.exec_begin());
+	if (shared_segment.get() != &exec || exec.is_binary_translated() || !options.translate_future_segments)
+		return;
+
+	// Only translate code that has not been rewritten since it was decoded
+	for (address_t addr = exec.exec_begin(); addr < exec.exec_end(); addr += Page::size()) {
+		const auto& page = machine().memory.get_pageno(addr / Page::size());
+		const size_t len = std::min(address_t(Page::size()), address_t(exec.exec_end() - addr));
+		if (std::memcmp(page.data(), exec.exec_data(addr), len) != 0) {
+			exec.set_stale(true);
+			return;
+		}
+	}
+
+	if (options.verbose_loader) {
+		printf("libriscv: Translating JIT segment 0x%lX-0x%lX\n",
+			(long)exec.exec_begin(), (long)exec.exec_end());
+	}
+	std::string filename;
+	if (this->load_translation(options, &filename, exec) > 0)
+		this->try_translate(options, filename, shared_segment);
+}
+
 template <int W>
 void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegment<W>& exec, void* dylib, const Machine<W>& machine, bool is_libtcc, bool live_patch)
 {
@@ -969,6 +1058,7 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 	std::unordered_map<bintr_block_func<W>, unsigned> block_indices;
 	const unsigned nmappings = *no_mappings;
 	const unsigned unique_mappings = *no_handlers;
+	const address_t mapping_base = options.translate_relocatable ? exec.exec_begin() : 0;
 
 	// Create N+1 mappings, where the last one is a catch-all for invalid mappings
 	auto& exec_mappings = exec.create_mappings(unique_mappings + 1);
@@ -984,7 +1074,7 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 	for (unsigned i = 0; i < nmappings; i++)
 	{
 		const unsigned mapping_index = mappings[i].mapping_index;
-		const auto addr = mappings[i].addr;
+		const address_t addr = mapping_base + mappings[i].addr;
 
 		if (exec.is_within(addr)) {
 			auto* handler = handlers[mapping_index];
@@ -1088,57 +1178,65 @@ void CPU<W>::activate_dylib(const MachineOptions<W>& options, DecodedExecuteSegm
 	}
 }
 
+template <int W>
+static address_type<W> bintr_memory_read(Memory<W>& mem, address_type<W> addr, unsigned size)
+{
+	switch (size) {
+	case 1: return mem.template read<uint8_t>(addr);
+	case 2: return mem.template read<uint16_t>(addr);
+	case 4: return mem.template read<uint32_t>(addr);
+	case 8: return mem.template read<uint64_t>(addr);
+	default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory read size", size);
+	}
+}
+
+template <int W>
+static void bintr_memory_write(Memory<W>& mem, address_type<W> addr, address_type<W> value, unsigned size)
+{
+	switch (size) {
+	case 1: mem.template write<uint8_t>(addr, value); break;
+	case 2: mem.template write<uint16_t>(addr, value); break;
+	case 4: mem.template write<uint32_t>(addr, value); break;
+	case 8: mem.template write<uint64_t>(addr, value); break;
+	default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory write size", size);
+	}
+}
+
 template <int W>
 CallbackTable<W> create_bintr_callback_table(DecodedExecuteSegment<W>&)
 {
 	return CallbackTable<W>{
 		.mem_read = [] (CPU<W>& cpu, address_type<W> addr, unsigned size) -> address_type<W> {
+			auto& mem = cpu.machine().memory;
 			if constexpr (libtcc_enabled) {
 				try {
-					switch (size) {
-					case 1: return cpu.machine().memory.template read<uint8_t>(addr);
-					case 2: return cpu.machine().memory.template read<uint16_t>(addr);
-					case 4: return cpu.machine().memory.template read<uint32_t>(addr);
-					case 8: return cpu.machine().memory.template read<uint64_t>(addr);
-					default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory read size", size);
-					}
+					const auto value = bintr_memory_read(mem, addr, size);
+					mem.translator_tlb_fill(addr, false);
+					return value;
 				} catch (...) {
 					cpu.set_current_exception(std::current_exception());
 					cpu.machine().stop();
 					return 0;
 				}
 			} else {
-				switch (size) {
-				case 1: return cpu.machine().memory.template read<uint8_t>(addr);
-				case 2: return cpu.machine().memory.template read<uint16_t>(addr);
-				case 4: return cpu.machine().memory.template read<uint32_t>(addr);
-				case 8: return cpu.machine().memory.template read<uint64_t>(addr);
-				default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory read size", size);
-				}
+				const auto value = bintr_memory_read(mem, addr, size);
+				mem.translator_tlb_fill(addr, false);
+				return value;
 			}
 		},
 		.mem_write = [] (CPU<W>& cpu, address_type<W> addr, address_type<W> value, unsigned size) -> void {
+			auto& mem = cpu.machine().memory;
 			if constexpr (libtcc_enabled) {
 				try {
-					switch (size) {
-					case 1: cpu.machine().memory.template write<uint8_t>(addr, value); break;
-					case 2: cpu.machine().memory.template write<uint16_t>(addr, value); break;
-					case 4: cpu.machine().memory.template write<uint32_t>(addr, value); break;
-					case 8: cpu.machine().memory.template write<uint64_t>(addr, value); break;
-					default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory write size", size);
-					}
+					bintr_memory_write(mem, addr, value, size);
+					mem.translator_tlb_fill(addr, true);
 				} catch (...) {
 					cpu.set_current_exception(std::current_exception());
 					cpu.machine().stop();
 				}
 			} else {
-				switch (size) {
-				case 1: cpu.machine().memory.template write<uint8_t>(addr, value); break;
-				case 2: cpu.machine().memory.template write<uint16_t>(addr, value); break;
-				case 4: cpu.machine().memory.template write<uint32_t>(addr, value); break;
-				case 8: cpu.machine().memory.template write<uint64_t>(addr, value); break;
-				default: throw MachineException(ILLEGAL_OPERATION, "Invalid memory write size", size);
-				}
+				bintr_memory_write(mem, addr, value, size);
+				mem.translator_tlb_fill(addr, true);
 			}
 		},
 		.vec_load = [] (CPU<W>& cpu, int vd, address_type<W> addr) {
@@ -1159,16 +1257,24 @@ CallbackTable<W> create_bintr_callback_table(DecodedExecuteSegment<W>&)
 		},
 		.syscalls = Machine<W>::syscall_handlers.data(),
 		.system_call = [] (CPU<W>& cpu, int sysno) -> int {
-			try {
-				const auto current_tp = cpu.reg(REG_TP);
-				const auto current_pc = cpu.registers().pc;
+			const auto current_tp = cpu.reg(REG_TP);
+			const auto current_pc = cpu.registers().pc;
+			if (libtcc_enabled && cpu.current_execute_segment().is_libtcc()) {
+				try {
+					cpu.machine().system_call(sysno);
+				} catch (...) {
+					cpu.set_current_exception(std::current_exception());
+					cpu.machine().stop();
+					return false;
+				}
+			} else {
+				// Handlers run with fault landing suspended (see system_call)
 				cpu.machine().system_call(sysno);
-				return cpu.registers().pc != current_pc || cpu.reg(REG_TP) != current_tp || cpu.machine().stopped();
-			} catch (...) {
-				cpu.set_current_exception(std::current_exception());
-				cpu.machine().stop();
-				return false;
 			}
+			// Handlers may also stop the machine, or exhaust its instruction budget
+			auto& machine = cpu.machine();
+			return cpu.registers().pc != current_pc || cpu.reg(REG_TP) != current_tp
+				|| machine.instruction_counter() >= machine.max_instructions();
 		},
 		.unknown_syscall = [] (CPU<W>& cpu, address_type<W> sysno) {
 			cpu.machine().on_unhandled_syscall(cpu.machine(), sysno);
@@ -1280,6 +1386,16 @@ CallbackTable<W> create_bintr_callback_table(DecodedExecuteSegment<W>&)
 			return std::popcount(x);
 #else
 			return __builtin_popcountl(x);
+#endif
+		},
+		.segment_base = [] (CPU<W>& cpu) -> address_type<W> {
+			return cpu.current_execute_segment().exec_begin();
+		},
+		.vec_allocate = [] (CPU<W>& cpu) {
+#ifdef RISCV_EXT_VECTOR
+			cpu.registers().rvv();
+#else
+			(void)cpu;
 #endif
 		},
 	};
@@ -1303,8 +1419,9 @@ bool CPU<W>::initialize_translated_segment(DecodedExecuteSegment<W>& exec, void*
 	const int32_t ins_counter_offset = uintptr_t(&counters.first) - uintptr_t(&machine);
 	const int32_t max_counter_offset = uintptr_t(&counters.second) - uintptr_t(&machine);
 	const int32_t arena_offset = uintptr_t(&machine.memory.memory_arena_ptr_ref()) - uintptr_t(&machine);
+	const int32_t tlb_offset = uintptr_t(&machine.memory.translator_tlb()) - uintptr_t(&machine);
 
-	func(create_bintr_callback_table<W>(exec), arena_offset, ins_counter_offset, max_counter_offset);
+	func(create_bintr_callback_table<W>(exec), arena_offset, ins_counter_offset, max_counter_offset, tlb_offset);
 
 	return true;
 }
@@ -1321,16 +1438,19 @@ std::string MachineOptions<W>::translation_filename(const std::string& prefix, u
 #ifdef RISCV_32I
 	template void CPU<4>::try_translate(const MachineOptions<4>&, const std::string&, std::shared_ptr<DecodedExecuteSegment<4>>&) const;
 	template int CPU<4>::load_translation(const MachineOptions<4>&, std::string*, DecodedExecuteSegment<4>&) const;
+	template void CPU<4>::translate_jit_segment(DecodedExecuteSegment<4>&);
 	template std::string MachineOptions<4>::translation_filename(const std::string&, uint32_t, const std::string&);
 #endif
 #ifdef RISCV_64I
 	template void CPU<8>::try_translate(const MachineOptions<8>&, const std::string&, std::shared_ptr<DecodedExecuteSegment<8>>&) const;
 	template int CPU<8>::load_translation(const MachineOptions<8>&, std::string*, DecodedExecuteSegment<8>&) const;
+	template void CPU<8>::translate_jit_segment(DecodedExecuteSegment<8>&);
 	template std::string MachineOptions<8>::translation_filename(const std::string&, uint32_t, const std::string&);
 #endif
 #ifdef RISCV_128I
 	template void CPU<16>::try_translate(const MachineOptions<16>&, const std::string&, std::shared_ptr<DecodedExecuteSegment<16>>&) const;
 	template int CPU<16>::load_translation(const MachineOptions<16>&, std::string*, DecodedExecuteSegment<16>&) const;
+	template void CPU<16>::translate_jit_segment(DecodedExecuteSegment<16>&);
 	template std::string MachineOptions<16>::translation_filename(const std::string&, uint32_t, const std::string&);
 #endif
 
@@ -32,12 +32,15 @@ namespace riscv
 		bool use_shared_execute_segments;
 		bool use_register_caching;
 		bool use_automatic_nbit_address_space;
+		bool relocatable;
 		std::unordered_set<address_type<W>> jump_locations;
 		std::unordered_map<address_type<W>, address_type<W>> single_return_locations;
 		// Pointer to all the other blocks (including current)
 		std::vector<TransInfo<W>>* blocks = nullptr;
 		// Pointer to list of ebreak-locations
 		const std::unordered_set<address_type<W>>* ebreak_locations = nullptr;
+		// Pointer to strongly biased branches (true when likely taken)
+		const std::unordered_map<address_type<W>, bool>* branch_hints = nullptr;
 
 		std::unordered_set<address_type<W>>& global_jump_locations;
 
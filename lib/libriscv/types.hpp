@@ -44,6 +44,7 @@ namespace riscv
 		INVALID_PROGRAM,
 		SYSTEM_CALL_FAILED,
 		EXECUTION_LOOP_DETECTED,
+		RESOURCE_LIMIT_REACHED,
 		UNKNOWN_EXCEPTION
 	};
 
@@ -81,6 +82,20 @@ namespace riscv
 		using MachineException::MachineException;
 	};
 
+	/// The exception-free counterpart to MachineException, as recorded
+	/// by try_simulate(), try_vmcall() and try_preempt().
+	struct MachineFault {
+		int         type = 0;
+		const char* message = nullptr;
+		uint64_t    data = 0;
+	};
+
+	enum machine_status {
+		MACHINE_STOPPED = 0, // Stopped normally
+		MACHINE_TIMEOUT,     // Instruction limit reached
+		MACHINE_FAULT,       // See Machine::fault()
+	};
+
 	enum trapmode {
 		TRAP_READ  = 0x0,
 		TRAP_WRITE = 0x1000,
@@ -289,7 +289,7 @@ static void syscall_openat(Machine<W> &machine) {
 	if (machine.has_file_descriptors() && machine.fds().permit_filesystem) {
 
 		if (machine.fds().filter_open != nullptr) {
-			if (!machine.fds().filter_open(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_open(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -426,7 +426,7 @@ void syscall_readlinkat(Machine<W> &machine) {
 
 		if (machine.fds().filter_readlink != nullptr) {
 			std::string path = original_path;
-			if (!machine.fds().filter_readlink(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_readlink(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -575,7 +575,7 @@ static void syscall_statx(Machine<W> &machine) {
 
 	if (machine.has_file_descriptors()) {
 		if (machine.fds().filter_stat != nullptr) {
-			if (!machine.fds().filter_stat(machine.template get_userdata<void>(), path)) {
+			if (!machine.fds().apply_filter_stat(machine.template get_userdata<void>(), path)) {
 				machine.set_result(-EPERM);
 				return;
 			}
@@ -791,6 +791,7 @@ void Machine<W>::setup_linux_syscalls(bool filesystem, bool sockets) {
 
 	if (filesystem || sockets) {
 		m_fds.reset(new FileDescriptors);
+		m_fds->max_descriptors = m_limits.file_descriptors;
 		if (sockets)
 			add_socket_syscalls(*this);
 	}
@@ -822,5 +823,12 @@ FileDescriptors::~FileDescriptors() {
 		}
 	}
 }
+void FileDescriptors::close_real(real_fd_type fd, bool socket) {
+	if (socket) {
+		closesocket(fd);
+	} else {
+		_close(fd);
+	}
+}
 
 } // riscv
@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <libriscv/machine.hpp>
+#include <libriscv/decoder_cache.hpp>
+#include <array>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static constexpr uint64_t JIT_AREA = 0x200000;
+static constexpr uint32_t ADDI_A0_1 = 0x00150513;
+static constexpr uint32_t ADDI_A0_2 = 0x00250513;
+using Segment = DecodedExecuteSegment<RISCV64>;
+using Family  = ExecuteSegmentFamily<RISCV64>;
+
+// A page-sized segment filled with the given instruction
+static std::shared_ptr<Segment> make_segment(uint64_t addr, uint32_t instr)
+{
+	auto segment = std::make_shared<Segment>(addr, Page::size(), addr, Page::size());
+	auto* data = (uint32_t *)segment->exec_data(addr);
+	std::fill(data, data + Page::size() / 4, instr);
+	return segment;
+}
+
+static bool found(const Family& family, const std::shared_ptr<Segment>& segment)
+{
+	const auto addr = segment->exec_begin();
+	return family.find(addr, segment->exec_data(addr),
+		segment->exec_end() - addr, false, false) == segment;
+}
+
+TEST_CASE("Execute segments are shared within a fork family", "[ExecSegments]")
+{
+	Machine<RISCV64> machine { empty };
+	std::array<uint32_t, 4> code;
+	code.fill(ADDI_A0_1);
+
+	Machine<RISCV64> fork1 { machine };
+	auto& segment = fork1.cpu.init_execute_area(code.data(), JIT_AREA, sizeof(code), true);
+	// A sibling fork finds the same segment
+	Machine<RISCV64> fork2 { machine };
+	REQUIRE(&fork2.cpu.init_execute_area(code.data(), JIT_AREA, sizeof(code), true) == &segment);
+
+	// After invalidation the stale segment is never found again,
+	// and the rewritten code gets a segment of its own
+	fork1.memory.invalidate_jit_segments(JIT_AREA, sizeof(code));
+	REQUIRE(segment.is_stale());
+	code.fill(ADDI_A0_2);
+	Machine<RISCV64> fork3 { machine };
+	auto& rewritten = fork3.cpu.init_execute_area(code.data(), JIT_AREA, sizeof(code), true);
+	REQUIRE(&rewritten != &segment);
+	REQUIRE(!rewritten.is_stale());
+	REQUIRE(&fork2.cpu.init_execute_area(code.data(), JIT_AREA, sizeof(code), true) == &rewritten);
+}
+
+TEST_CASE("Full execute segment families reuse dead slots", "[ExecSegments]")
+{
+	Family family { 0 };
+	std::vector<std::shared_ptr<Segment>> segments;
+	for (size_t i = 0; i < Family::MAX_SEGMENTS; i++) {
+		segments.push_back(make_segment(JIT_AREA + i * Page::size(), ADDI_A0_1));
+		family.publish(segments.back());
+	}
+	REQUIRE(family.size() == Family::MAX_SEGMENTS);
+
+	// While every segment is in use, there is no room for more
+	auto extra = make_segment(JIT_AREA + Family::MAX_SEGMENTS * Page::size(), ADDI_A0_1);
+	family.publish(extra);
+	REQUIRE(!found(family, extra));
+
+	// A stale segment is replaced
+	segments[3]->set_stale(true);
+	family.publish(extra);
+	REQUIRE(found(family, extra));
+
+	// So is a segment that only the family refers to
+	std::weak_ptr<Segment> unused = segments[5];
+	segments[5] = nullptr;
+	auto other = make_segment(JIT_AREA, ADDI_A0_2);
+	family.publish(other);
+	REQUIRE(found(family, other));
+	REQUIRE(unused.expired());
+
+	// Everything else is still found
+	REQUIRE(family.size() == Family::MAX_SEGMENTS);
+	REQUIRE(found(family, segments[0]));
+	REQUIRE(found(family, segments.back()));
+}
@@ -0,0 +1,176 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <libriscv/rv32i_instr.hpp>
+#include <cmath>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static const uint64_t MAX_INSTRUCTIONS = 10'000ul;
+static constexpr uint64_t CODE = 0x2000;
+static constexpr uint64_t DATA = 0x4000;
+
+static constexpr uint32_t ECALL = 0x00000073;
+static constexpr uint32_t RM_DYN = 7;
+static constexpr uint32_t RM_RTZ = 1;
+static constexpr uint32_t FD = 8;  // FP destination
+static constexpr uint32_t RD = 28; // Integer destination
+
+static uint32_t fp_op(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t rm, uint32_t rd) {
+	return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (rm << 12) | (rd << 7) | 0x53;
+}
+static uint32_t amo_op(uint32_t funct5, uint32_t rs2, uint32_t rs1, uint32_t width, uint32_t rd) {
+	return (funct5 << 27) | (rs2 << 20) | (rs1 << 15) | (width << 12) | (rd << 7) | 0x2F;
+}
+
+static void init_machine(Machine<RISCV64>& machine)
+{
+	machine.memory.set_page_attr(DATA, Page::size(), {.read = true, .write = true});
+	machine.memory.write<uint64_t>(DATA + 0, 0x8000000012345678);
+	machine.memory.write<uint64_t>(DATA + 8, 0x00000000FFFFFFFF);
+
+	auto& regs = machine.cpu.registers();
+	regs.get(5)  = -7;
+	regs.get(6)  = 123456789;
+	regs.get(7)  = 1ull << 40;
+	regs.get(10) = DATA;
+	regs.get(11) = 0x1111;
+	regs.get(12) = -1;
+	regs.get(13) = DATA + 8;
+	regs.get(17) = 93; // exit
+	// Single-precision values
+	regs.getfl(0).set_float(1.5f);
+	regs.getfl(1).set_float(-2.25f);
+	regs.getfl(2).set_float(NAN);
+	regs.getfl(3).set_float(-0.0f);
+	// Double-precision values
+	regs.getfl(4).set_double(3e9);
+	regs.getfl(5).set_double(-1.75);
+	regs.getfl(6).set_double(NAN);
+	regs.getfl(7).set_double(-0.0);
+}
+
+// Run the instructions in the dispatch (where they become dedicated
+// bytecodes), and again one by one through the instruction handlers
+// (the slow-path), and require the same registers and memory.
+static void compare_with_slowpath(const std::vector<uint32_t>& instructions)
+{
+	std::vector<uint32_t> code = instructions;
+	code.push_back(ECALL);
+
+	Machine<RISCV64> fast { empty };
+	Machine<RISCV64>::setup_minimal_syscalls();
+	init_machine(fast);
+	fast.memory.set_page_attr(CODE, Page::size(), {.read = true, .exec = true});
+	fast.cpu.init_execute_area(code.data(), CODE, code.size() * 4);
+	fast.cpu.jump(CODE);
+	// Stops normally at the exit system call
+	fast.simulate(MAX_INSTRUCTIONS);
+
+	Machine<RISCV64> slow { empty };
+	init_machine(slow);
+	for (const uint32_t instr : instructions)
+		slow.cpu.execute(rv32i_instruction{instr});
+
+	for (int i = 1; i < 32; i++) {
+		INFO("x" << i);
+		REQUIRE(fast.cpu.reg(i) == slow.cpu.reg(i));
+	}
+	for (int i = 0; i < 32; i++) {
+		INFO("f" << i);
+		REQUIRE(fast.cpu.registers().getfl(i).i64 == slow.cpu.registers().getfl(i).i64);
+	}
+	REQUIRE(fast.memory.read<uint64_t>(DATA + 0) == slow.memory.read<uint64_t>(DATA + 0));
+	REQUIRE(fast.memory.read<uint64_t>(DATA + 8) == slow.memory.read<uint64_t>(DATA + 8));
+}
+
+TEST_CASE("FP sign-injection, min/max and compare bytecodes", "[Bytecodes]")
+{
+	// funct7 for single-precision, double-precision is funct7 + 1
+	static constexpr uint32_t FSGNJ = 0x10, FMINMAX = 0x14, FCMP = 0x50;
+	const std::array<uint32_t, 4> singles { 0, 1, 2, 3 };
+	const std::array<uint32_t, 4> doubles { 4, 5, 6, 7 };
+
+	for (uint32_t width = 0; width < 2; width++)
+	for (const uint32_t rs1 : (width == 0) ? singles : doubles)
+	for (const uint32_t rs2 : (width == 0) ? singles : doubles)
+	{
+		for (uint32_t funct3 = 0; funct3 < 3; funct3++) {
+			compare_with_slowpath({ fp_op(FSGNJ + width, rs2, rs1, funct3, FD) });
+			compare_with_slowpath({ fp_op(FCMP + width, rs2, rs1, funct3, RD) });
+		}
+		for (uint32_t funct3 = 0; funct3 < 2; funct3++)
+			compare_with_slowpath({ fp_op(FMINMAX + width, rs2, rs1, funct3, FD) });
+	}
+	// Moves are sign-injections with rs1 == rs2
+	compare_with_slowpath({ fp_op(FSGNJ, 1, 1, 0, 1) });
+	compare_with_slowpath({ fp_op(FSGNJ + 1, 5, 5, 1, 5) });
+}
+
+TEST_CASE("FP convert and move bytecodes", "[Bytecodes]")
+{
+	static constexpr uint32_t FCVT_S_D = 0x20, FCVT_D_S = 0x21;
+	static constexpr uint32_t FCVT_W_S = 0x60, FCVT_S_W = 0x68;
+	static constexpr uint32_t FMV_X_W = 0x70, FMV_W_X = 0x78;
+	static constexpr uint32_t W = 0, WU = 1, L = 2, LU = 3;
+
+	// Between float widths
+	for (const uint32_t rs1 : {4, 5, 7})
+		compare_with_slowpath({ fp_op(FCVT_S_D, 1, rs1, RM_DYN, FD) });
+	for (const uint32_t rs1 : {0, 1, 3})
+		compare_with_slowpath({ fp_op(FCVT_D_S, 0, rs1, RM_DYN, FD) });
+
+	// From float to integer, with values that are in range
+	for (const uint32_t type : {W, L}) {
+		for (const uint32_t rs1 : {0, 1, 3})
+			compare_with_slowpath({ fp_op(FCVT_W_S, type, rs1, RM_RTZ, RD) });
+		for (const uint32_t rs1 : {5, 7})
+			compare_with_slowpath({ fp_op(FCVT_W_S + 1, type, rs1, RM_RTZ, RD) });
+	}
+	for (const uint32_t type : {WU, LU}) {
+		compare_with_slowpath({ fp_op(FCVT_W_S, type, 0, RM_RTZ, RD) });
+		compare_with_slowpath({ fp_op(FCVT_W_S + 1, type, 4, RM_RTZ, RD) });
+	}
+
+	// From integer to float
+	for (const uint32_t type : {W, WU, L, LU})
+	for (const uint32_t rs1 : {5, 6, 7})
+	{
+		compare_with_slowpath({ fp_op(FCVT_S_W, type, rs1, RM_DYN, FD) });
+		compare_with_slowpath({ fp_op(FCVT_S_W + 1, type, rs1, RM_DYN, FD) });
+	}
+
+	// Raw moves between register files
+	for (const uint32_t rs1 : {0, 1, 2})
+		compare_with_slowpath({ fp_op(FMV_X_W, 0, rs1, 0, RD) });
+	for (const uint32_t rs1 : {4, 5, 6})
+		compare_with_slowpath({ fp_op(FMV_X_W + 1, 0, rs1, 0, RD) });
+	for (const uint32_t rs1 : {5, 6, 12}) {
+		compare_with_slowpath({ fp_op(FMV_W_X, 0, rs1, 0, FD) });
+		compare_with_slowpath({ fp_op(FMV_W_X + 1, 0, rs1, 0, FD) });
+	}
+}
+
+TEST_CASE("LR/SC and AMO bytecodes", "[Bytecodes]")
+{
+	static constexpr uint32_t AMOADD = 0x00, AMOSWAP = 0x01, LR = 0x02, SC = 0x03;
+
+	for (const uint32_t width : {2, 3}) // W and D
+	{
+		// Successful and failed store-conditionals
+		compare_with_slowpath({ amo_op(LR, 0, 10, width, RD), amo_op(SC, 11, 10, width, 29) });
+		compare_with_slowpath({ amo_op(SC, 11, 10, width, 29) });
+		compare_with_slowpath({ amo_op(LR, 0, 13, width, RD), amo_op(SC, 11, 10, width, 29) });
+		// Loads sign-extend 32-bit values
+		compare_with_slowpath({ amo_op(LR, 0, 13, width, RD) });
+
+		for (const uint32_t rs2 : {5, 11, 12}) {
+			compare_with_slowpath({ amo_op(AMOADD, rs2, 10, width, RD) });
+			compare_with_slowpath({ amo_op(AMOSWAP, rs2, 13, width, RD) });
+			// rd == x0 discards the old value
+			compare_with_slowpath({ amo_op(AMOADD, rs2, 13, width, 0) });
+		}
+		// rd == rs2
+		compare_with_slowpath({ amo_op(AMOSWAP, 11, 10, width, 11) });
+	}
+}
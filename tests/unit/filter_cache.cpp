@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <fcntl.h>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static constexpr uint64_t V = 0x40000;
+static constexpr int SYSCALL_OPENAT = 56;
+
+static int guest_open(Machine<RISCV64>& machine, const std::string& path)
+{
+	machine.memory.memcpy(V, path.c_str(), path.size() + 1);
+	machine.cpu.reg(REG_ARG0) = AT_FDCWD;
+	machine.cpu.reg(REG_ARG1) = V;
+	machine.cpu.reg(REG_ARG2) = O_RDONLY;
+	machine.system_call(SYSCALL_OPENAT);
+	return machine.return_value<int>();
+}
+
+static void setup_filtered_machine(Machine<RISCV64>& machine, int& calls)
+{
+	machine.setup_linux_syscalls();
+	machine.fds().permit_filesystem = true;
+	machine.fds().filter_open = [&calls] (void*, std::string& path) {
+		calls++;
+		if (path == "/rewrite") {
+			path = "/dev/null";
+			return true;
+		}
+		return path == "/dev/null";
+	};
+}
+
+TEST_CASE("Filter decisions are cached", "[FilterCache]")
+{
+	Machine<RISCV64> machine { empty };
+	int calls = 0;
+	setup_filtered_machine(machine, calls);
+	auto cache = std::make_shared<FileDescriptors::FilterCache>();
+	machine.fds().filter_cache = cache;
+
+	// Rewritten paths are cached
+	REQUIRE(guest_open(machine, "/rewrite") >= 0);
+	REQUIRE(guest_open(machine, "/rewrite") >= 0);
+	REQUIRE(calls == 1);
+	// Denials are cached
+	REQUIRE(guest_open(machine, "/secret") == -EPERM);
+	REQUIRE(guest_open(machine, "/secret") == -EPERM);
+	REQUIRE(calls == 2);
+	REQUIRE(cache->size() == 2);
+
+	// Each filter has its own decisions
+	int stat_calls = 0;
+	machine.fds().filter_stat = [&stat_calls] (void*, const std::string& path) {
+		stat_calls++;
+		return path == "/rewrite";
+	};
+	REQUIRE(machine.fds().apply_filter_stat(nullptr, "/rewrite"));
+	REQUIRE(machine.fds().apply_filter_stat(nullptr, "/rewrite"));
+	REQUIRE(stat_calls == 1);
+	REQUIRE(cache->size() == 3);
+
+	// The cache can be shared with other machines
+	Machine<RISCV64> other { empty };
+	int other_calls = 0;
+	setup_filtered_machine(other, other_calls);
+	other.fds().filter_cache = cache;
+	REQUIRE(guest_open(other, "/secret") == -EPERM);
+	REQUIRE(other_calls == 0);
+
+	// After invalidation the filters are asked again
+	cache->invalidate();
+	REQUIRE(cache->size() == 0);
+	REQUIRE(guest_open(machine, "/secret") == -EPERM);
+	REQUIRE(calls == 3);
+}
+
+TEST_CASE("Filter cache size is limited", "[FilterCache]")
+{
+	Machine<RISCV64> machine { empty };
+	int calls = 0;
+	setup_filtered_machine(machine, calls);
+	auto cache = std::make_shared<FileDescriptors::FilterCache>();
+	cache->max_entries = 1;
+	machine.fds().filter_cache = cache;
+
+	REQUIRE(guest_open(machine, "/rewrite") >= 0);
+	REQUIRE(guest_open(machine, "/secret") == -EPERM);
+	REQUIRE(cache->size() == 1);
+
+	// The first decision stays cached, the other one is not
+	REQUIRE(guest_open(machine, "/rewrite") >= 0);
+	REQUIRE(guest_open(machine, "/secret") == -EPERM);
+	REQUIRE(calls == 3);
+
+	// Without a cache, every open is filtered
+	machine.fds().filter_cache = nullptr;
+	REQUIRE(guest_open(machine, "/rewrite") >= 0);
+	REQUIRE(calls == 4);
+}
@@ -0,0 +1,149 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+static const unsigned LINKED_SYSCALL = 500;
+using namespace riscv;
+
+static const char* callee_program = R"M(
+int main() {
+	return 0;
+}
+__attribute__((used, retain))
+long add(long a, long b) {
+	return a + b;
+}
+__attribute__((used, retain))
+long upper(char* buf, long len, long cap, long arg) {
+	for (long i = 0; i < len; i++)
+		buf[i] -= 32;
+	return len;
+}
+__attribute__((used, retain))
+long crash() {
+	return ((long (*)())0x7000000)();
+}
+__attribute__((used, retain))
+long spin() {
+	for (;;) __asm__ volatile("");
+}
+)M";
+
+static const char* caller_program = R"M(
+#include <string.h>
+static long linked_call(long index, long a, long b) {
+	register long a0 __asm__("a0") = index;
+	register long a1 __asm__("a1") = a;
+	register long a2 __asm__("a2") = b;
+	register long a7 __asm__("a7") = 500;
+	__asm__ volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a7) : "memory");
+	return a0;
+}
+static long linked_buffer_call(long index, const void* src, long srclen, void* dst, long dstlen) {
+	register long a0 __asm__("a0") = index;
+	register const void* a1 __asm__("a1") = src;
+	register long a2 __asm__("a2") = srclen;
+	register void* a3 __asm__("a3") = dst;
+	register long a4 __asm__("a4") = dstlen;
+	register long a5 __asm__("a5") = 0;
+	register long a7 __asm__("a7") = 501;
+	__asm__ volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a5), "r"(a7) : "memory");
+	return a0;
+}
+int main() {
+	if (linked_call(0, 40, 2) != 42) return 1;
+	char out[16] = {};
+	if (linked_buffer_call(1, "hello", 5, out, sizeof(out)) != 5) return 2;
+	if (memcmp(out, "HELLO", 5) != 0) return 3;
+	return 666;
+}
+__attribute__((used, retain))
+long call_linked(long index) {
+	return linked_call(index, 0, 0);
+}
+)M";
+
+static void setup_linked_machine(Machine<RISCV64>& machine, const char* name)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{name},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+}
+
+TEST_CASE("Call functions in another machine", "[LinkedCalls]")
+{
+	const auto callee_binary = build_and_load(callee_program);
+	const auto caller_binary = build_and_load(caller_program);
+	Machine<RISCV64> callee { callee_binary, { .memory_max = MAX_MEMORY } };
+	Machine<RISCV64> caller { caller_binary, { .memory_max = MAX_MEMORY } };
+	setup_linked_machine(callee, "callee");
+	setup_linked_machine(caller, "caller");
+	callee.simulate(MAX_INSTRUCTIONS);
+
+	Machine<RISCV64>::setup_linked_calls(LINKED_SYSCALL);
+	REQUIRE(caller.link_function(callee, "add") == 0);
+	REQUIRE(caller.link_function(callee, "upper", 4096) == 1);
+
+	const auto callee_sp = callee.cpu.reg(REG_SP);
+	caller.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(caller.return_value<int>() == 666);
+	// The callee keeps its own state
+	REQUIRE(callee.cpu.reg(REG_SP) == callee_sp);
+
+	REQUIRE_THROWS_WITH([&] {
+		caller.link_function(callee, "does_not_exist");
+	}(), Catch::Matchers::ContainsSubstring("no address"));
+}
+
+TEST_CASE("Faults and timeouts in linked functions", "[LinkedCalls]")
+{
+	const auto callee_binary = build_and_load(callee_program);
+	const auto caller_binary = build_and_load(caller_program);
+	Machine<RISCV64> callee { callee_binary, { .memory_max = MAX_MEMORY } };
+	Machine<RISCV64> caller { caller_binary, { .memory_max = MAX_MEMORY } };
+	setup_linked_machine(callee, "callee");
+	setup_linked_machine(caller, "caller");
+	callee.simulate(MAX_INSTRUCTIONS);
+	caller.simulate(MAX_INSTRUCTIONS);
+
+	Machine<RISCV64>::setup_linked_calls(LINKED_SYSCALL);
+	const auto add = caller.link_function(callee, "add");
+	const auto crash = caller.link_function(callee, "crash");
+	const auto spin = caller.link_function(callee, "spin");
+	const auto call_linked = caller.address_of("call_linked");
+	REQUIRE(call_linked != 0x0);
+
+	const auto callee_pc = callee.cpu.pc();
+	const auto callee_sp = callee.cpu.reg(REG_SP);
+
+	// A fault in the callee is a fault in the caller
+	REQUIRE_THROWS_WITH([&] {
+		caller.vmcall<MAX_INSTRUCTIONS>(call_linked, crash);
+	}(), Catch::Matchers::ContainsSubstring("Execution space protection fault"));
+	REQUIRE(callee.cpu.pc() == callee_pc);
+	REQUIRE(callee.cpu.reg(REG_SP) == callee_sp);
+
+	// The same, but through a FaultLandingPad
+	REQUIRE(caller.try_vmcall<MAX_INSTRUCTIONS>(call_linked, crash) == MACHINE_FAULT);
+	REQUIRE(caller.fault().type == EXECUTION_SPACE_PROTECTION_FAULT);
+	REQUIRE(callee.cpu.pc() == callee_pc);
+	REQUIRE(callee.cpu.reg(REG_SP) == callee_sp);
+
+	// The callee shares the instruction budget of the caller
+	REQUIRE(caller.try_vmcall<MAX_INSTRUCTIONS>(call_linked, spin) == MACHINE_TIMEOUT);
+	REQUIRE(callee.cpu.pc() == callee_pc);
+	REQUIRE(callee.cpu.reg(REG_SP) == callee_sp);
+
+	// Both machines are still usable
+	REQUIRE(caller.try_vmcall<MAX_INSTRUCTIONS>(call_linked, add) == MACHINE_STOPPED);
+	REQUIRE(caller.return_value<long>() == 0);
+	REQUIRE(callee.vmcall<MAX_INSTRUCTIONS>("add", 1, 2) == 3);
+}
@@ -0,0 +1,91 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <libriscv/machine.hpp>
+#include <algorithm>
+#include <sys/mman.h>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static constexpr uint64_t V = 0x40000;
+static constexpr size_t LEN = 8 * Page::size();
+static constexpr int SYSCALL_MADVISE = 233;
+
+static long guest_madvise(Machine<RISCV64>& machine, uint64_t addr, size_t len, int advice)
+{
+	machine.cpu.reg(REG_ARG0) = addr;
+	machine.cpu.reg(REG_ARG1) = len;
+	machine.cpu.reg(REG_ARG2) = advice;
+	machine.system_call(SYSCALL_MADVISE);
+	return machine.return_value<long>();
+}
+
+// Returns the number of bytes in [addr, addr + len) that have the given value
+static size_t count_bytes(const Machine<RISCV64>& machine, uint64_t addr, size_t len, uint8_t value)
+{
+	std::vector<uint8_t> buffer(len);
+	machine.memory.memcpy_out(buffer.data(), addr, len);
+	return std::count(buffer.begin(), buffer.end(), value);
+}
+
+TEST_CASE("MADV_DONTNEED zeroes memory", "[Madvise]")
+{
+	for (const bool arena : {true, false})
+	{
+		Machine<RISCV64> machine { empty, {.use_memory_arena = arena} };
+		machine.setup_linux_syscalls();
+		machine.memory.memset(V, 0xAA, LEN);
+
+		// Unaligned head and tail, and whole pages in-between
+		const uint64_t begin = V + 100;
+		const uint64_t end = V + LEN - 100;
+		REQUIRE(guest_madvise(machine, begin, end - begin, MADV_DONTNEED) == 0);
+		REQUIRE(count_bytes(machine, V, 100, 0xAA) == 100);
+		REQUIRE(count_bytes(machine, begin, end - begin, 0x0) == end - begin);
+		REQUIRE(count_bytes(machine, end, 100, 0xAA) == 100);
+
+		// The discarded memory is still usable
+		machine.memory.write<uint64_t>(V + Page::size(), 1234);
+		REQUIRE(machine.memory.read<uint64_t>(V + Page::size()) == 1234);
+	}
+}
+
+TEST_CASE("MADV_DONTNEED in a fork leaves the master intact", "[Madvise]")
+{
+	Machine<RISCV64> machine { empty };
+	machine.setup_linux_syscalls();
+	machine.memory.memset(V, 0xAA, LEN);
+
+	Machine<RISCV64> fork { machine };
+	REQUIRE(guest_madvise(fork, V, LEN, MADV_DONTNEED) == 0);
+	REQUIRE(count_bytes(fork, V, LEN, 0x0) == LEN);
+	REQUIRE(count_bytes(machine, V, LEN, 0xAA) == LEN);
+
+	// Populating the fork does not bring back the old contents
+	REQUIRE(guest_madvise(fork, V, LEN, MADV_WILLNEED) == 0);
+	REQUIRE(count_bytes(fork, V, LEN, 0x0) == LEN);
+	REQUIRE(count_bytes(machine, V, LEN, 0xAA) == LEN);
+}
+
+TEST_CASE("MADV_WILLNEED populates memory", "[Madvise]")
+{
+	for (const bool arena : {true, false})
+	{
+		Machine<RISCV64> machine { empty, {.use_memory_arena = arena} };
+		machine.setup_linux_syscalls();
+		machine.memory.memset(V, 0xAA, Page::size());
+
+		const size_t pages = machine.memory.pages_active();
+		REQUIRE(guest_madvise(machine, V, LEN, MADV_WILLNEED) == 0);
+		// Outside of the arena the pages are allocated up front
+		if (!arena)
+			REQUIRE(machine.memory.pages_active() == pages + LEN / Page::size() - 1);
+		// Existing contents are kept
+		REQUIRE(count_bytes(machine, V, Page::size(), 0xAA) == Page::size());
+		REQUIRE(count_bytes(machine, V + Page::size(), LEN - Page::size(), 0x0) == LEN - Page::size());
+	}
+
+	// Population is only advice, and stops quietly at the memory limit
+	Machine<RISCV64> limited { empty, {.memory_max = 16 * Page::size(), .use_memory_arena = false} };
+	limited.setup_linux_syscalls();
+	REQUIRE(guest_madvise(limited, V, 64 * Page::size(), MADV_WILLNEED) == 0);
+	REQUIRE(limited.memory.pages_active() <= 64);
+}
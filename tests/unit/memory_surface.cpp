@@ -0,0 +1,108 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static const uint64_t MAX_INSTRUCTIONS = 10'000ul;
+static constexpr uint64_t CODE = 0x2000;
+static constexpr uint64_t V = 0x40000;
+
+// Guest code that stores a 64-bit value: sd a1, 0(a0), then exit
+static void setup_store_code(Machine<RISCV64>& machine)
+{
+	static constexpr uint32_t code[] = { 0x00B53023, 0x05D00893, 0x00000073 };
+	Machine<RISCV64>::setup_minimal_syscalls();
+	machine.memory.set_page_attr(CODE, Page::size(), {.read = true, .exec = true});
+	machine.cpu.init_execute_area(code, CODE, sizeof(code));
+}
+
+static void guest_store(Machine<RISCV64>& machine, uint64_t addr, uint64_t value)
+{
+	machine.cpu.reg(REG_ARG0) = addr;
+	machine.cpu.reg(REG_ARG1) = value;
+	machine.cpu.jump(CODE);
+	machine.simulate(MAX_INSTRUCTIONS);
+}
+
+TEST_CASE("Surface write tracking", "[Surface]")
+{
+	for (const bool arena : {true, false})
+	{
+		Machine<RISCV64> machine { empty, {.use_memory_arena = arena} };
+		setup_store_code(machine);
+		const size_t len = 2 * Page::size();
+		machine.memory.memset(V, 0, len + Page::size());
+		machine.memory.write<uint64_t>(V + 8, 1234);
+
+		auto& surface = machine.memory.export_surface(V, len);
+		REQUIRE(surface.address() == V);
+		REQUIRE(surface.size() == len);
+		// The host reads guest memory in place
+		REQUIRE(surface.data_as<uint64_t>()[1] == 1234);
+
+		// Exporting counts as a write, and then nothing happened
+		REQUIRE(surface.acquire());
+		REQUIRE(!surface.acquire());
+		const auto generation = surface.generation();
+
+		// Guest writes
+		guest_store(machine, V + Page::size() + 16, 5678);
+		REQUIRE(surface.generation() > generation);
+		REQUIRE(surface.acquire());
+		REQUIRE(surface.data_as<uint64_t>()[Page::size() / 8 + 2] == 5678);
+		REQUIRE(!surface.acquire());
+
+		// Writes outside of the surface are not seen
+		guest_store(machine, V + len, 1);
+		REQUIRE(!surface.acquire());
+
+		// Host writes, which may happen in system calls
+		machine.memory.write<uint64_t>(V, 42);
+		REQUIRE(surface.acquire());
+		REQUIRE(surface.data_as<uint64_t>()[0] == 42);
+
+		// Writable buffers may be written by the host kernel
+		vBuffer buffers[4];
+		REQUIRE(machine.memory.gather_writable_buffers_from_range(4, buffers, V + 8, 8) == 1);
+		REQUIRE(surface.acquire());
+
+		// The contents are still there after releasing the surface
+		machine.memory.release_surface(surface);
+		REQUIRE(machine.memory.read<uint64_t>(V) == 42);
+		REQUIRE(machine.memory.read<uint64_t>(V + Page::size() + 16) == 5678);
+		guest_store(machine, V, 43);
+		REQUIRE(machine.memory.read<uint64_t>(V) == 43);
+	}
+}
+
+TEST_CASE("Invalid surfaces", "[Surface]")
+{
+	Machine<RISCV64> machine { empty };
+	machine.memory.memset(V, 0, 4 * Page::size());
+
+	REQUIRE_THROWS_WITH([&] {
+		machine.memory.export_surface(V, 0);
+	}(), Catch::Matchers::ContainsSubstring("Invalid surface range"));
+
+	// Surfaces cannot share pages, as writes are tracked per page
+	auto& surface = machine.memory.export_surface(V + 16, Page::size());
+	REQUIRE_THROWS_WITH([&] {
+		machine.memory.export_surface(V + Page::size() + 64, 64);
+	}(), Catch::Matchers::ContainsSubstring("cannot share pages"));
+	auto& other = machine.memory.export_surface(V + 2 * Page::size(), 64);
+
+	REQUIRE_THROWS_WITH([&] {
+		Machine<RISCV64> fork { machine };
+		fork.memory.export_surface(V + 3 * Page::size(), 64);
+	}(), Catch::Matchers::ContainsSubstring("forked machines"));
+
+	// Surfaces belong to the machine that exported them
+	Machine<RISCV64> other_machine { empty };
+	REQUIRE_THROWS_WITH([&] {
+		other_machine.memory.release_surface(other);
+	}(), Catch::Matchers::ContainsSubstring("Not an exported surface"));
+
+	machine.memory.release_surface(surface);
+	machine.memory.release_surface(other);
+}
@@ -237,3 +237,57 @@ TEST_CASE("Override execute space protection fault", "[Memory Traps]")
 		REQUIRE(state.trapped_fault == true);
 	}
 }
+
+TEST_CASE("Traps and attributes of pages already accessed", "[Memory Traps]")
+{
+	const auto binary = build_and_load(R"M(
+	__attribute__((used, retain))
+	void write_long(long* p, long value) {
+		*p = value;
+	}
+	__attribute__((used, retain))
+	long read_long(long* p) {
+		return *p;
+	}
+
+	int main() {
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary };
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+
+	// Outside of the arena, where accesses go through the page cache
+	constexpr uint64_t PAGE = 0x40000000;
+	constexpr uint64_t OTHER_PAGE = PAGE + Page::size();
+	for (const auto addr : {PAGE, OTHER_PAGE}) {
+		machine.vmcall("write_long", addr, 1234);
+		REQUIRE(machine.vmcall("read_long", addr) == 1234);
+	}
+
+	if constexpr (memory_traps_enabled) {
+		int trapped_reads = 0, trapped_writes = 0;
+		machine.memory.trap(PAGE,
+			[&] (auto&, uint32_t, int mode, int64_t) {
+				if (Page::trap_mode(mode) == TRAP_READ)
+					trapped_reads++;
+				else if (Page::trap_mode(mode) == TRAP_WRITE)
+					trapped_writes++;
+			});
+		// The trap fires even though the page was cached before
+		machine.vmcall("read_long", PAGE);
+		REQUIRE(trapped_reads == 1);
+		machine.vmcall("write_long", PAGE, 5678);
+		REQUIRE(trapped_writes == 1);
+	}
+
+	// Removing write permission also applies to a cached page
+	machine.memory.set_page_attr(OTHER_PAGE, Page::size(), {.read = true, .write = false});
+	REQUIRE(machine.vmcall("read_long", OTHER_PAGE) == 1234);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall("write_long", OTHER_PAGE, 5678);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+}
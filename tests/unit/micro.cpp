@@ -60,6 +60,76 @@ TEST_CASE("Run exactly X instructions", "[Micro]")
 	REQUIRE(machine.cpu.reg(REG_ARG7) == 93);
 }
 
+TEST_CASE("Instruction counter across timeouts and system calls", "[Micro]")
+{
+	// The dispatch may keep the counter in registers,
+	// and must write it back whenever it is observable.
+	static uint64_t syscall_counter = 0;
+	static bool stop_in_syscall = false;
+	Machine<RISCV64> machine { empty };
+	Machine<RISCV64>::setup_minimal_syscalls();
+	Machine<RISCV64>::install_syscall_handler(500,
+	[] (Machine<RISCV64>& machine) {
+		syscall_counter = machine.instruction_counter();
+		if (stop_in_syscall)
+			machine.stop();
+	});
+
+	std::array<uint32_t, 6> my_program{
+		0x1f400893, //        li      a7,500
+		0xfff28293, // loop:  addi    t0,t0,-1
+		0xfe029ee3, //        bnez    t0,loop
+		0x00000073, //        ecall
+		0x05d00893, //        li      a7,93
+		0x00000073, //        ecall
+	};
+	const uint32_t dst = 0x1000;
+	machine.copy_to_guest(dst, &my_program[0], sizeof(my_program));
+	machine.memory.set_page_attr(dst, riscv::Page::size(), {
+		.read = false,
+		.write = false,
+		.exec = true
+	});
+	static constexpr uint64_t N = 1000;
+	static constexpr uint64_t AT_SYSCALL = 2 * N + 2; // Including the ECALL
+	static constexpr uint64_t TOTAL = 2 * N + 4;
+	auto restart = [&] {
+		machine.cpu.registers() = {};
+		machine.cpu.reg(REG_T0) = N;
+		machine.cpu.jump(dst);
+		syscall_counter = 0;
+	};
+
+	restart();
+	REQUIRE(machine.simulate<false>(MAX_CYCLES, 0u));
+	REQUIRE(machine.instruction_counter() == TOTAL);
+	REQUIRE(syscall_counter == AT_SYSCALL);
+
+	// Timing out anywhere, and resuming until the end
+	for (const uint64_t step : {1u, 2u, 3u, 7u, 100u, 1999u, 2001u})
+	{
+		restart();
+		bool stopped = machine.simulate<false>(step, 0u);
+		while (!stopped) {
+			REQUIRE(machine.instruction_counter() >= machine.max_instructions());
+			stopped = machine.resume<false>(machine.instruction_counter() + step);
+		}
+		REQUIRE(machine.instruction_counter() == TOTAL);
+		REQUIRE(syscall_counter == AT_SYSCALL);
+	}
+
+	// Stopping in a system call, and resuming from there
+	stop_in_syscall = true;
+	restart();
+	REQUIRE(machine.simulate<false>(MAX_CYCLES, 0u));
+	REQUIRE(syscall_counter == AT_SYSCALL);
+	REQUIRE(machine.instruction_counter() == AT_SYSCALL);
+	REQUIRE(machine.cpu.pc() == dst + 16);
+	stop_in_syscall = false;
+	REQUIRE(machine.resume<false>(MAX_CYCLES));
+	REQUIRE(machine.instruction_counter() == TOTAL);
+}
+
 TEST_CASE("Crashing payload #1", "[Micro]")
 {
 	static constexpr uint32_t MAX_CYCLES = 5'000;
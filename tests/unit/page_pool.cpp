@@ -0,0 +1,90 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <libriscv/machine.hpp>
+#include <libriscv/threads.hpp>
+#include <algorithm>
+#include <sys/mman.h>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static constexpr size_t LEN = 16 * Page::size();
+static constexpr int SYSCALL_MUNMAP = 215;
+static constexpr int SYSCALL_MMAP = 222;
+
+static uint64_t guest_mmap(Machine<RISCV64>& machine, size_t len)
+{
+	machine.cpu.reg(REG_ARG0) = 0;
+	machine.cpu.reg(REG_ARG1) = len;
+	machine.cpu.reg(REG_ARG2) = PROT_READ | PROT_WRITE;
+	machine.cpu.reg(REG_ARG3) = MAP_PRIVATE | MAP_ANONYMOUS;
+	machine.cpu.reg(REG_ARG4) = -1;
+	machine.cpu.reg(REG_ARG5) = 0;
+	machine.system_call(SYSCALL_MMAP);
+	return machine.return_value<uint64_t>();
+}
+
+static long guest_munmap(Machine<RISCV64>& machine, uint64_t addr, size_t len)
+{
+	machine.cpu.reg(REG_ARG0) = addr;
+	machine.cpu.reg(REG_ARG1) = len;
+	machine.system_call(SYSCALL_MUNMAP);
+	return machine.return_value<long>();
+}
+
+// Returns the number of bytes in [addr, addr + len) that have the given value
+static size_t count_bytes(const Machine<RISCV64>& machine, uint64_t addr, size_t len, uint8_t value)
+{
+	std::vector<uint8_t> buffer(len);
+	machine.memory.memcpy_out(buffer.data(), addr, len);
+	return std::count(buffer.begin(), buffer.end(), value);
+}
+
+TEST_CASE("Unmapped pages are reused by new mappings", "[PagePool]")
+{
+	Machine<RISCV64> machine { empty, {.use_memory_arena = false} };
+	machine.setup_linux_syscalls();
+
+	// A thread stack is used, and then unmapped when the thread exits
+	const auto stack = guest_mmap(machine, LEN);
+	machine.memory.memset(stack, 0xAA, LEN);
+	const size_t pages = machine.memory.pages_active();
+	REQUIRE(guest_munmap(machine, stack, LEN) == 0);
+	REQUIRE(machine.memory.pooled_pages() == LEN / Page::size());
+	REQUIRE(machine.memory.pages_active() == pages - LEN / Page::size());
+
+	// The next stack takes its pages from the pool, and they are zeroed
+	const auto next = guest_mmap(machine, LEN);
+	for (size_t i = 0; i < LEN; i += Page::size())
+		machine.memory.write<uint8_t>(next + i, 1);
+	REQUIRE(machine.memory.pooled_pages() == 0);
+	REQUIRE(machine.memory.pages_active() == pages);
+	REQUIRE(count_bytes(machine, next, LEN, 0x0) == LEN - LEN / Page::size());
+}
+
+TEST_CASE("The page pool is bounded", "[PagePool]")
+{
+	Machine<RISCV64> machine { empty, {.use_memory_arena = false} };
+	machine.setup_linux_syscalls();
+
+	const size_t len = (Memory<RISCV64>::PAGE_POOL_MAX + 16) * Page::size();
+	const auto area = guest_mmap(machine, len);
+	machine.memory.memset(area, 0xAA, len);
+	REQUIRE(guest_munmap(machine, area, len) == 0);
+	REQUIRE(machine.memory.pooled_pages() == Memory<RISCV64>::PAGE_POOL_MAX);
+}
+
+TEST_CASE("Signal state of exited threads is forgotten", "[PagePool]")
+{
+	Machine<RISCV64> machine { empty };
+	machine.setup_linux_syscalls();
+	machine.setup_posix_threads();
+
+	const auto stack = guest_mmap(machine, LEN);
+	auto* thread = machine.threads().create(0, 0, 0, stack + LEN, 0, stack, LEN);
+	const int tid = thread->tid;
+	machine.signals().per_thread(tid).pending = 1;
+
+	thread->exit();
+	REQUIRE(machine.threads().get_thread(tid) == nullptr);
+	// A thread with the same TID would not inherit the pending signal
+	REQUIRE(machine.signals().per_thread(tid).pending == 0);
+}
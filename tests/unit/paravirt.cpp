@@ -0,0 +1,153 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <cerrno>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const std::vector<uint8_t> empty;
+static const uint64_t MAX_MEMORY = 64ul << 20; /* 64MB */
+static const uint64_t GUEST_MEMORY = 16ul << 20; /* 16MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+using namespace riscv;
+
+static const char* nested_program = R"M(
+int main() {
+	return 666;
+}
+__attribute__((used, retain))
+long add(long a, long b) {
+	return a + b;
+}
+__attribute__((used, retain))
+long crash() {
+	return ((long (*)())0x7000000)();
+}
+__attribute__((used, retain))
+void spin() {
+	for (;;) __asm__ volatile("");
+}
+)M";
+
+// Perform a paravirtual system call on behalf of the (empty) host guest
+template <typename... Args>
+static long pvcall(Machine<RISCV64>& machine, paravirt_call call, Args... args)
+{
+	int i = 0;
+	((machine.cpu.reg(REG_ARG0 + i++) = address_type<RISCV64>(args)), ...);
+	machine.system_call(PARAVIRT_SYSCALLS_BASE + call);
+	return machine.return_value<long>();
+}
+
+// Place the nested binary in the memory of the host guest
+static address_type<RISCV64> load_binary(Machine<RISCV64>& machine, const std::vector<uint8_t>& binary)
+{
+	const auto addr = machine.memory.mmap_allocate(binary.size());
+	machine.memory.memcpy(addr, binary.data(), binary.size());
+	return addr;
+}
+
+static address_type<RISCV64> address_of(Machine<RISCV64>& machine, int handle, const std::string& name)
+{
+	const auto addr = machine.memory.mmap_allocate(name.size());
+	machine.memory.memcpy(addr, name.data(), name.size());
+	return pvcall(machine, PV_ADDRESS_OF, handle, addr, name.size());
+}
+
+TEST_CASE("Create and call into paravirtual machines", "[Paravirt]")
+{
+	const auto binary = build_and_load(nested_program);
+	Machine<RISCV64> machine { empty, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	Machine<RISCV64>::setup_paravirt_calls();
+	machine.set_max_instructions(MAX_INSTRUCTIONS);
+
+	REQUIRE(pvcall(machine, PV_PROBE) == PARAVIRT_VERSION);
+
+	const auto bin = load_binary(machine, binary);
+	const int handle = pvcall(machine, PV_CREATE, bin, binary.size(), GUEST_MEMORY);
+	REQUIRE(handle == 0);
+	REQUIRE(machine.paravirt_guests() == 1);
+
+	const std::string argv = std::string("nested") + '\0';
+	const auto args = load_binary(machine, {argv.begin(), argv.end()});
+	REQUIRE(pvcall(machine, PV_SETUP_LINUX, handle, args, argv.size(), 0, 0) == 0);
+
+	// Run the nested main() to completion
+	REQUIRE(pvcall(machine, PV_SIMULATE, handle, MAX_INSTRUCTIONS) == MACHINE_STOPPED);
+	REQUIRE(pvcall(machine, PV_REG, handle, REG_ARG0, 0, 0) == 666);
+	// The nested machine runs on our instruction budget
+	const uint64_t nested_counter = pvcall(machine, PV_REG, handle, 33, 0, 0);
+	REQUIRE(nested_counter > 0);
+	REQUIRE(machine.instruction_counter() >= nested_counter);
+
+	// Function calls with arguments
+	const auto add = address_of(machine, handle, "add");
+	REQUIRE(add != 0x0);
+	REQUIRE(address_of(machine, handle, "does_not_exist") == 0x0);
+	const int64_t argv_add[] = { 20, 22 };
+	const auto argp = load_binary(machine, {(const uint8_t *)argv_add, (const uint8_t *)(argv_add + 2)});
+	REQUIRE(pvcall(machine, PV_VMCALL, handle, add, argp, 2, MAX_INSTRUCTIONS) == MACHINE_STOPPED);
+	REQUIRE(pvcall(machine, PV_REG, handle, REG_ARG0, 0, 0) == 42);
+	REQUIRE(pvcall(machine, PV_VMCALL, handle, add, argp, PARAVIRT_MAX_ARGS + 1, MAX_INSTRUCTIONS) == -EINVAL);
+
+	// Copy memory into the nested machine and back again
+	const auto nested_sp = pvcall(machine, PV_REG, handle, REG_SP, 0, 0);
+	const auto dst = nested_sp - 256;
+	REQUIRE(pvcall(machine, PV_COPY, handle, dst, argp, sizeof(argv_add), 1) == 0);
+	const auto back = machine.memory.mmap_allocate(sizeof(argv_add));
+	REQUIRE(pvcall(machine, PV_COPY, handle, dst, back, sizeof(argv_add), 0) == 0);
+	REQUIRE(machine.memory.read<int64_t>(back + 0) == 20);
+	REQUIRE(machine.memory.read<int64_t>(back + 8) == 22);
+
+	REQUIRE(pvcall(machine, PV_DESTROY, handle) == 0);
+	REQUIRE(machine.paravirt_guests() == 0);
+	REQUIRE_THROWS_WITH([&] {
+		pvcall(machine, PV_SIMULATE, handle, MAX_INSTRUCTIONS);
+	}(), Catch::Matchers::ContainsSubstring("Invalid paravirtual machine handle"));
+}
+
+TEST_CASE("Paravirtual machine faults and limits", "[Paravirt]")
+{
+	const auto binary = build_and_load(nested_program);
+	Machine<RISCV64> machine { empty, { .memory_max = MAX_MEMORY } };
+	machine.setup_linux_syscalls();
+	Machine<RISCV64>::setup_paravirt_calls();
+	machine.set_max_instructions(MAX_INSTRUCTIONS);
+
+	const auto bin = load_binary(machine, binary);
+	const int handle = pvcall(machine, PV_CREATE, bin, binary.size(), GUEST_MEMORY);
+	REQUIRE(handle >= 0);
+
+	// Faults are returned with the fault type and data
+	const auto crash = address_of(machine, handle, "crash");
+	REQUIRE(pvcall(machine, PV_VMCALL, handle, crash, 0, 0, MAX_INSTRUCTIONS) == MACHINE_FAULT);
+	REQUIRE(machine.cpu.reg(REG_ARG1) == EXECUTION_SPACE_PROTECTION_FAULT);
+	REQUIRE(machine.cpu.reg(REG_ARG2) == 0x7000000);
+
+	// A timeout limited by the caller does not exhaust us
+	const auto spin = address_of(machine, handle, "spin");
+	REQUIRE(pvcall(machine, PV_VMCALL, handle, spin, 0, 0, 100'000) == MACHINE_TIMEOUT);
+	REQUIRE(!machine.instruction_limit_reached());
+	// A timeout limited by our own budget exhausts us too
+	REQUIRE(pvcall(machine, PV_VMCALL, handle, spin, 0, 0, UINT64_MAX) == MACHINE_TIMEOUT);
+	REQUIRE(machine.instruction_limit_reached());
+
+	// All nested machines share our memory budget
+	std::vector<long> handles { handle };
+	for (uint64_t total = GUEST_MEMORY; total + GUEST_MEMORY <= MAX_MEMORY; total += GUEST_MEMORY) {
+		handles.push_back(pvcall(machine, PV_CREATE, bin, binary.size(), GUEST_MEMORY));
+		REQUIRE(handles.back() >= 0);
+	}
+	REQUIRE(pvcall(machine, PV_CREATE, bin, binary.size(), GUEST_MEMORY) == -ENOMEM);
+	REQUIRE(pvcall(machine, PV_CREATE, bin, binary.size(), MAX_MEMORY + 1) == -EINVAL);
+	// Destroyed slots are reused
+	REQUIRE(pvcall(machine, PV_DESTROY, handles.back()) == 0);
+	REQUIRE(pvcall(machine, PV_CREATE, bin, binary.size(), GUEST_MEMORY) == handles.back());
+	REQUIRE(machine.paravirt_guests() == handles.size());
+
+	// Garbage is not a program
+	const auto garbage = machine.memory.mmap_allocate(4096);
+	REQUIRE(pvcall(machine, PV_DESTROY, handles.back()) == 0);
+	REQUIRE(pvcall(machine, PV_CREATE, garbage, 4096, GUEST_MEMORY) == -ENOEXEC);
+}
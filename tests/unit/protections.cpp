@@ -156,3 +156,157 @@ TEST_CASE("Writes to read-only segment", "[Memory]")
 		}(), Catch::Matchers::ContainsSubstring("Protection fault"));
 	}
 }
+
+static const char* arena_program = R"M(
+int main() {
+	return 666;
+}
+__attribute__((used, retain))
+long load(long* src) {
+	return *src;
+}
+__attribute__((used, retain))
+void store(long* dst, long value) {
+	*dst = value;
+})M";
+
+static void setup_arena_machine(riscv::Machine<RISCV64>& machine)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"protections"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(10'000'000ul);
+	REQUIRE(machine.return_value<int>() == 666);
+}
+
+TEST_CASE("Page protections in a protected arena", "[Memory]")
+{
+	static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+	const auto binary = build_and_load(arena_program);
+	riscv::Machine<RISCV64> machine { binary, { .use_arena_host_protections = true } };
+	// Host protections need a flat arena on Linux
+	if (!machine.memory.uses_arena_host_protections())
+		return;
+	setup_arena_machine(machine);
+
+	const auto addr = machine.memory.mmap_allocate(3 * Page::size());
+	REQUIRE(addr + 3 * Page::size() <= machine.memory.memory_arena_size());
+	machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 1234);
+
+	// A read-only page
+	machine.memory.set_page_attr(addr, Page::size(), {.read = true, .write = false});
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>("load", addr) == 1234);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 1);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+	REQUIRE(machine.memory.read<uint64_t>(addr) == 1234);
+
+	// A guard page
+	const auto guard = addr + Page::size();
+	machine.memory.set_page_attr(guard, Page::size(), {.read = false, .write = false});
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("load", guard);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+
+	// The machine keeps working after the faults
+	const auto other = addr + 2 * Page::size();
+	machine.vmcall<MAX_INSTRUCTIONS>("store", other, 5678);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>("load", other) == 5678);
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("store", addr, 1) == MACHINE_FAULT);
+	REQUIRE(machine.fault().type == PROTECTION_FAULT);
+
+	// Host code ignores the protections, which are restored afterwards
+	machine.memory.write<uint64_t>(addr, 42);
+	REQUIRE(machine.memory.read<uint64_t>(addr) == 42);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 1);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+
+	// Pages can be made writable again
+	machine.memory.set_page_attr(addr, Page::size(), {.read = true, .write = true});
+	machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 43);
+	REQUIRE(machine.memory.read<uint64_t>(addr) == 43);
+}
+
+TEST_CASE("Protected arena with the non-throwing API", "[Memory]")
+{
+	static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+	const auto binary = build_and_load(arena_program);
+	riscv::Machine<RISCV64> machine { binary, { .use_arena_host_protections = true } };
+	if (!machine.memory.uses_arena_host_protections())
+		return;
+	setup_arena_machine(machine);
+
+	const auto guard = machine.memory.mmap_allocate(Page::size());
+	machine.memory.set_page_attr(guard, Page::size(), {.read = false, .write = false});
+
+	// Only timeouts are returned, faults are still thrown
+	machine.cpu.reg(REG_ARG0) = guard;
+	machine.cpu.reg(REG_RA) = machine.memory.exit_address();
+	machine.cpu.jump(machine.address_of("load"));
+	REQUIRE_THROWS_WITH([&] {
+		machine.simulate<false>(MAX_INSTRUCTIONS);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+
+	auto vmcall = [&] (const char* func, auto... args) {
+		return machine.vmcall<MAX_INSTRUCTIONS, false>(func, args...);
+	};
+	REQUIRE_THROWS_WITH([&] {
+		vmcall("store", guard, 1);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+	REQUIRE(machine.memory.read<uint64_t>(guard) == 0);
+
+	// The protections were not lifted by the faults
+	REQUIRE_THROWS_WITH([&] {
+		vmcall("load", guard);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+}
+
+TEST_CASE("Forks and surfaces in a protected arena", "[Memory]")
+{
+	static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+	const auto binary = build_and_load(arena_program);
+	riscv::Machine<RISCV64> machine { binary, { .use_arena_host_protections = true } };
+	if (!machine.memory.uses_arena_host_protections())
+		return;
+	setup_arena_machine(machine);
+
+	const auto addr = machine.memory.mmap_allocate(2 * Page::size());
+	const auto page = addr + Page::size();
+	machine.memory.set_page_attr(addr, Page::size(), {.read = true, .write = false});
+
+	// Forks share the protections of the main machine
+	{
+		riscv::Machine<RISCV64> fork { machine, { .use_arena_host_protections = true } };
+		REQUIRE(fork.vmcall<MAX_INSTRUCTIONS>("load", addr) == 0);
+		REQUIRE_THROWS_WITH([&] {
+			fork.vmcall<MAX_INSTRUCTIONS>("store", addr, 1);
+		}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+		// Other pages are still writable
+		fork.vmcall<MAX_INSTRUCTIONS>("store", page, 1);
+		REQUIRE(fork.vmcall<MAX_INSTRUCTIONS>("load", page) == 1);
+	}
+
+	// Write tracking and guest protections work side by side
+	auto& surface = machine.memory.export_surface(page, Page::size());
+	REQUIRE(surface.acquire());
+	REQUIRE(!surface.acquire());
+	machine.vmcall<MAX_INSTRUCTIONS>("store", page, 1234);
+	REQUIRE(surface.acquire());
+	REQUIRE(surface.data_as<uint64_t>()[0] == 1234);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 1);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+	REQUIRE(!surface.acquire());
+
+	// Releasing the surface leaves the protections alone
+	machine.memory.release_surface(surface);
+	machine.vmcall<MAX_INSTRUCTIONS>("store", page, 5678);
+	REQUIRE(machine.memory.read<uint64_t>(page) == 5678);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("store", addr, 1);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+}
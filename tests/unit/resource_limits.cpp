@@ -0,0 +1,77 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace riscv;
+static const std::vector<uint8_t> empty;
+static constexpr uint64_t V = 0x50000000;
+
+TEST_CASE("Owned pages limit", "[ResourceLimits]")
+{
+	Machine<RISCV64> machine { empty, {.use_memory_arena = false} };
+
+	ResourceLimits limits;
+	limits.owned_pages = machine.resource_usage().owned_pages + 2;
+	machine.set_resource_limits(limits);
+
+	machine.memory.write<uint32_t>(V, 1);
+	machine.memory.write<uint32_t>(V + Page::size(), 2);
+	REQUIRE(machine.resource_usage().owned_pages == limits.owned_pages);
+
+	const size_t pages = machine.memory.pages_active();
+	REQUIRE_THROWS_WITH([&] {
+		machine.memory.write<uint32_t>(V + 2 * Page::size(), 3);
+	}(), Catch::Matchers::ContainsSubstring("Owned pages limit reached"));
+	// Nothing was left behind by the failed allocation
+	REQUIRE(machine.memory.pages_active() == pages);
+	REQUIRE(machine.resource_usage().owned_pages == limits.owned_pages);
+
+	// Freeing pages makes room again
+	machine.memory.free_pages(V, Page::size());
+	machine.memory.write<uint32_t>(V + 2 * Page::size(), 3);
+	REQUIRE(machine.memory.read<uint32_t>(V + 2 * Page::size()) == 3);
+}
+
+TEST_CASE("Copy-on-write in forks respects the owned pages limit", "[ResourceLimits]")
+{
+	Machine<RISCV64> machine { empty, {.use_memory_arena = false} };
+	machine.memory.write<uint32_t>(V, 1234);
+
+	Machine<RISCV64> fork { machine, {.use_memory_arena = false} };
+	ResourceLimits limits;
+	limits.owned_pages = fork.resource_usage().owned_pages;
+	fork.set_resource_limits(limits);
+
+	REQUIRE_THROWS_WITH([&] {
+		fork.memory.write<uint32_t>(V, 1);
+	}(), Catch::Matchers::ContainsSubstring("Owned pages limit reached"));
+	// The fork still sees the page of the master, unmodified
+	REQUIRE(fork.memory.read<uint32_t>(V) == 1234);
+	REQUIRE(machine.memory.read<uint32_t>(V) == 1234);
+}
+
+TEST_CASE("File descriptor limit", "[ResourceLimits]")
+{
+	Machine<RISCV64> machine { empty };
+	machine.setup_linux_syscalls();
+
+	ResourceLimits limits;
+	limits.file_descriptors = 1;
+	machine.set_resource_limits(limits);
+
+	const int fd1 = open("/dev/null", O_RDONLY);
+	const int fd2 = open("/dev/null", O_RDONLY);
+	REQUIRE(fd1 >= 0);
+	REQUIRE(fd2 >= 0);
+	machine.fds().assign_file(fd1);
+	REQUIRE(machine.resource_usage().file_descriptors == 1);
+
+	REQUIRE_THROWS_WITH([&] {
+		machine.fds().assign_file(fd2);
+	}(), Catch::Matchers::ContainsSubstring("Too many open file descriptors"));
+	REQUIRE(machine.resource_usage().file_descriptors == 1);
+	// The rejected descriptor was closed, and not leaked
+	REQUIRE(fcntl(fd2, F_GETFD) < 0);
+}
@@ -163,3 +163,66 @@ TEST_CASE("Serialized state from another place", "[Serialize]")
 	restored_machine.simulate(MAX_INSTRUCTIONS);
 	REQUIRE(restored_machine.return_value<int>() == 666);
 }
+
+TEST_CASE("Vector state is only serialized when used", "[Serialize]")
+{
+	riscv::Machine<RISCV64> machine { empty, restored_options };
+	machine.cpu.reg(REG_ARG0) = 1234;
+
+	std::vector<uint8_t> scalar_state;
+	machine.serialize_to(scalar_state);
+	REQUIRE(!machine.cpu.registers().has_vector_state());
+
+#ifdef RISCV_EXT_VECTOR
+	machine.cpu.registers().rvv().u32(1)[0] = 5;
+	std::vector<uint8_t> vector_state;
+	machine.serialize_to(vector_state);
+	REQUIRE(vector_state.size() == scalar_state.size() + sizeof(VectorRegisters<RISCV64>));
+
+	riscv::Machine<RISCV64> restored_machine { empty, restored_options };
+	REQUIRE(restored_machine.deserialize_from(vector_state) == 0);
+	REQUIRE(restored_machine.sysarg(0) == 1234);
+	REQUIRE(restored_machine.cpu.registers().has_vector_state());
+	REQUIRE(restored_machine.cpu.registers().rvv().u32(1)[0] == 5);
+
+	// Restoring a scalar state drops the vector state
+	REQUIRE(restored_machine.deserialize_from(scalar_state) == 0);
+	REQUIRE(restored_machine.sysarg(0) == 1234);
+	REQUIRE(!restored_machine.cpu.registers().has_vector_state());
+#endif
+}
+
+TEST_CASE("Restoring state into the flat arena", "[Serialize]")
+{
+	static constexpr uint64_t V = 0x40000;
+	riscv::Machine<RISCV64> machine { empty, { .memory_max = MAX_MEMORY } };
+	machine.memory.write<uint64_t>(V, 1234);
+	std::vector<uint8_t> state;
+	machine.serialize_to(state);
+
+	// Nothing written after the state was taken may remain
+	machine.memory.write<uint64_t>(V, 5678);
+	machine.memory.write<uint64_t>(V + Page::size(), 5678);
+	REQUIRE(machine.deserialize_from(state) == 0);
+	REQUIRE(machine.memory.read<uint64_t>(V) == 1234);
+	REQUIRE(machine.memory.read<uint64_t>(V + Page::size()) == 0);
+
+	// Restore into another machine, and back again
+	riscv::Machine<RISCV64> other { empty, { .memory_max = MAX_MEMORY } };
+	REQUIRE(other.deserialize_from(state) == 0);
+	REQUIRE(other.memory.read<uint64_t>(V) == 1234);
+	std::vector<uint8_t> other_state;
+	other.serialize_to(other_state);
+	REQUIRE(machine.deserialize_from(other_state) == 0);
+	REQUIRE(machine.memory.read<uint64_t>(V) == 1234);
+
+	// Forks share the arena of their master, which must not be overwritten
+	if (machine.memory.uses_flat_memory_arena()) {
+		riscv::Machine<RISCV64> fork { machine };
+		machine.memory.write<uint64_t>(V, 4321);
+		REQUIRE_THROWS_WITH([&] {
+			fork.deserialize_from(state);
+		}(), Catch::Matchers::ContainsSubstring("forked machines"));
+		REQUIRE(machine.memory.read<uint64_t>(V) == 4321);
+	}
+}
@@ -0,0 +1,171 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <thread>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+using namespace riscv;
+
+static const char* shared_program = R"M(
+int main() {
+	return 666;
+}
+__attribute__((used, retain))
+long read_long(long* p) {
+	return *p;
+}
+__attribute__((used, retain))
+void write_long(long* p, long value) {
+	*p = value;
+}
+__attribute__((used, retain))
+void add_many(long* counter, int n) {
+	for (int i = 0; i < n; i++)
+		__atomic_fetch_add(counter, 1, __ATOMIC_SEQ_CST);
+}
+__attribute__((used, retain))
+void cas_many(long* counter, int n) {
+	for (int i = 0; i < n; i++) {
+		long old = __atomic_load_n(counter, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(counter, &old, old + 1,
+			0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+	}
+}
+)M";
+
+static void setup_shared_machine(Machine<RISCV64>& machine)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"shared"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+}
+
+TEST_CASE("Shared memory between machines", "[SharedMemory]")
+{
+	const auto binary = build_and_load(shared_program);
+	Machine<RISCV64> m1 { binary, { .memory_max = MAX_MEMORY } };
+	Machine<RISCV64> m2 { binary, { .memory_max = MAX_MEMORY } };
+	setup_shared_machine(m1);
+	setup_shared_machine(m2);
+
+	const size_t len = 4 * Page::size();
+	auto* shm = (int64_t *)Memory<RISCV64>::allocate_shared_memory(len);
+	// Each machine maps the region at its own address
+	const auto dst1 = m1.memory.mmap_allocate(len);
+	const auto dst2 = m2.memory.mmap_allocate(2 * len) + len;
+	m1.memory.insert_shared_memory(dst1, shm, len);
+	m2.memory.insert_shared_memory(dst2, shm, len);
+
+	m1.vmcall<MAX_INSTRUCTIONS>("write_long", dst1 + 8, 1234);
+	REQUIRE(shm[1] == 1234);
+	REQUIRE(m2.vmcall<MAX_INSTRUCTIONS>("read_long", dst2 + 8) == 1234);
+	REQUIRE(m2.memory.read<uint64_t>(dst2 + 8) == 1234);
+
+	shm[Page::size() / 8] = 5678;
+	REQUIRE(m1.vmcall<MAX_INSTRUCTIONS>("read_long", dst1 + Page::size()) == 5678);
+
+	// Unaligned ranges are rejected
+	REQUIRE_THROWS_WITH([&] {
+		m1.memory.insert_shared_memory(dst1 + 8, shm, len);
+	}(), Catch::Matchers::ContainsSubstring("page-aligned"));
+
+	Memory<RISCV64>::free_shared_memory(shm, len);
+}
+
+TEST_CASE("Read-only shared memory", "[SharedMemory]")
+{
+	const auto binary = build_and_load(shared_program);
+	Machine<RISCV64> m1 { binary, { .memory_max = MAX_MEMORY } };
+	Machine<RISCV64> m2 { binary, { .memory_max = MAX_MEMORY } };
+	setup_shared_machine(m1);
+	setup_shared_machine(m2);
+	// Read-only shared memory is only supported outside of the arena
+	if (m2.memory.uses_Nbit_encompassing_arena())
+		return;
+
+	const size_t len = Page::size();
+	auto* shm = (int64_t *)Memory<RISCV64>::allocate_shared_memory(len);
+	const uint64_t dst = 0x40000000;
+	m1.memory.insert_shared_memory(dst, shm, len);
+	m2.memory.insert_shared_memory(dst, shm, len, {.read = true, .write = false});
+
+	m1.vmcall<MAX_INSTRUCTIONS>("write_long", dst, 42);
+	REQUIRE(m2.vmcall<MAX_INSTRUCTIONS>("read_long", dst) == 42);
+
+	REQUIRE_THROWS_WITH([&] {
+		m2.vmcall<MAX_INSTRUCTIONS>("write_long", dst, 43);
+	}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+	REQUIRE(shm[0] == 42);
+
+	Memory<RISCV64>::free_shared_memory(shm, len);
+}
+
+TEST_CASE("Atomics on shared memory from several threads", "[SharedMemory]")
+{
+	static constexpr int N = 100'000;
+	const auto binary = build_and_load(shared_program);
+	Machine<RISCV64> m1 { binary, { .memory_max = MAX_MEMORY } };
+	Machine<RISCV64> m2 { binary, { .memory_max = MAX_MEMORY } };
+	setup_shared_machine(m1);
+	setup_shared_machine(m2);
+
+	const size_t len = Page::size();
+	auto* shm = (int64_t *)Memory<RISCV64>::allocate_shared_memory(len);
+	const auto dst1 = m1.memory.mmap_allocate(len);
+	const auto dst2 = m2.memory.mmap_allocate(len);
+	m1.memory.insert_shared_memory(dst1, shm, len);
+	m2.memory.insert_shared_memory(dst2, shm, len);
+
+	for (const char* func : {"add_many", "cas_many"})
+	{
+		shm[0] = 0;
+		std::thread thread([&] {
+			m2.vmcall(func, dst2, N);
+		});
+		m1.vmcall(func, dst1, N);
+		thread.join();
+
+		REQUIRE(shm[0] == 2 * N);
+	}
+
+	Memory<RISCV64>::free_shared_memory(shm, len);
+}
+
+TEST_CASE("Discarding shared memory in the arena", "[SharedMemory]")
+{
+	const auto binary = build_and_load(shared_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_shared_machine(machine);
+
+	const size_t len = 4 * Page::size();
+	const auto dst = machine.memory.mmap_allocate(len);
+	if (dst + len > machine.memory.memory_arena_size())
+		return;
+	auto* shm = (int64_t *)Memory<RISCV64>::allocate_shared_memory(len);
+	machine.memory.insert_shared_memory(dst, shm, len);
+
+	// Discarding shared memory clears it for everyone
+	shm[0] = 1234;
+	machine.memory.memdiscard(dst, len, true);
+	REQUIRE(shm[0] == 0);
+	REQUIRE(machine.memory.read<uint64_t>(dst) == 0);
+
+	// Freeing pages detaches them from the shared memory
+	shm[Page::size() / 8] = 5678;
+	machine.memory.free_pages(dst + Page::size(), Page::size());
+	REQUIRE(shm[Page::size() / 8] == 5678);
+	REQUIRE(machine.memory.read<uint64_t>(dst + Page::size()) == 0);
+	// The remaining pages are still shared
+	shm[0] = 42;
+	REQUIRE(machine.memory.read<uint64_t>(dst) == 42);
+
+	Memory<RISCV64>::free_shared_memory(shm, len);
+}
@@ -0,0 +1,150 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <csignal>
+#include <thread>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+using namespace riscv;
+
+static const char* signal_program = R"M(
+#include <signal.h>
+static volatile int handled = 0;
+static volatile int info_signo = 0;
+static volatile int info_code = 0;
+
+static void handler(int sig, siginfo_t* info, void* uctx) {
+	handled += sig;
+	info_signo = info->si_signo;
+	info_code = info->si_code;
+}
+int main() {
+	struct sigaction sa = {};
+	sa.sa_sigaction = handler;
+	sa.sa_flags = SA_SIGINFO;
+	sigaction(SIGUSR1, &sa, 0);
+	return 666;
+}
+__attribute__((used, retain))
+int add_handled(int x) {
+	return x + handled;
+}
+__attribute__((used, retain))
+int get_info_signo() {
+	return info_signo;
+}
+__attribute__((used, retain))
+int get_info_code() {
+	return info_code;
+}
+__attribute__((used, retain))
+int raise_signal(int x) {
+	const int before = handled;
+	for (int i = 0; i < x; i++)
+		raise(SIGUSR1);
+	return (handled - before) / SIGUSR1;
+}
+__attribute__((used, retain))
+int wait_for_signal(int x) {
+	while (handled == 0);
+	return x + handled;
+}
+__attribute__((used, retain))
+int block_signal(int how) {
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	return sigprocmask(how, &set, 0);
+}
+)M";
+
+static void setup_signal_machine(Machine<RISCV64>& machine)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"signals"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	// Run main() in order to install the signal handler
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+	REQUIRE(!machine.sigaction(SIGUSR1).is_unset());
+}
+
+TEST_CASE("Queued signal is delivered on next simulation", "[Signals]")
+{
+	const auto binary = build_and_load(signal_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_signal_machine(machine);
+
+	const auto add_handled = machine.address_of("add_handled");
+	REQUIRE(add_handled != 0x0);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(add_handled, 100) == 100);
+
+	// The signal is delivered before the function starts, and after
+	// rt_sigreturn the function sees its own arguments again
+	machine.queue_signal(SIGUSR1);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(add_handled, 100) == 100 + SIGUSR1);
+	// The handler received a real siginfo_t
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>("get_info_signo") == SIGUSR1);
+
+	// Delivered only once
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(add_handled, 100) == 100 + SIGUSR1);
+}
+
+TEST_CASE("Blocked signals stay pending", "[Signals]")
+{
+	const auto binary = build_and_load(signal_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_signal_machine(machine);
+
+	const auto add_handled = machine.address_of("add_handled");
+	const auto block_signal = machine.address_of("block_signal");
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(block_signal, SIG_BLOCK) == 0);
+
+	machine.queue_signal(SIGUSR1);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(add_handled, 0) == 0);
+
+	// Unblocking delivers the signal at the end of rt_sigprocmask
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(block_signal, SIG_UNBLOCK) == 0);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>(add_handled, 0) == SIGUSR1);
+}
+
+TEST_CASE("Signal queued from another thread interrupts a loop", "[Signals]")
+{
+	const auto binary = build_and_load(signal_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_signal_machine(machine);
+
+	const auto wait_for_signal = machine.address_of("wait_for_signal");
+	REQUIRE(wait_for_signal != 0x0);
+
+	// The guest loop has no system calls, so the signal
+	// must be observed in-between slices of the simulation
+	std::thread thread([&] {
+		machine.queue_signal(SIGUSR1);
+	});
+	const auto result = machine.vmcall(wait_for_signal, 1);
+	thread.join();
+
+	REQUIRE(result == 1 + SIGUSR1);
+	REQUIRE(!machine.signal_safepoint_requested());
+}
+
+TEST_CASE("Signals raised by the guest itself", "[Signals]")
+{
+	const auto binary = build_and_load(signal_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_signal_machine(machine);
+
+	// The handler is entered right after tgkill, and rt_sigreturn
+	// resumes the loop exactly where it left off, every time
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>("raise_signal", 100) == 100);
+	REQUIRE(machine.vmcall<MAX_INSTRUCTIONS>("get_info_code") == SI_TKILL);
+	REQUIRE(!machine.signal_safepoint_requested());
+	REQUIRE(machine.signals().per_thread(machine.gettid()).sigret.empty());
+}
@@ -0,0 +1,325 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+#include <algorithm>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+static const std::vector<uint8_t> empty;
+using namespace riscv;
+
+static const char* counter_program = R"M(
+static inline long rdinstret() {
+	long value;
+	__asm__ volatile("rdinstret %0" : "=r"(value));
+	return value;
+}
+__attribute__((used, retain))
+long read_instret() {
+	return rdinstret();
+}
+__attribute__((used, retain))
+long instret_delta(long n) {
+	const long before = rdinstret();
+	for (long i = 0; i < n; i++)
+		__asm__ volatile("");
+	return rdinstret() - before;
+}
+int main() {
+	return 666;
+})M";
+
+static const char* window_program = R"M(
+__attribute__((used, retain))
+long sum_window(const long* p) {
+	return p[0] + p[1] + p[2] + p[3];
+}
+__attribute__((used, retain))
+void store_window(long* p, long v) {
+	p[0] = v;
+	p[1] = v + 1;
+	p[2] = v + 2;
+	p[3] = v + 3;
+}
+int main() {
+	return 666;
+})M";
+
+static const char* jit_program = R"M(
+#include <sys/mman.h>
+#include <unistd.h>
+unsigned* jit_code;
+__attribute__((used, retain))
+long jit_call(long x) {
+	return ((long (*)(long))jit_code)(x);
+}
+__attribute__((used, retain))
+void jit_write(int imm, int flush) {
+	jit_code[0] = 0x00050513 | (imm << 20); // addi a0, a0, imm
+	jit_code[1] = 0x00008067; // ret
+	if (flush) // riscv_flush_icache
+		syscall(259, jit_code, jit_code + 2, 0);
+}
+int main() {
+	jit_code = mmap(0, 4096, PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	jit_write(1, 0);
+	return 666;
+})M";
+
+static const char* fp_syscall_program = R"M(
+static inline double fp_multiply(double a, double b) {
+	register double fa0 __asm__("fa0") = a;
+	register double fa1 __asm__("fa1") = b;
+	register long a7 __asm__("a7") = 500;
+	__asm__ volatile("ecall" : "+f"(fa0) : "f"(fa1), "r"(a7) : "memory");
+	return fa0;
+}
+__attribute__((used, retain))
+double fp_sum(double a, double b, long n) {
+	double sum = 0.0;
+	for (long i = 0; i < n; i++)
+		sum += fp_multiply(a + i, b);
+	return sum * a;
+}
+int main() {
+	return 666;
+})M";
+
+static const char* branch_program = R"M(
+__attribute__((used, retain))
+long sum_below(long n, long limit) {
+	long sum = 0;
+	for (long i = 0; i < n; i++) {
+		if (i < limit) {
+			__asm__ volatile("");
+			sum += i;
+		} else {
+			__asm__ volatile("");
+			sum -= 1;
+		}
+	}
+	return sum;
+}
+int main() {
+	return 666;
+})M";
+
+static MachineOptions<RISCV64> translated_options(bool translate, bool ignore_instruction_limit = false)
+{
+	MachineOptions<RISCV64> options { .memory_max = MAX_MEMORY };
+#ifdef RISCV_BINARY_TRANSLATION
+	options.translate_enabled = translate;
+	options.translate_ignore_instruction_limit = ignore_instruction_limit;
+	// Shared execute segments would be shared with the interpreted machine
+	options.use_shared_execute_segments = !translate;
+#else
+	(void)translate;
+	(void)ignore_instruction_limit;
+#endif
+	return options;
+}
+
+static void setup_translated_machine(Machine<RISCV64>& machine)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"translation"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+}
+
+TEST_CASE("Counter CSRs in translated code", "[Translation]")
+{
+	const auto binary = build_and_load(counter_program);
+	Machine<RISCV64> interpreted { binary, translated_options(false) };
+	setup_translated_machine(interpreted);
+	Machine<RISCV64> translated { binary, translated_options(true) };
+	setup_translated_machine(translated);
+
+	// Without instruction counting, the counter is read by the system handler
+	Machine<RISCV64> unlimited { binary, translated_options(true, true) };
+	setup_translated_machine(unlimited);
+
+	// The translated counter is the same as the interpreted one
+	for (const long n : {0, 1, 100}) {
+		const auto delta = interpreted.vmcall("instret_delta", n);
+		REQUIRE(delta > 0);
+		REQUIRE(translated.vmcall("instret_delta", n) == delta);
+		REQUIRE(unlimited.vmcall("instret_delta", n) == delta);
+	}
+	const auto counter = interpreted.vmcall("read_instret");
+	REQUIRE(translated.vmcall("read_instret") == counter);
+	REQUIRE(unlimited.vmcall("read_instret") == counter);
+}
+
+TEST_CASE("Coalesced bounds-checks fall back to individual checks", "[Translation]")
+{
+	const auto binary = build_and_load(window_program);
+	Machine<RISCV64> interpreted { binary, translated_options(false) };
+	setup_translated_machine(interpreted);
+	Machine<RISCV64> translated { binary, translated_options(true) };
+	setup_translated_machine(translated);
+
+	for (auto* machine : {&interpreted, &translated})
+	{
+		// Inside the arena the whole window is checked at once
+		const auto inside = machine->memory.mmap_allocate(64);
+		machine->vmcall("store_window", inside, 10);
+		REQUIRE(machine->vmcall("sum_window", inside) == 10 + 11 + 12 + 13);
+
+		// A window straddling the end of the arena fails the range check,
+		// and is replayed with individual checks and slow-paths
+		const auto straddle = machine->memory.memory_arena_size() - 16;
+		machine->vmcall("store_window", straddle, 20);
+		REQUIRE(machine->memory.read<int64_t>(straddle) == 20);
+		REQUIRE(machine->memory.read<int64_t>(straddle + 24) == 23);
+		REQUIRE(machine->vmcall("sum_window", straddle) == 20 + 21 + 22 + 23);
+
+		// Stores into read-only memory still fault in the replay
+		const auto text = machine->address_of("main");
+		REQUIRE_THROWS_WITH([&] {
+			machine->vmcall("store_window", text, 1);
+		}(), Catch::Matchers::ContainsSubstring("Protection fault"));
+	}
+}
+
+TEST_CASE("Flushing the instruction cache invalidates translated JIT code", "[Translation]")
+{
+	const auto binary = build_and_load(jit_program);
+	auto options = std::make_shared<MachineOptions<RISCV64>>(translated_options(true));
+#ifdef RISCV_BINARY_TRANSLATION
+	options->translate_jit_segments_after = 4;
+#endif
+	Machine<RISCV64> machine { binary, *options };
+	machine.set_options(options);
+	setup_translated_machine(machine);
+	const auto code = machine.memory.read<uint64_t>(machine.address_of("jit_code"));
+
+	for (long i = 0; i < 10; i++)
+		REQUIRE(machine.vmcall("jit_call", i) == i + 1);
+	auto segment = machine.memory.exec_segment_for(code);
+	REQUIRE(segment->is_likely_jit());
+	REQUIRE(segment->is_binary_translated() == binary_translation_enabled);
+
+	// Rewriting the code and flushing drops the translation
+	machine.vmcall("jit_write", 5, 1);
+	REQUIRE(segment->is_stale());
+	for (long i = 0; i < 10; i++)
+		REQUIRE(machine.vmcall("jit_call", i) == i + 5);
+
+	// The rewritten code is hot again, and translated again
+	segment = machine.memory.exec_segment_for(code);
+	REQUIRE(!segment->is_stale());
+	REQUIRE(segment->is_binary_translated() == binary_translation_enabled);
+}
+
+TEST_CASE("Cached FP registers across system calls", "[Translation]")
+{
+	const auto binary = build_and_load(fp_syscall_program);
+	Machine<RISCV64> interpreted { binary, translated_options(false) };
+	setup_translated_machine(interpreted);
+	auto options = translated_options(true);
+#ifdef RISCV_BINARY_TRANSLATION
+	options.translate_use_register_caching = true;
+#endif
+	Machine<RISCV64> translated { binary, options };
+	setup_translated_machine(translated);
+
+	// The system call reads FP arguments and writes an FP result,
+	// which must be seen by translated code with cached FP registers
+	Machine<RISCV64>::install_syscall_handler(500,
+	[] (Machine<RISCV64>& machine) {
+		auto& fa0 = machine.cpu.registers().getfl(REG_FA0);
+		fa0.set_double(fa0.f64 * machine.sysarg<double>(1));
+	});
+
+	for (const long n : {0, 1, 10}) {
+		double expected = 0.0;
+		for (long i = 0; i < n; i++)
+			expected += (1.5 + i) * 2.0;
+		expected *= 1.5;
+		for (auto* machine : {&interpreted, &translated}) {
+			machine->vmcall("fp_sum", 1.5, 2.0, n);
+			REQUIRE(machine->return_value<double>() == expected);
+		}
+	}
+}
+
+#ifdef RISCV_BINARY_TRANSLATION
+TEST_CASE("Translations with branch hints from a recorded profile", "[Translation]")
+{
+	const auto binary = build_and_load(branch_program);
+	Machine<RISCV64> interpreted { binary, translated_options(false) };
+	setup_translated_machine(interpreted);
+	auto profiling_options = std::make_shared<MachineOptions<RISCV64>>(translated_options(false));
+	profiling_options->record_branch_profile = true;
+	Machine<RISCV64> profiling { binary, *profiling_options };
+	profiling.set_options(profiling_options);
+	setup_translated_machine(profiling);
+
+	// Recording a profile does not change the results
+	const auto expected = interpreted.vmcall("sum_below", 1000, 1000);
+	REQUIRE(profiling.vmcall("sum_below", 1000, 1000) == expected);
+	const auto profile = profiling.memory.gather_branch_profile();
+	REQUIRE(std::any_of(profile.begin(), profile.end(), [] (const auto& hint) {
+		return hint.taken + hint.not_taken == 1000 && (hint.taken == 0 || hint.not_taken == 0);
+	}));
+
+	auto options = translated_options(true);
+	options.translator_branch_hints = profile;
+	Machine<RISCV64> translated { binary, options };
+	setup_translated_machine(translated);
+	REQUIRE(translated.is_binary_translation_enabled());
+
+	// The hinted fast path, the unlikely slow path, and both
+	for (const long limit : {1000, 0, 500}) {
+		REQUIRE(translated.vmcall("sum_below", 1000, limit)
+			== interpreted.vmcall("sum_below", 1000, limit));
+	}
+}
+#endif
+
+#ifdef RISCV_BINARY_TRANSLATION
+// Calls a local function, and returns its own load address in A1:
+// auipc a1, 0; jal ra, +20; sub t1, ra, a1; add a0, a0, t1; exit
+// addi a0, a0, 100; ret
+static constexpr uint32_t relocatable_code[] = {
+	0x00000597, 0x014000EF, 0x40B08333, 0x00650533,
+	0x05D00893, 0x00000073, 0x06450513, 0x00008067 };
+
+static uint32_t run_relocatable_code(uint64_t base, bool relocatable)
+{
+	auto options = std::make_shared<MachineOptions<RISCV64>>(translated_options(true));
+	options->translate_relocatable = relocatable;
+	Machine<RISCV64> machine { empty, *options };
+	machine.set_options(options);
+	Machine<RISCV64>::setup_minimal_syscalls();
+	machine.memory.set_page_attr(base, Page::size(), {.read = true, .exec = true});
+	auto& segment = machine.cpu.init_execute_area(relocatable_code, base, sizeof(relocatable_code));
+	REQUIRE(segment.is_binary_translated());
+
+	machine.cpu.reg(REG_ARG0) = 1;
+	machine.cpu.jump(base);
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<long>() == 1 + 100 + 8);
+	REQUIRE(machine.sysarg<uint64_t>(1) == base);
+	return segment.translation_hash();
+}
+
+TEST_CASE("Relocatable translations run at any segment base", "[Translation]")
+{
+	// The same translation is used at both bases
+	const auto hash = run_relocatable_code(0x100000, true);
+	REQUIRE(run_relocatable_code(0x200000, true) == hash);
+
+	// Other translations are specific to their base
+	const auto absolute = run_relocatable_code(0x100000, false);
+	REQUIRE(run_relocatable_code(0x200000, false) != absolute);
+}
+#endif
@@ -0,0 +1,168 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+using namespace riscv;
+
+static const char* try_program = R"M(
+static long failing_syscall() {
+	register long a0 __asm__("a0") = 0;
+	register long a7 __asm__("a7") = 500;
+	__asm__ volatile("ecall" : "+r"(a0) : "r"(a7) : "memory");
+	return a0;
+}
+int main() {
+	return 666;
+}
+__attribute__((used, retain))
+long add(long a, long b) {
+	return a + b;
+}
+__attribute__((used, retain))
+long crash() {
+	return ((long (*)())0x7000000)();
+}
+__attribute__((used, retain))
+void spin() {
+	for (;;) __asm__ volatile("");
+}
+__attribute__((used, retain))
+long host_fault() {
+	return failing_syscall();
+}
+__attribute__((used, retain))
+long read_long(long* p) {
+	return *p;
+}
+)M";
+
+static void setup_try_machine(Machine<RISCV64>& machine)
+{
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"try"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+	Machine<RISCV64>::install_syscall_handler(500, [] (Machine<RISCV64>&) {
+		throw MachineException(ILLEGAL_OPERATION, "Failing system call", 500);
+	});
+}
+
+TEST_CASE("Exception-free simulation", "[TryCalls]")
+{
+	const auto binary = build_and_load(try_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_try_machine(machine);
+
+	REQUIRE(machine.try_simulate(MAX_INSTRUCTIONS) == MACHINE_STOPPED);
+	REQUIRE(machine.return_value<int>() == 666);
+	REQUIRE(machine.fault().message == nullptr);
+	REQUIRE(!FaultLandingPad::active());
+
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("add", 1, 2) == MACHINE_STOPPED);
+	REQUIRE(machine.return_value<long>() == 3);
+
+	// Guest faults land back in the caller
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("crash") == MACHINE_FAULT);
+	REQUIRE(machine.fault().type == EXECUTION_SPACE_PROTECTION_FAULT);
+	REQUIRE(machine.fault().message != nullptr);
+	REQUIRE(!FaultLandingPad::active());
+
+	// Timeouts are not faults
+	REQUIRE(machine.try_vmcall<100'000>("spin") == MACHINE_TIMEOUT);
+	REQUIRE(machine.instruction_limit_reached());
+	REQUIRE(machine.fault().message == nullptr);
+
+	// Exceptions thrown by system call handlers are caught too
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("host_fault") == MACHINE_FAULT);
+	REQUIRE(machine.fault().type == ILLEGAL_OPERATION);
+	REQUIRE(machine.fault().data == 500);
+	REQUIRE_THAT(std::string(machine.fault().message),
+		Catch::Matchers::ContainsSubstring("Failing system call"));
+
+	// The machine is still usable, and still throws outside of try_*()
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("add", 3, 4) == MACHINE_STOPPED);
+	REQUIRE(machine.return_value<long>() == 7);
+	REQUIRE_THROWS_WITH([&] {
+		machine.vmcall<MAX_INSTRUCTIONS>("crash");
+	}(), Catch::Matchers::ContainsSubstring("Execution space protection fault"));
+}
+
+TEST_CASE("Exception-free preemption", "[TryCalls]")
+{
+	const auto binary = build_and_load(try_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_try_machine(machine);
+
+	REQUIRE(machine.try_simulate(MAX_INSTRUCTIONS) == MACHINE_STOPPED);
+	const auto pc = machine.cpu.pc();
+	const auto sp = machine.cpu.reg(REG_SP);
+	const auto a0 = machine.cpu.reg(REG_ARG0);
+	const auto max = machine.max_instructions();
+
+	address_type<RISCV64> result = 0;
+	REQUIRE(machine.try_preempt(result, MAX_INSTRUCTIONS, machine.address_of("add"), 20, 22) == MACHINE_STOPPED);
+	REQUIRE(result == 42);
+
+	// Registers are restored after faults and timeouts too
+	for (const char* func : {"crash", "spin", "host_fault"})
+	{
+		const auto status = machine.try_preempt(result, 100'000, machine.address_of(func));
+		REQUIRE(status == (std::string(func) == "spin" ? MACHINE_TIMEOUT : MACHINE_FAULT));
+		REQUIRE(machine.cpu.pc() == pc);
+		REQUIRE(machine.cpu.reg(REG_SP) == sp);
+		REQUIRE(machine.cpu.reg(REG_ARG0) == a0);
+		REQUIRE(machine.max_instructions() == max);
+		REQUIRE(!FaultLandingPad::active());
+	}
+
+	REQUIRE(machine.try_preempt(result, MAX_INSTRUCTIONS, machine.address_of("add"), 1, 2) == MACHINE_STOPPED);
+	REQUIRE(result == 3);
+}
+
+TEST_CASE("Callbacks unwind normally in exception-free calls", "[TryCalls]")
+{
+	const auto binary = build_and_load(try_program);
+	Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	setup_try_machine(machine);
+	REQUIRE(machine.try_simulate(MAX_INSTRUCTIONS) == MACHINE_STOPPED);
+
+	// Counts the destructors that ran in callbacks that faulted
+	static int destroyed = 0;
+	struct Counted {
+		~Counted() { destroyed++; }
+	};
+	destroyed = 0;
+
+	if constexpr (memory_traps_enabled) {
+		// Outside of the arena, where page traps are always taken
+		static constexpr uint64_t TRAP_PAGE = 0x40000000;
+		machine.memory.trap(TRAP_PAGE, [&] (Page&, uint32_t, int, int64_t) {
+			Counted counted;
+			machine.cpu.trigger_exception(PROTECTION_FAULT, TRAP_PAGE);
+		});
+		REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("read_long", TRAP_PAGE) == MACHINE_FAULT);
+		REQUIRE(machine.fault().type == PROTECTION_FAULT);
+		REQUIRE(destroyed == 1);
+		REQUIRE(!FaultLandingPad::active());
+	}
+
+	machine.cpu.set_fault_handler([] (auto& cpu, auto&) {
+		Counted counted;
+		cpu.trigger_exception(EXECUTION_SPACE_PROTECTION_FAULT, cpu.pc());
+	});
+	destroyed = 0;
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("crash") == MACHINE_FAULT);
+	REQUIRE(machine.fault().type == EXECUTION_SPACE_PROTECTION_FAULT);
+	REQUIRE(destroyed == 1);
+
+	// Arguments are set up before the call is guarded
+	const std::string text = "Hello World!";
+	REQUIRE(machine.try_vmcall<MAX_INSTRUCTIONS>("add", text, 0) == MACHINE_STOPPED);
+	REQUIRE(machine.memory.memstring(machine.return_value<uint64_t>()) == text);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_string.hpp>
+
+#include <libriscv/machine.hpp>
+extern std::vector<uint8_t> build_and_load(const std::string& code,
+	const std::string& args = "-O2 -static", bool cpp = false);
+static const uint64_t MAX_MEMORY = 8ul << 20; /* 8MB */
+static const uint64_t MAX_INSTRUCTIONS = 10'000'000ul;
+using namespace riscv;
+
+TEST_CASE("Normalize virtual filesystem paths", "[VFS]")
+{
+	REQUIRE(VirtualFileSystem::normalize("/", "") == "/");
+	REQUIRE(VirtualFileSystem::normalize("/a/b", "../c") == "/a/c");
+	REQUIRE(VirtualFileSystem::normalize("/x", "/y/./z/") == "/y/z");
+	REQUIRE(VirtualFileSystem::normalize("/", "../..") == "/");
+	REQUIRE(VirtualFileSystem::normalize("/usr", "lib//x.so") == "/usr/lib/x.so");
+
+	VirtualFileSystem vfs;
+	vfs.add_file("/etc/hello.txt", "Hello World");
+	vfs.add_file("home/owned.txt", std::vector<char>{'h', 'i'});
+	REQUIRE(vfs.lookup("/etc") != nullptr);
+	REQUIRE(vfs.lookup("/etc")->is_dir);
+	REQUIRE(vfs.lookup("/etc/hello.txt")->size() == 11);
+	REQUIRE(vfs.lookup("/home/owned.txt")->data == "hi");
+	REQUIRE(vfs.lookup("/etc/missing.txt") == nullptr);
+
+	// A file cannot be used as a directory
+	REQUIRE_THROWS_WITH([&] {
+		vfs.add_file("/etc/hello.txt/nested", "");
+	}(), Catch::Matchers::ContainsSubstring("not a directory"));
+}
+
+TEST_CASE("Read files from the virtual filesystem", "[VFS]")
+{
+	const auto binary = build_and_load(R"M(
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <string.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+
+	int main() {
+		int fd = open("/etc/hello.txt", O_RDONLY);
+		if (fd < 0) return 1;
+		char buf[64] = {};
+		if (read(fd, buf, sizeof(buf)) != 11) return 2;
+		if (strcmp(buf, "Hello World") != 0) return 3;
+		if (lseek(fd, 6, SEEK_SET) != 6) return 4;
+		if (read(fd, buf, 5) != 5 || memcmp(buf, "World", 5) != 0) return 5;
+		if (pread(fd, buf, 5, 0) != 5 || memcmp(buf, "Hello", 5) != 0) return 6;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size != 11 || !S_ISREG(st.st_mode)) return 14;
+
+		// The filesystem is read-only
+		if (open("/etc/hello.txt", O_WRONLY) >= 0) return 7;
+		if (open("/etc/missing.txt", O_RDONLY) >= 0) return 8;
+
+		// Mapped files are zero-filled after the end of the file
+		const char* m = mmap(0, 4096, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED) return 9;
+		if (memcmp(m, "Hello World", 11) != 0 || m[11] != 0) return 10;
+		close(fd);
+
+		// Relative paths are resolved against the working directory
+		fd = open("relative.txt", O_RDONLY);
+		if (fd < 0) return 11;
+		close(fd);
+
+		int entries = 0;
+		DIR* dir = opendir("/etc");
+		if (dir == NULL) return 12;
+		struct dirent* ent;
+		while ((ent = readdir(dir)) != NULL) {
+			if (ent->d_type == DT_REG) entries++;
+		}
+		closedir(dir);
+		if (entries != 2) return 13;
+
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"vfs"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	auto vfs = std::make_shared<VirtualFileSystem>();
+	vfs->add_file("/etc/hello.txt", "Hello World");
+	vfs->add_file("/etc/other.txt", std::vector<char>{'x'});
+	vfs->add_file("/home/relative.txt", "");
+	machine.fds().vfs = vfs;
+	// The host filesystem stays disabled
+	REQUIRE(!machine.fds().permit_filesystem);
+
+	machine.simulate(MAX_INSTRUCTIONS);
+
+	REQUIRE(machine.return_value<int>() == 666);
+	// Every virtual file was closed
+	REQUIRE(machine.fds().vfs_files.empty());
+}
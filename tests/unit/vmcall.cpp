@@ -455,3 +455,56 @@ TEST_CASE("VM call and STOP instruction", "[VMCall]")
 		REQUIRE(state.output_is_hello_world);
 	}
 }
+
+#ifdef RISCV_EXT_VECTOR
+TEST_CASE("Vector state across preemption", "[VMCall]")
+{
+	const auto binary = build_and_load(R"M(
+	__attribute__((used, retain))
+	void use_vectors() {
+		// vmv.v.i v1, 5
+		__asm__ volatile(".word 0x5E02B0D7");
+	}
+	__attribute__((used, retain))
+	long add(long a, long b) {
+		return a + b;
+	}
+
+	int main() {
+		return 666;
+	})M");
+
+	riscv::Machine<RISCV64> machine { binary, { .memory_max = MAX_MEMORY } };
+	// We need to install Linux system calls for maximum gucciness
+	machine.setup_linux_syscalls();
+	// We need to create a Linux environment for runtimes to work well
+	machine.setup_linux(
+		{"vmcall"},
+		{"LC_TYPE=C", "LC_ALL=C", "USER=root"});
+
+	machine.simulate(MAX_INSTRUCTIONS);
+	REQUIRE(machine.return_value<int>() == 666);
+	// Scalar programs have no vector state
+	REQUIRE(!machine.cpu.registers().has_vector_state());
+
+	// Vectors used during preemption are not left behind
+	machine.preempt(MAX_INSTRUCTIONS, "use_vectors");
+	REQUIRE(!machine.cpu.registers().has_vector_state());
+
+	machine.vmcall<MAX_INSTRUCTIONS>("use_vectors");
+	REQUIRE(machine.cpu.registers().has_vector_state());
+	REQUIRE(machine.cpu.registers().rvv().u32(1)[0] == 5);
+
+	// Once used, the vector state is restored after preemption
+	machine.cpu.registers().rvv().u32(1)[0] = 7;
+	machine.preempt(MAX_INSTRUCTIONS, "use_vectors");
+	REQUIRE(machine.cpu.registers().rvv().u32(1)[0] == 7);
+	REQUIRE(machine.preempt(MAX_INSTRUCTIONS, "add", 1, 2) == 3);
+	REQUIRE(machine.cpu.registers().rvv().u32(1)[0] == 7);
+
+	// Copies of the registers carry the vector state
+	Registers<RISCV64> copy = machine.cpu.registers();
+	REQUIRE(copy.has_vector_state());
+	REQUIRE(copy.rvv().u32(1)[0] == 7);
+}
+#endif